@@ -0,0 +1,414 @@
+// NOTE: pbr lighting shared by the deferred (pbr_ibl_v2.frag) and forward (forward/forward_pbr.frag) shading
+// passes: clustered (or tiled) point lights with their atlas shadows, the cascaded directional shadow and the ibl
+// probes. The prefiltered probe maps live in a cubemap array (layer 0 is the sky, local probe i is layer i + 1),
+// their irradiance in a buffer of sh coefficients in the same order, and the shading blends the two nearest local
+// probes of its screen tile's probe list. Include after #version. NO_POINT_LIGHTS drops the light list loop, for
+// tiles the classification found without lights (deferred_tile.comp).
+#include "../lighting/cluster_common.glsl"
+
+#define MAX_CASCADES 4
+
+// Variance shadow mapping, one layer per cascade
+uniform sampler2DArray dirVSM;
+uniform mat4 cascadeMatrices[MAX_CASCADES];
+uniform vec4 cascadeSplits;			// view depth where each cascade ends
+uniform vec4 cascadeLightSizeUV;	// light size relative to each cascade's box
+uniform int cascadeCount;
+uniform float vsmSize;
+uniform bool vsmUseMips;			// mip filtered moments, otherwise they were blurred at the base level
+uniform int shadowMode;				// 0 = vsm, 1 = evsm (positive), 2 = evsm (positive and negative)
+uniform vec2 evsmExponents;
+uniform float lightBleedReduction;
+uniform vec3 viewForward;
+
+// IBL
+uniform bool hasSkyProbe;
+uniform samplerCubeArray prefilterMaps;
+uniform sampler2D brdfLUT;
+
+// Lighting
+struct Light {
+	vec4 pos_radius;
+	vec4 color_intensity;
+};
+
+// Directional light
+uniform Light dirLight; // pos_radius only stores direction
+
+// Point Light Cluster Buffers
+layout(std430, binding = 0) readonly buffer LightBuf {
+	Light lights[];
+};
+
+layout(std430, binding = 1) readonly buffer ClusterInfoBuf {
+	uvec2 clusterInfo[];
+};
+
+layout(std430, binding = 2) readonly buffer LightIndexBuf {
+	uint lightIndices[];
+};
+
+// Local probe bounds (position = xyz, radius = w) and their per tile lists
+layout(std430, binding = 13) readonly buffer ProbeBuf {
+	vec4 probes[];
+};
+
+layout(std430, binding = 14) readonly buffer ProbeListBuf {
+	uint probeLists[];
+};
+
+// 9 irradiance sh coefficients per probe layer (rgb)
+layout(std430, binding = 15) readonly buffer ProbeSHBuf {
+	vec4 probeSH[];
+};
+
+#ifndef NO_POINT_LIGHTS
+// Point light shadows, cube faces in a shared depth atlas holding distance / radius
+struct PointShadow {
+	vec4 faceRects[6];		// atlas uv origin, uv size, projection scale (the face minus its guard band)
+	vec4 faceOrigins[6];	// light position the face was rendered from, radius
+};
+
+layout(std430, binding = 11) readonly buffer LightShadowBuf {
+	int lightShadows[];		// shadow record per light, -1 when the light is not shadowed
+};
+
+layout(std430, binding = 12) readonly buffer PointShadowBuf {
+	PointShadow pointShadows[];
+};
+
+uniform sampler2DShadow pointShadowAtlas;
+uniform float pointShadowTexel;		// 1 / atlas size
+
+// +x, -x, +y, -y, +z, -z, same face matrices as RenderSystem::RenderPointShadowFace
+const vec3 CUBE_FORWARD[6] = vec3[](vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1));
+const vec3 CUBE_UP[6] = vec3[](vec3(0, -1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1), vec3(0, -1, 0), vec3(0, -1, 0));
+#endif
+
+uniform vec3 viewPos;
+
+const float PI = 3.14159265359;
+const float g_MinVariance = 1e-7;
+
+// uses Fresnel-Schlick approximation
+vec3 Fresnel(float cosTheta, vec3 F0) {
+	return F0 + (1.0 - F0) * pow(max((1.0 - cosTheta), 0.0), 5.0);
+}
+
+// based on Sebastien Lagarde's implementation
+vec3 FresnelRoughness(float cosTheta, vec3 F0, float roughness) {
+	return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+// uses TrowBridge-Reitz GGX
+float NormalDistribution(float nDotH, float roughness) {
+    float a = roughness * roughness;
+	float a2 = a * a;
+	float NdotH2 = nDotH * nDotH;
+	return a2 / (PI * pow(NdotH2 * (a2 - 1.0) + 1.0, 2.0));
+
+    // float denom = (nDotH * nDotH * (a2 - 1.0) + 1.0);
+    // return a2 / (PI * (denom * denom));
+}
+
+// uses Schlick-Beckman GGX
+float GeometryEq(float dotProd, float roughness) {
+	float k = (roughness + 1.0);
+	k = k * k * 0.125;
+	return dotProd / (dotProd * (1.0 - k) + k);
+}
+
+float linstep(float min, float max, float v) {
+	return clamp((v - min) / (max - min), 0, 1);
+}
+
+float ChebyshevUpperBound(vec2 moments, float t) {
+	float variance = moments.y - (moments.x * moments.x);
+	variance = clamp(variance, g_MinVariance, 0.0005);
+	float d = t - moments.x;
+	float p_max = variance / (variance + d * d);
+
+	float p = (t <= moments.x) ? 1.0 : p_max;
+
+	float bleedStart = 0.2;
+	float bleedEnd = 0.8;
+
+	return clamp(p, 0.0, 1.0);
+	// return smoothstep(bleedStart, bleedEnd, p);
+}
+
+float EVSMChebyshev(vec2 moments, float t, float exponent) {
+	// minimum variance follows the slope of the exponential warp
+	float depthScale = 0.0001 * exponent * t;
+	float variance = max(moments.y - moments.x * moments.x, depthScale * depthScale);
+	float d = t - moments.x;
+	float p_max = variance / (variance + d * d);
+	float p = (t <= moments.x) ? 1.0 : p_max;
+	return linstep(lightBleedReduction, 1.0, p);
+}
+
+float CascadeShadow(int cascade, vec3 fragPos) {
+	vec4 fragPosLightSpace = cascadeMatrices[cascade] * vec4(fragPos, 1.0);
+	vec3 ndc = fragPosLightSpace.xyz / fragPosLightSpace.w;
+	vec2 lightTexCoord = ndc.xy * 0.5 + 0.5;
+	float depthN = ndc.z * 0.5 + 0.5;
+
+	float lod = 0.0;
+	if (vsmUseMips) {
+		float penumbraUV = cascadeLightSizeUV[cascade] * depthN;
+		float texel = penumbraUV * vsmSize;
+		float maxLod = floor(log2(vsmSize));
+		lod = clamp(log2(max(texel, 1.0)), 0.0, maxLod);
+	}
+	vec4 moments = textureLod(dirVSM, vec3(lightTexCoord, float(cascade)), lod);
+
+	if (shadowMode == 0) return ChebyshevUpperBound(moments.xy, depthN);
+
+	float w = depthN * 2.0 - 1.0;
+	float pos = exp(evsmExponents.x * w);
+	float shadow = EVSMChebyshev(moments.xy, pos, evsmExponents.x);
+	if (shadowMode == 2) {
+		float neg = -exp(-evsmExponents.y * w);
+		shadow = min(shadow, EVSMChebyshev(moments.zw, neg, evsmExponents.y));
+	}
+	return shadow;
+}
+
+float DirShadowContribution(vec3 fragPos) {
+	float viewDepth = dot(fragPos - viewPos, viewForward);
+
+	int cascade = 0;
+	while (cascade < cascadeCount && viewDepth > cascadeSplits[cascade]) cascade++;
+	if (cascade >= cascadeCount) return 1.0;
+
+	float shadow = CascadeShadow(cascade, fragPos);
+
+	// blend into the next cascade (or out of shadow after the last one) near the split
+	float splitNear = cascade == 0 ? 0.0 : cascadeSplits[cascade - 1];
+	float band = (cascadeSplits[cascade] - splitNear) * 0.1;
+	float blend = linstep(cascadeSplits[cascade] - band, cascadeSplits[cascade], viewDepth);
+	if (blend > 0.0) {
+		float next = cascade + 1 < cascadeCount ? CascadeShadow(cascade + 1, fragPos) : 1.0;
+		shadow = mix(shadow, next, blend);
+	}
+	return shadow;
+}
+
+// irradiance over pi of a probe layer, the value the irradiance cubemaps used to hold
+vec3 IrradianceSH(int layer, vec3 n) {
+	int base = layer * 9;
+	vec3 irradiance = probeSH[base + 0].rgb * 0.282095
+		+ probeSH[base + 1].rgb * 0.488603 * n.y
+		+ probeSH[base + 2].rgb * 0.488603 * n.z
+		+ probeSH[base + 3].rgb * 0.488603 * n.x
+		+ probeSH[base + 4].rgb * 1.092548 * n.x * n.y
+		+ probeSH[base + 5].rgb * 1.092548 * n.y * n.z
+		+ probeSH[base + 6].rgb * 0.315392 * (3.0 * n.z * n.z - 1.0)
+		+ probeSH[base + 7].rgb * 1.092548 * n.x * n.z
+		+ probeSH[base + 8].rgb * 0.546274 * (n.x * n.x - n.y * n.y);
+	return max(irradiance, vec3(0.0));
+}
+
+#ifndef NO_POINT_LIGHTS
+// 1 is lit. the face is picked by the major axis, then the position is projected like the face camera did
+float PointShadowFactor(int record, vec3 fragPos, vec3 n, vec3 lightPos) {
+	vec3 toFrag = fragPos - lightPos;
+	vec3 a = abs(toFrag);
+	int face;
+	if (a.x >= a.y && a.x >= a.z) face = toFrag.x > 0.0 ? 0 : 1;
+	else if (a.y >= a.z) face = toFrag.y > 0.0 ? 2 : 3;
+	else face = toFrag.z > 0.0 ? 4 : 5;
+
+	vec4 rect = pointShadows[record].faceRects[face];
+	vec4 origin = pointShadows[record].faceOrigins[face];
+	vec3 f = CUBE_FORWARD[face];
+	vec3 s = normalize(cross(f, CUBE_UP[face]));
+	vec3 u = cross(s, f);
+
+	// normal offset of a texel and a half, texels grow with the distance to the light
+	float faceTexels = rect.z / pointShadowTexel;
+	float texelSize = 2.0 * max(dot(toFrag, f), 0.0) / (rect.w * faceTexels);
+	vec3 v = fragPos + n * texelSize * 1.5 - origin.xyz;
+	float depth = dot(v, f);
+	if (depth <= 0.0) return 1.0;
+
+	// clamped to the inner face, the guard band keeps the taps inside the tile
+	vec2 ndc = clamp(vec2(dot(v, s), dot(v, u)) / depth * rect.w, -rect.w, rect.w);
+	vec2 uv = rect.xy + (ndc * 0.5 + 0.5) * rect.z;
+	float ref = length(v) / origin.w - 0.002;
+
+	// 4 taps of the hardware 2x2 compare
+	float lit = 0.0;
+	lit += texture(pointShadowAtlas, vec3(uv + vec2(-0.5, -0.5) * pointShadowTexel, ref));
+	lit += texture(pointShadowAtlas, vec3(uv + vec2( 0.5, -0.5) * pointShadowTexel, ref));
+	lit += texture(pointShadowAtlas, vec3(uv + vec2(-0.5,  0.5) * pointShadowTexel, ref));
+	lit += texture(pointShadowAtlas, vec3(uv + vec2( 0.5,  0.5) * pointShadowTexel, ref));
+	return lit * 0.25;
+}
+#endif
+
+// radiance leaving fragPos towards the camera. pixel and the view depth select the light cluster
+vec3 ShadeSurface(vec3 fragPos, vec3 n, vec3 albedo, float roughness, float metallic, float ao, ivec2 pixel) {
+	vec3 v = normalize(viewPos - fragPos);
+	float nDotV = max(dot(n, v), 0.0);
+
+	vec3 F0 = mix(vec3(0.04), albedo, metallic);
+	vec3 Lo = vec3(0.0); // outgoing radiance
+
+#ifndef NO_POINT_LIGHTS
+	int cluster = ClusterIndex(pixel, dot(fragPos - viewPos, viewForward));
+	uint offset = clusterInfo[cluster].x;
+	uint count  = clusterInfo[cluster].y;
+
+	// Point Lights
+	for (uint i = 0u; i < count; i++) {
+		uint lightID = lightIndices[offset + i];
+		Light light = lights[lightID];
+
+		// light unpacking
+		vec3 lightPos = light.pos_radius.rgb;
+		float lightRadius = light.pos_radius.a;
+		vec3 lightColor = light.color_intensity.rgb;
+		float lightIntensity = light.color_intensity.a;
+
+		vec3 l = normalize(lightPos - fragPos);
+		vec3 h = normalize(v + l);
+
+		// lighting helper, tentative
+		float dist = length(lightPos - fragPos);
+		if (dist > lightRadius) continue;
+
+		float radius = lightRadius;
+		float attenuation = clamp(1.0 - dist / radius, 0.0, 1.0);
+		attenuation = (attenuation * attenuation) / (dist * dist + 1e-2);
+
+		// Dot product setup
+		float nDotL = max(dot(n, l), 0.0);
+		float vDotH = max(dot(v, h), 0.0);
+		float nDotH = max(dot(n, h), 0.0);
+		
+		if (nDotL > 0.0) {
+			// Specular BRDF
+			vec3 F = Fresnel(vDotH, F0);
+			float D = NormalDistribution(nDotH, roughness);
+			float G = GeometryEq(nDotL, roughness) * GeometryEq(nDotV, roughness);
+
+			vec3 SpecBRDF_nom = D * G * F;
+			float SpecBRDF_denom = 4.0 * nDotV * nDotL;
+			vec3 SpecBRDF = SpecBRDF_nom / max(SpecBRDF_denom, 0.001);
+
+			// Diffuse BRDF
+			vec3 kS = F;
+			vec3 kD = vec3(1.0) - kS;
+			kD *= 1.0 - metallic;
+			vec3 fLambert = albedo;
+			vec3 DiffuseBRDF = kD * fLambert / PI;
+
+			int shadowRecord = lightShadows[lightID];
+			float shadow = shadowRecord >= 0 ? PointShadowFactor(shadowRecord, fragPos, n, lightPos) : 1.0;
+
+			vec3 radiance = lightColor * attenuation * lightIntensity * shadow;
+			Lo += (DiffuseBRDF + SpecBRDF) * radiance * nDotL;
+		}
+	}
+#endif
+
+	// directional light
+	vec3 Ld = normalize(-dirLight.pos_radius.xyz);
+	vec3 h = normalize(v + Ld);
+	float nDotL = max(dot(n, Ld), 0.0);
+	float vDotH = max(dot(v, h), 0.0);
+	float nDotH = max(dot(n, h), 0.0);
+	if (nDotL > 0.0) {
+		// Specular BRDF
+		vec3 F = Fresnel(vDotH, F0);
+		float D = NormalDistribution(nDotH, roughness);
+		float G = GeometryEq(nDotL, roughness) * GeometryEq(nDotV, roughness);
+
+		vec3 SpecBRDF_nom = D * G * F;
+		float SpecBRDF_denom = 4.0 * nDotV * nDotL;
+		vec3 SpecBRDF = SpecBRDF_nom / max(SpecBRDF_denom, 0.001);
+
+		// Diffuse BRDF
+		vec3 kS = F;
+		vec3 kD = vec3(1.0) - kS;
+		kD *= 1.0 - metallic;
+		vec3 fLambert = albedo;
+		vec3 DiffuseBRDF = kD * fLambert / PI;
+
+		vec3 radiance = dirLight.color_intensity.rgb * dirLight.color_intensity.a;
+
+
+		vec3 Lo_dir = (DiffuseBRDF + SpecBRDF) * radiance * nDotL;
+
+		// Directional shadow mapping
+		float shadow = DirShadowContribution(fragPos);
+
+		Lo = Lo + shadow * Lo_dir;
+	}
+
+	// IBL
+	vec3 R = reflect(-v, n);
+	const float MAX_REFLECTION_LOD = 4.0;
+
+	vec3 F_ibl = FresnelRoughness(nDotV, F0, roughness);
+	vec3 kS = F_ibl;
+	vec3 kD = 1.0 - kS;
+	kD *= 1.0 - metallic;
+
+	// two nearest local probes of the tile that reach fragPos
+	int probeList = ProbeTileIndex(pixel) * PROBE_LIST_STRIDE;
+	uint probeTotal = min(probeLists[probeList], uint(MAX_PROBES_PER_TILE));
+	int i0 = -1, i1 = -1;
+	float d0 = 1e20, d1 = 1e20;
+	for (uint i = 0u; i < probeTotal; i++) {
+		int probe = int(probeLists[probeList + 1 + int(i)]);
+		float di = length(fragPos - probes[probe].xyz);
+		if (di >= probes[probe].w) continue;
+
+		if (di < d0) {
+			d1 = d0;
+			i1 = i0;
+			d0 = di;
+			i0 = probe;
+		} else if (di < d1) {
+			d1 = di;
+			i1 = probe;
+		}
+	}
+
+	// cubic smoothstep (1-d/r)^3, the sky takes the rest
+	float w0 = i0 >= 0 ? pow(1.0 - d0 / probes[i0].w, 3.0) : 0.0;
+	float w1 = i1 >= 0 ? pow(1.0 - d1 / probes[i1].w, 3.0) : 0.0;
+	float wSky = max(1.0 - (w0 + w1), 0.0);
+
+	vec3 irradiance = vec3(0.0);
+	vec3 prefilteredColor = vec3(0.0);
+	vec3 ambient = vec3(0.0);
+	if (i0 >= 0) {
+		irradiance += IrradianceSH(i0 + 1, n) * w0;
+		prefilteredColor += textureLod(prefilterMaps, vec4(R, float(i0 + 1)), roughness * MAX_REFLECTION_LOD).rgb * w0;
+	}
+	if (i1 >= 0) {
+		irradiance += IrradianceSH(i1 + 1, n) * w1;
+		prefilteredColor += textureLod(prefilterMaps, vec4(R, float(i1 + 1)), roughness * MAX_REFLECTION_LOD).rgb * w1;
+	}
+	if (hasSkyProbe) {
+		irradiance += IrradianceSH(0, n) * wSky;
+		prefilteredColor += textureLod(prefilterMaps, vec4(R, 0.0), roughness * MAX_REFLECTION_LOD).rgb * wSky;
+	}
+	else {
+		// constant ambient value
+		ambient = vec3(0.03) * albedo * ao * wSky;
+	}
+
+	if (i0 >= 0 || hasSkyProbe) {
+		vec2 envBRDF = texture(brdfLUT, vec2(nDotV, roughness)).rg;
+		vec3 diffuseIBL = irradiance * albedo;
+		vec3 specularIBL = prefilteredColor * (F_ibl * envBRDF.x + envBRDF.y);
+		ambient += (kD * diffuseIBL * ao) + specularIBL;
+	}
+
+	return ambient + Lo;
+}
+
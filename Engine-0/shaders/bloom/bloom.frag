@@ -5,12 +5,13 @@ out vec4 FragColor;
 uniform sampler2D hdrScene;
 uniform sampler2D blurBuffer;
 uniform float exposure;
+uniform float bloomScale = 1.0;	// the mip chain adds up every level, scaled back down here
 
 in vec2 TexCoords;
 
 void main() {
 	vec3 scene = texture(hdrScene,  TexCoords).rgb;
-    vec3 glow  = texture(blurBuffer,  TexCoords).rgb;
+    vec3 glow  = texture(blurBuffer,  TexCoords).rgb * bloomScale;
 
     vec3 color = scene + glow * exposure;
     FragColor  = vec4(color, 1.0);
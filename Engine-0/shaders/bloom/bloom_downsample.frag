@@ -0,0 +1,67 @@
+#version 330 core
+
+// NOTE: 13 tap downsample from "Next Generation Post Processing in Call of Duty: Advanced Warfare". The taps form a
+// center 2x2 box (bilinear taps at +-1) and four overlapping corner boxes, weighted 0.5 and 0.125 each. On the
+// first level the boxes are Karis averaged (weighted by 1 / (1 + luma)) so single bright pixels do not flicker,
+// and the brightness threshold is applied with a soft knee.
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform bool prefilter;
+uniform float threshold;
+uniform float knee;
+
+const vec3 luminance = vec3(0.2126, 0.7152, 0.0722);
+
+vec3 BoxKaris(vec3 a, vec3 b, vec3 c, vec3 d, out float weight) {
+	vec3 box = (a + b + c + d) * 0.25;
+	weight = 1.0 / (1.0 + dot(box, luminance));
+	return box * weight;
+}
+
+vec3 SoftThreshold(vec3 color) {
+	float brightness = max(color.r, max(color.g, color.b));
+	float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+	soft = soft * soft / (4.0 * knee + 1e-5);
+	return color * max(soft, brightness - threshold) / max(brightness, 1e-5);
+}
+
+void main() {
+	vec2 t = 1.0 / vec2(textureSize(source, 0));
+
+	vec3 a = texture(source, TexCoords + t * vec2(-2.0,  2.0)).rgb;
+	vec3 b = texture(source, TexCoords + t * vec2( 0.0,  2.0)).rgb;
+	vec3 c = texture(source, TexCoords + t * vec2( 2.0,  2.0)).rgb;
+	vec3 d = texture(source, TexCoords + t * vec2(-2.0,  0.0)).rgb;
+	vec3 e = texture(source, TexCoords).rgb;
+	vec3 f = texture(source, TexCoords + t * vec2( 2.0,  0.0)).rgb;
+	vec3 g = texture(source, TexCoords + t * vec2(-2.0, -2.0)).rgb;
+	vec3 h = texture(source, TexCoords + t * vec2( 0.0, -2.0)).rgb;
+	vec3 i = texture(source, TexCoords + t * vec2( 2.0, -2.0)).rgb;
+	vec3 j = texture(source, TexCoords + t * vec2(-1.0,  1.0)).rgb;
+	vec3 k = texture(source, TexCoords + t * vec2( 1.0,  1.0)).rgb;
+	vec3 l = texture(source, TexCoords + t * vec2(-1.0, -1.0)).rgb;
+	vec3 m = texture(source, TexCoords + t * vec2( 1.0, -1.0)).rgb;
+
+	vec3 color;
+	if (prefilter) {
+		float w0, w1, w2, w3, w4;
+		color  = BoxKaris(j, k, l, m, w0) * 0.5;
+		color += BoxKaris(a, b, d, e, w1) * 0.125;
+		color += BoxKaris(b, c, e, f, w2) * 0.125;
+		color += BoxKaris(d, e, g, h, w3) * 0.125;
+		color += BoxKaris(e, f, h, i, w4) * 0.125;
+		color /= w0 * 0.5 + (w1 + w2 + w3 + w4) * 0.125;
+		color = SoftThreshold(color);
+	}
+	else {
+		color  = e * 0.125;
+		color += (a + c + g + i) * 0.03125;
+		color += (b + d + f + h) * 0.0625;
+		color += (j + k + l + m) * 0.125;
+	}
+
+	FragColor = vec4(max(color, vec3(0.0)), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 330 core
+
+// 3x3 tent over the next smaller level, added onto the current level with additive blending
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform float radius;	// in source texels
+
+void main() {
+	vec2 t = radius / vec2(textureSize(source, 0));
+
+	vec3 color = texture(source, TexCoords).rgb * 4.0;
+	color += (texture(source, TexCoords + vec2(-t.x, 0.0)).rgb + texture(source, TexCoords + vec2(t.x, 0.0)).rgb
+		+ texture(source, TexCoords + vec2(0.0, -t.y)).rgb + texture(source, TexCoords + vec2(0.0, t.y)).rgb) * 2.0;
+	color += texture(source, TexCoords + vec2(-t.x, t.y)).rgb + texture(source, TexCoords + vec2(t.x, t.y)).rgb
+		+ texture(source, TexCoords + vec2(-t.x, -t.y)).rgb + texture(source, TexCoords + vec2(t.x, -t.y)).rgb;
+
+	FragColor = vec4(color / 16.0, 1.0);
+}
\ No newline at end of file
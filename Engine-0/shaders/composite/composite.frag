@@ -1,10 +1,12 @@
 ﻿#version 330 core
+#include "../postprocess/color_lut.glsl"
 out vec4 FragColor;
 in vec2 TexCoords;
 
 uniform sampler2D tonemappedScene;
 uniform sampler2D sceneDepth;
 uniform samplerCube skybox;
+uniform sampler3D reinhardLUT;
 uniform mat4 invProjection;
 uniform mat4 invView;
 
@@ -21,10 +23,7 @@ void main() {
     if (d > 0.999) {
         vec3 dir = reconstructDir(TexCoords);
         vec3 skyLinear = texture(skybox, dir).rgb;
-        vec3 skyTM = skyLinear / (skyLinear + vec3(1.0));
-        const float gamma = 2.2;
-        skyTM = pow(skyTM, vec3(1.0/gamma));
-        FragColor = vec4(skyTM, 1.0);
+        FragColor = vec4(SampleLUT(reinhardLUT, skyLinear), 1.0);
     } else {
         FragColor = texture(tonemappedScene, TexCoords);
     }
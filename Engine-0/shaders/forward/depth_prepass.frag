@@ -0,0 +1,5 @@
+#version 450 core
+
+// depth only, linked with the vertex stages of the forward shader it fills depth for (see Renderer)
+void main() {
+}
\ No newline at end of file
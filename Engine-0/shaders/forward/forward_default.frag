@@ -0,0 +1,40 @@
+#version 450 core
+#include "../PBR/pbr_lighting.glsl"
+
+// forward+ variant of gbuffer_default.frag and gbuffer_tint.frag, and the fallback for materials without their own.
+// shaded like the deferred pass reads them: specular as roughness, no metal, no ao
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in vec3 FragPos;
+in vec3 Normal;
+in mat3 TBNMatrix;
+
+struct Material {
+	bool useDiffuseTexture;
+	bool useSpecularTexture;
+
+	vec3 diffuse;
+	float specular;
+
+	sampler2D texture_diffuse1;
+	sampler2D texture_normal1;
+	sampler2D texture_specular1;
+};
+uniform Material material;
+
+// reset per draw, only tinted materials set it
+uniform vec3 colorTint = vec3(1.0, 1.0, 1.0);
+uniform float tintStrength = 0.0;
+
+void main() {
+	vec3 normal = texture(material.texture_normal1, TexCoords).xyz * 2.0 - 1.0;
+	vec3 n = normalize(TBNMatrix * normal);
+
+	vec3 diffuse = material.useDiffuseTexture ? texture(material.texture_diffuse1, TexCoords).rgb : material.diffuse;
+	float spec = material.useSpecularTexture ? texture(material.texture_specular1, TexCoords).r : material.specular;
+	vec3 albedo = mix(diffuse, colorTint, tintStrength);
+
+	vec3 color = ShadeSurface(FragPos, n, albedo, max(spec, 0.0001), 0.0, 1.0, ivec2(gl_FragCoord.xy));
+	FragColor = vec4(color, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#version 450 core
+#include "../PBR/pbr_lighting.glsl"
+
+// forward+ variant of gbuffer_pbr.frag, lights come from the same tile lists as the deferred pass
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in vec3 FragPos;
+in vec3 Normal;
+in mat3 TBNMatrix;
+
+struct Material {
+	bool useDiffuseValue;
+	bool useRoughnessValue;
+	bool useMetallicValue;
+
+	vec3 diffuse;
+	float roughness;
+	float metallic;
+
+	sampler2D texture_diffuse1;
+	sampler2D texture_normal1;
+	sampler2D texture_specular1;
+	sampler2D texture_ao1;
+	sampler2D texture_roughness1;
+	sampler2D texture_metallic1;
+};
+uniform Material material;
+
+void main() {
+	vec3 normal = texture(material.texture_normal1, TexCoords).xyz * 2.0 - 1.0;
+	vec3 n = normalize(TBNMatrix * normal);
+
+	vec3 albedo = material.useDiffuseValue ? material.diffuse : texture(material.texture_diffuse1, TexCoords).rgb;
+	float roughness = material.useRoughnessValue ? material.roughness : texture(material.texture_roughness1, TexCoords).r;
+	float metallic = material.useMetallicValue ? material.metallic : texture(material.texture_metallic1, TexCoords).r;
+	float ao = max(texture(material.texture_ao1, TexCoords).r, 0.1);
+
+	vec3 color = ShadeSurface(FragPos, n, albedo, max(roughness, 0.0001), metallic, ao, ivec2(gl_FragCoord.xy));
+	FragColor = vec4(color, 1.0);
+}
\ No newline at end of file
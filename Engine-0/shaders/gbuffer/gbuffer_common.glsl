@@ -0,0 +1,34 @@
+// shared g-buffer encoding, included after the #version line.
+// normals are octahedral encoded into a RG16 unorm target, positions are rebuilt from the depth buffer.
+
+vec2 OctWrap(vec2 v) {
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 EncodeNormal(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+	return e * 0.5 + 0.5;
+}
+
+vec3 DecodeNormal(vec2 e) {
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+// screen space motion in uv units from the unjittered clip positions of this and the previous frame,
+// read by the temporal resolve to find last frame's pixel
+vec2 ScreenVelocity(vec4 currClip, vec4 prevClip) {
+	return (currClip.xy / currClip.w - prevClip.xy / prevClip.w) * 0.5;
+}
+
+// screen uv and window depth back through an inverse projection (inverse(projection) for view space,
+// inverse(projection * view) for world space)
+vec3 ReconstructPosition(vec2 uv, float depth, mat4 invProjection) {
+	vec4 p = invProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+	return p.xyz / p.w;
+}
\ No newline at end of file
@@ -1,4 +1,5 @@
 #version 330 core
+#include "gbuffer_common.glsl"
 
 layout (location = 0) out vec4 debugPosition;
 layout (location = 1) out vec4 debugNormal;
@@ -9,14 +10,17 @@ layout (location = 5) out vec4 debugAO;
 
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
 uniform sampler2D gAlbedoRoughness;
 uniform sampler2D gMetallicAO;
+uniform mat4 invViewProjection;
 
 void main() {
-	debugPosition = vec4(vec3(texture(gPosition, TexCoords)), 1.0);
-	debugNormal = vec4(vec3(texture(gNormal, TexCoords)), 1.0);
+	float depth = texture(gDepth, TexCoords).r;
+	vec3 position = depth < 1.0 ? ReconstructPosition(TexCoords, depth, invViewProjection) : vec3(0.0);
+	debugPosition = vec4(position, 1.0);
+	debugNormal = vec4(depth < 1.0 ? DecodeNormal(texture(gNormal, TexCoords).rg) : vec3(0.0), 1.0);
 	debugAlbedo = vec4(vec3(texture(gAlbedoRoughness, TexCoords)).rgb, 1.0);
 	debugMetallic = vec4(vec3(texture(gMetallicAO, TexCoords).r), 1.0);
 	debugRoughness = vec4(vec3(texture(gAlbedoRoughness, TexCoords).a), 1.0);
@@ -10,19 +10,23 @@ out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 out mat3 TBNMatrix;
+out vec4 CurrClipPos;
+out vec4 PrevClipPos;
 
-// view space outs
-out vec3 FragPosVS;
-out vec3 NormalVS;
-out mat3 TBNMatrixVS;
+// the forward prepass and shading pass link this stage into different programs, their depth has to match exactly
+invariant gl_Position;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// velocity, without the projection jitter
+uniform mat4 prevModel;
+uniform mat4 currViewProjection;
+uniform mat4 prevViewProjection;
+
 void main() {
 	FragPos = vec3(model * vec4(aPos, 1.0));
-	FragPosVS = vec3(view * model * vec4(aPos,1));
 
 	Normal = mat3(transpose(inverse(model))) * aNormal;
 	
@@ -35,13 +39,8 @@ void main() {
 	vec3 Bw = cross(Nw, Tw);
 	TBNMatrix = (mat3(Tw, Bw, Nw));
 
-	// TBN view matrix
-	mat3 viewRot = mat3(view);
-	vec3 Tv = normalize(viewRot * Tw);
-	vec3 Nv = normalize(viewRot * Nw);
-	vec3 Bv = cross(Nv, Tv);
-	TBNMatrixVS = mat3(Tv, Bv, Nv);
-	NormalVS  = Nv;
+	CurrClipPos = currViewProjection * vec4(FragPos, 1.0);
+	PrevClipPos = prevViewProjection * prevModel * vec4(aPos, 1.0);
 
 	gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -1,22 +1,18 @@
 #version 330 core
+#include "gbuffer_common.glsl"
 
-// world space outs
-layout (location = 0) out vec3 gPosition;
-layout (location = 1) out vec3 gNormal;
-layout (location = 2) out vec4 gAlbedoRoughness;
-layout (location = 3) out vec2 gMetallicAO;
-
-// view space outs
-layout (location = 4) out vec3 gPositionVS;
-layout (location = 5) out vec3 gNormalVS;
+// positions are reconstructed from depth, view space normals from the world normal
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec4 gAlbedoRoughness;
+layout (location = 2) out vec2 gMetallicAO;
+layout (location = 3) out vec2 gVelocity;
 
 in vec2 TexCoords;
 in vec3 FragPos;
 in vec3 Normal;
-in vec3 FragPosVS;
-in vec3 NormalVS;
 in mat3 TBNMatrix;
-in mat3 TBNMatrixVS;
+in vec4 CurrClipPos;
+in vec4 PrevClipPos;
 
 struct Material {
 	bool useDiffuseValue;
@@ -37,12 +33,8 @@ struct Material {
 uniform Material material;
 
 void main() {
-	gPosition = FragPos;
-	gPositionVS = FragPosVS;
-
 	vec3 normal = texture(material.texture_normal1, TexCoords).xyz * 2.0 - 1.0;
-	gNormal = normalize(TBNMatrix * normal);
-	gNormalVS = normalize(TBNMatrixVS * normal);
+	gNormal = EncodeNormal(normalize(TBNMatrix * normal));
 
 	vec3 diffuse = material.useDiffuseValue ? material.diffuse : texture(material.texture_diffuse1, TexCoords).rgb;
 	float roughness = material.useRoughnessValue ? material.roughness : texture(material.texture_roughness1, TexCoords).r;
@@ -51,4 +43,5 @@ void main() {
 
 	gAlbedoRoughness = vec4(diffuse, roughness);
 	gMetallicAO = vec2(metallic, ao);
+	gVelocity = ScreenVelocity(CurrClipPos, PrevClipPos);
 }
\ No newline at end of file
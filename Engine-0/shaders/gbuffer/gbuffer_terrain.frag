@@ -1,22 +1,17 @@
 #version 330 core
+#include "gbuffer_common.glsl"
 
-// world space outs
-layout (location = 0) out vec3 gPosition;
-layout (location = 1) out vec3 gNormal;
-layout (location = 2) out vec4 gAlbedoRoughness;
-layout (location = 3) out vec2 gMetallicAO;
-
-// view space outs
-layout (location = 4) out vec3 gPositionVS;
-layout (location = 5) out vec3 gNormalVS;
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec4 gAlbedoRoughness;
+layout (location = 2) out vec2 gMetallicAO;
+layout (location = 3) out vec2 gVelocity;
 
 in vec2 TexCoords;
 in vec3 FragPos;
 in vec3 Normal;
-in vec3 FragPosVS;
-in vec3 NormalVS;
 in mat3 TBNMatrix;
-in mat3 TBNMatrixVS;
+in vec4 CurrClipPos;
+in vec4 PrevClipPos;
 
 struct Material {
 	bool useDiffuseValue1;
@@ -44,9 +39,6 @@ struct Material {
 uniform Material material;
 
 void main() {
-	gPosition = FragPos;
-	gPositionVS = FragPosVS;
-
 	float up = Normal.y * 0.5 + 0.5;
 
 	// textures based on slope
@@ -66,9 +58,9 @@ void main() {
 	vec3 diffuse = mix(d1, d2, up);
 	float roughness = mix(r1, r2, up);
 	vec3 normal = mix(n1, n2, up);
-	gNormal = normalize(TBNMatrix * normal);
-	gNormalVS = normalize(TBNMatrixVS * normal);
+	gNormal = EncodeNormal(normalize(TBNMatrix * normal));
 
 	gAlbedoRoughness = vec4(diffuse, roughness);
 	gMetallicAO = vec2(0.0, ao);
+	gVelocity = ScreenVelocity(CurrClipPos, PrevClipPos);
 }
\ No newline at end of file
@@ -1,13 +1,17 @@
 #version 330 core
+#include "gbuffer_common.glsl"
 
-layout (location = 0) out vec3 gPosition;
-layout (location = 1) out vec3 gNormal;
-layout (location = 2) out vec4 gAlbedoSpec;
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec4 gAlbedoSpec;
+layout (location = 2) out vec2 gMetallicAO;
+layout (location = 3) out vec2 gVelocity;
 
 in vec2 TexCoords;
 in vec3 FragPos;
 in vec3 Normal;
 in mat3 TBNMatrix;
+in vec4 CurrClipPos;
+in vec4 PrevClipPos;
 
 struct Material {
 	bool useDiffuseTexture;
@@ -26,9 +30,10 @@ uniform vec3 colorTint = vec3(1.0, 1.0, 1.0);
 uniform float tintStrength = 1.0f;
 
 void main() {
-	gPosition = FragPos;
 	vec3 normal = texture(material.texture_normal1, TexCoords).xyz * 2.0 - 1.0;
-	gNormal = normalize(TBNMatrix * normal);
+	gNormal = EncodeNormal(normalize(TBNMatrix * normal));
+	gMetallicAO = vec2(0.0, 1.0);
+	gVelocity = ScreenVelocity(CurrClipPos, PrevClipPos);
 
 	vec3 diffuse = material.useDiffuseTexture ? texture(material.texture_diffuse1, TexCoords).rgb : material.diffuse;
 	float spec = material.useSpecularTexture ? texture(material.texture_specular1, TexCoords).r : material.specular;
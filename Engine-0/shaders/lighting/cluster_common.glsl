@@ -0,0 +1,43 @@
+// NOTE: light cluster grid shared by the culling, the shading passes and the lighting tile classification. Clusters
+// are screen tiles of tileSize pixels split into sliceCount logarithmic depth slices, the tiled culler is the same
+// grid with a single slice. clusterInfo holds the offset and count of every cluster's run in lightIndices. The
+// local environment probes are listed per screen tile only (every slice shares the list), PROBE_LIST_STRIDE uints
+// per tile, the count and then up to MAX_PROBES_PER_TILE probe indices, nearest to the camera first (same values in
+// light_system.h).
+
+#define MAX_PROBES_PER_TILE 8
+#define PROBE_LIST_STRIDE (MAX_PROBES_PER_TILE + 1)
+#define MAX_LOCAL_PROBES 32
+
+// Tile and slice layout
+uniform ivec2 screenSize;
+uniform ivec2 tileCount;
+uniform int tileSize;
+uniform int sliceCount;
+uniform vec2 sliceParams;	// slice = log(view distance) * x + y
+uniform vec2 depthRange;	// near, far of the projection
+
+// view distance (positive) of a window depth
+float LinearDepth(float depth) {
+	float z = depth * 2.0 - 1.0;
+	return 2.0 * depthRange.x * depthRange.y / (depthRange.y + depthRange.x - z * (depthRange.y - depthRange.x));
+}
+
+int DepthSlice(float viewDistance) {
+	return clamp(int(floor(log(max(viewDistance, 1e-4)) * sliceParams.x + sliceParams.y)), 0, sliceCount - 1);
+}
+
+// view distance where a slice begins, slice sliceCount is the far plane
+float SliceDistance(int slice) {
+	return exp((float(slice) - sliceParams.y) / sliceParams.x);
+}
+
+int ClusterIndex(ivec2 pixel, float viewDistance) {
+	ivec2 tile = min(pixel / tileSize, tileCount - 1);
+	return (DepthSlice(viewDistance) * tileCount.y + tile.y) * tileCount.x + tile.x;
+}
+
+int ProbeTileIndex(ivec2 pixel) {
+	ivec2 tile = min(pixel / tileSize, tileCount - 1);
+	return tile.y * tileCount.x + tile.x;
+}
\ No newline at end of file
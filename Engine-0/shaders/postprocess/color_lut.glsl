@@ -0,0 +1,22 @@
+// NOTE: log2 shaper of the baked color luts. Each channel of an hdr color between 2^LUT_MIN_LOG and 2^LUT_MAX_LOG
+// maps linearly onto the lut cube, which keeps the precision where the tonemap curve changes fastest. The low end
+// is far enough down that black stays below one 8 bit step after gamma.
+#define LUT_SIZE 32.0
+#define LUT_MIN_LOG -18.0
+#define LUT_MAX_LOG 6.0
+
+vec3 LinearToLUT(vec3 c) {
+	return clamp((log2(max(c, vec3(1e-10))) - LUT_MIN_LOG) / (LUT_MAX_LOG - LUT_MIN_LOG), 0.0, 1.0);
+}
+
+vec3 LUTToLinear(vec3 t) {
+	return exp2(mix(vec3(LUT_MIN_LOG), vec3(LUT_MAX_LOG), t));
+}
+
+uniform sampler2D exposureTex;	// 1x1, r = auto exposure multiplier (1 when auto exposure is off)
+
+// remapped onto the texel centers so both ends of the range are exact
+vec3 SampleLUT(sampler3D lut, vec3 hdr) {
+	vec3 t = LinearToLUT(hdr * texelFetch(exposureTex, ivec2(0), 0).r);
+	return texture(lut, t * ((LUT_SIZE - 1.0) / LUT_SIZE) + 0.5 / LUT_SIZE).rgb;
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+#version 330 core
+
+// NOTE: fused post chain. Bloom combine, tonemapping, the sky composite and the cel shading pass run in one full
+// screen pass, each pixel of the hdr scene is read once and the final color written once. Stages are compiled in
+// with defines (BLOOM, SKY, CEL_SHADING), the math matches bloom.frag, rh_tonemapping.frag, composite.frag and
+// pp_celshading.frag. Tonemapping, grading and gamma are a single fetch from the baked luts.
+// The scene alpha is the geometry coverage (premultiplied, the sky is black until composited here), so the
+// sky blends behind anti aliased edges instead of being cut by the depth test.
+#include "color_lut.glsl"
+
+out vec4 FragColor;
+in vec2 TexCoords;
+
+uniform sampler2D hdrScene;
+uniform sampler3D filmicLUT;
+
+#ifdef BLOOM
+uniform sampler2D bloomTexture;
+uniform float bloomScale;		// mip chain normalization
+uniform float bloomExposure;
+#endif
+
+#ifdef CEL_SHADING
+uniform sampler2D sceneDepth;
+#endif
+
+#if defined(SKY) || defined(CEL_SHADING)
+uniform sampler3D reinhardLUT;
+#endif
+
+#ifdef SKY
+uniform samplerCube skybox;
+uniform mat4 invProjection;
+uniform mat4 invView;
+#endif
+
+#ifdef CEL_SHADING
+uniform sampler2D gAlbedoRoughness;
+#endif
+
+#ifdef SKY
+vec3 reconstructDir(vec2 uv) {
+	vec4 ndc = vec4(uv * 2.0 - 1.0, 1.0, 1.0);
+	vec4 view = invProjection * ndc;
+	view /= view.w;
+	return normalize((invView * vec4(view.xyz, 0.0)).xyz);
+}
+#endif
+
+#ifdef CEL_SHADING
+vec3 RGBtoHSV(vec3 c) {
+	float maxc = max(c.r, max(c.g, c.b));
+	float minc = min(c.r, min(c.g, c.b));
+	float d = maxc - minc;
+	float h = 0.0;
+	if (d > 0.0) {
+		if (maxc == c.r) h = mod((c.g - c.b) / d, 6.0);
+		else if (maxc == c.g) h = (c.b - c.r) / d + 2.0;
+		else h = (c.r - c.g) / d + 4.0;
+		h /= 6.0;
+	}
+	float s = maxc > 0.0 ? d / maxc : 0.0;
+	return vec3(h, s, maxc);
+}
+
+vec3 HSVtoRGB(vec3 c) {
+	float h = c.x * 6.0;
+	float s = c.y, v = c.z;
+	int i = int(floor(h));
+	float f = fract(h);
+	float p = v * (1.0 - s);
+	float q = v * (1.0 - s * f);
+	float t = v * (1.0 - s * (1.0 - f));
+	if (i == 0) return vec3(v, t, p);
+	else if (i == 1) return vec3(q, v, p);
+	else if (i == 2) return vec3(p, v, t);
+	else if (i == 3) return vec3(p, q, v);
+	else if (i == 4) return vec3(t, p, v);
+	else return vec3(v, p, q);
+}
+#endif
+
+void main() {
+	vec4 scene = texture(hdrScene, TexCoords);
+	vec3 hdr = scene.rgb / max(scene.a, 1e-4);
+
+#ifdef BLOOM
+	hdr += texture(bloomTexture, TexCoords).rgb * bloomScale * bloomExposure;
+#endif
+
+#ifdef SKY
+	if (scene.a < 0.999) {
+		vec3 skyLinear = texture(skybox, reconstructDir(TexCoords)).rgb;
+		vec3 sky = SampleLUT(reinhardLUT, skyLinear);
+		FragColor = vec4(mix(sky, SampleLUT(filmicLUT, hdr), scene.a), 1.0);
+		return;
+	}
+#endif
+
+#ifdef CEL_SHADING
+	float d = texture(sceneDepth, TexCoords).r;
+	if (d <= 0.999) {
+		vec3 baseColor = max(texture(gAlbedoRoughness, TexCoords).rgb, 0.0001);
+		vec3 hsv = RGBtoHSV(hdr / baseColor);
+		float p_v = pow(2, round(log2(hsv.z)));
+		vec3 celColor = baseColor * HSVtoRGB(vec3(hsv.xy, p_v));
+		FragColor = vec4(SampleLUT(reinhardLUT, celColor), 1.0);
+		return;
+	}
+#endif
+
+	FragColor = vec4(SampleLUT(filmicLUT, hdr), 1.0);
+}
\ No newline at end of file
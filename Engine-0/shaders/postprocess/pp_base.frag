@@ -2,8 +2,7 @@
 out vec4 FragColor;
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
-uniform sampler2D gNormal;
+uniform sampler2D gNormal;			// octahedral encoded, see gbuffer_common.glsl
 uniform sampler2D gAlbedoRoughness;
 uniform sampler2D gMetallicAO;
 uniform sampler2D sceneDepth;
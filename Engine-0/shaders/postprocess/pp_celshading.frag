@@ -1,9 +1,9 @@
 #version 330 core
+#include "color_lut.glsl"
 out vec4 FragColor;
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
-uniform sampler2D gNormal;
+uniform sampler2D gNormal;			// octahedral encoded, see gbuffer_common.glsl
 uniform sampler2D gAlbedoRoughness;
 uniform sampler2D gMetallicAO;
 uniform sampler2D sceneDepth;
@@ -12,14 +12,19 @@ uniform sampler2D sceneColor;	    // tonemapped, LDR
 uniform sampler2D brightPass;
 uniform sampler2D bloomPass;	    // blurred brightPass
 uniform sampler2D compositePass;    // final output
+uniform sampler3D reinhardLUT;
+uniform bool gBufferValid;          // false on the forward+ path, there is no albedo to cel shade against
 
 vec3 RGBtoHSV(vec3 c);
 vec3 HSVtoRGB(vec3 c);
 vec3 desaturation(vec3 color, float saturation);
 
-const float gamma = 2.2;
-
 void main() {
+    if (!gBufferValid) {
+        FragColor = texture(compositePass, TexCoords);
+        return;
+    }
+
 	vec3 pp0 = texture(sceneHDR, TexCoords).rgb;
     vec3 baseColor = max(texture(gAlbedoRoughness, TexCoords).rgb, 0.0001);
     vec3 hsv = RGBtoHSV(pp0 / baseColor);
@@ -29,8 +34,7 @@ void main() {
     vec3 celColor = baseColor * cel;
 
     // gamma correction and hdr
-    vec3 mapped = celColor / (celColor + vec3(1.0));
-    mapped = pow(mapped, vec3(1.0 / gamma));
+    vec3 mapped = SampleLUT(reinhardLUT, celColor);
 
     float d = texture(sceneDepth, TexCoords).r;
     if (d > 0.999) FragColor = texture(compositePass, TexCoords);
@@ -1,5 +1,9 @@
 #version 450 core
-layout (location = 0) out vec2 moments;
+layout (location = 0) out vec4 moments;
+
+// 0 = vsm, 1 = evsm (positive exponent), 2 = evsm (positive and negative exponents)
+uniform int shadowMode;
+uniform vec2 evsmExponents;
 
 void main() {
 	float d = gl_FragCoord.z;
@@ -11,10 +15,19 @@ void main() {
 	float bias = 0.0005;
 	float db = d + bias;
 
-	vec2 m;
-	m.x = db;
-	m.y = db * db + var;
-	moments = m;
+	if (shadowMode == 0) {
+		vec2 m;
+		m.x = db;
+		m.y = db * db + var;
+		moments = vec4(m, 0.0, 0.0);
+		return;
+	}
+
+	// exponential warp of the depth in [-1, 1]
+	float w = db * 2.0 - 1.0;
+	float pos = exp(evsmExponents.x * w);
+	float neg = -exp(-evsmExponents.y * w);
+	moments = vec4(pos, pos * pos, neg, neg * neg);
 
 //	float d = gl_FragCoord.z;
 //	moments = vec2(d, d*d);
@@ -0,0 +1,10 @@
+#version 450 core
+in vec3 worldPos;
+
+uniform vec3 lightPos;
+uniform float farPlane;	// light radius
+
+// linear distance to the light, compared against length(fragPos - lightPos) / radius when sampling
+void main() {
+	gl_FragDepth = clamp(length(worldPos - lightPos) / farPlane, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 lightSpaceMatrix;	// one cube face
+uniform mat4 model;
+
+out vec3 worldPos;
+
+void main() {
+	vec4 world = model * vec4(aPos, 1.0);
+	worldPos = world.xyz;
+	gl_Position = lightSpaceMatrix * world;
+}
\ No newline at end of file
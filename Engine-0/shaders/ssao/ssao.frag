@@ -1,34 +1,48 @@
 #version 330 core
-out float FragColor;
+#include "../gbuffer/gbuffer_common.glsl"
+out vec2 FragColor;	// ao, view depth (the half resolution passes compare against it)
 
 in vec2 TexCoords;
 
-uniform sampler2D gPositionVS;
-uniform sampler2D gNormalVS;
+uniform sampler2D gDepth;
+uniform sampler2D gNormal;
 uniform sampler2D texNoise;
 
 uniform vec3 samples[64];
 uniform mat4 projection;
+uniform mat4 invProjection;
+uniform mat4 view;
 
-// based on resolution/noise size from texNoise texture
-const vec2 noiseScale = vec2(1600.0/4.0, 1200.0/4.0); 
+// the kernel is split into interleaved subsets (sample i * sampleStride + sampleOffset), the half resolution
+// path takes a different subset every frame and lets the temporal pass combine them
+uniform int sampleCount;
+uniform int sampleStride;
+uniform int sampleOffset;
+uniform float noiseRotation;
+
+// output resolution / noise size from texNoise texture
+uniform vec2 noiseScale;
 void main() {
-	vec3 fragPos = texture(gPositionVS, TexCoords).rgb;
-	vec3 normal = texture(gNormalVS, TexCoords).rgb;
-	vec3 randomVec = texture(texNoise, TexCoords * noiseScale).rgb;
+	// runs at full or half resolution, always read the g-buffer texel under the pixel center
+	ivec2 pixel = ivec2(TexCoords * vec2(textureSize(gDepth, 0)));
+	vec2 uv = (vec2(pixel) + 0.5) / vec2(textureSize(gDepth, 0));
+	vec3 fragPos = ReconstructPosition(uv, texelFetch(gDepth, pixel, 0).r, invProjection);
+	vec3 normal = normalize(mat3(view) * DecodeNormal(texelFetch(gNormal, pixel, 0).rg));
+	vec3 noise = texture(texNoise, TexCoords * noiseScale).rgb;
+	float c = cos(noiseRotation), s = sin(noiseRotation);
+	vec3 randomVec = vec3(c * noise.x - s * noise.y, s * noise.x + c * noise.y, 0.0);
 
 	// orthogonal basis with slight tilt from randomVec
 	vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
 	vec3 bitangent = cross(normal, tangent);
 	mat3 TBN = mat3(tangent, bitangent, normal);
 
-	int kernelSize = 64;
 	float radius = 0.5;
 	float occlusion = 0.0;
 
-	for (int i = 0; i < kernelSize; ++i) {
+	for (int i = 0; i < sampleCount; ++i) {
 		// transform kernel sample from tangent space to view-space
-		vec3 sample = TBN * samples[i];
+		vec3 sample = TBN * samples[i * sampleStride + sampleOffset];
 		
 		// sample will be the offset from the current fragment position scaled from the radius
 		sample = fragPos + sample * radius;
@@ -41,14 +55,14 @@ void main() {
 		// transform range to 0.0 - 1.0
 		offset.xyz = offset.xyz * 0.5 + 0.5;
 
-		float sampleDepth = texture(gPositionVS, offset.xy).z;
+		float sampleDepth = ReconstructPosition(offset.xy, texture(gDepth, offset.xy).r, invProjection).z;
 
 		float rangeCheck = smoothstep(0.0, 1.0, radius / abs(fragPos.z - sampleDepth));
 		float bias = 0.025;
 		occlusion += (sampleDepth >= sample.z + bias ? 1.0 : 0.0) * rangeCheck;
 	}
 
-	occlusion = 1.0 - (occlusion / kernelSize); // one minus normalize based on kernel size
+	occlusion = 1.0 - (occlusion / sampleCount); // one minus normalize based on kernel size
 
-	FragColor = occlusion;
+	FragColor = vec2(occlusion, fragPos.z);
 }
\ No newline at end of file
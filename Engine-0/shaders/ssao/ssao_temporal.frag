@@ -0,0 +1,50 @@
+#version 330 core
+#include "../gbuffer/gbuffer_common.glsl"
+
+// NOTE: accumulates the half resolution ao over frames. The pixel is reprojected with the camera matrices of the
+// previous frame, the history is dropped when it is off screen or when its stored view depth does not match the
+// reprojected depth (disocclusion). Every frame sees a different kernel subset, so the running average converges
+// to the full kernel after a few frames.
+out vec4 FragColor;	// ao, view depth, accumulated frames
+
+in vec2 TexCoords;
+
+uniform sampler2D ssaoInput;	// ao, view depth
+uniform sampler2D history;
+uniform sampler2D gDepth;
+
+uniform mat4 invViewProjection;
+uniform mat4 prevViewProjection;
+uniform mat4 prevView;
+uniform bool historyValid;
+uniform float maxFrames;
+
+const float depthTolerance = 0.05;	// relative view depth difference that still counts as the same surface
+
+void main() {
+	vec2 current = texelFetch(ssaoInput, ivec2(gl_FragCoord.xy), 0).rg;
+
+	// the g-buffer texel the ao pass used for this pixel
+	ivec2 pixel = ivec2(TexCoords * vec2(textureSize(gDepth, 0)));
+	vec2 uv = (vec2(pixel) + 0.5) / vec2(textureSize(gDepth, 0));
+	float depth = texelFetch(gDepth, pixel, 0).r;
+
+	float frames = 1.0;
+	float ao = current.r;
+	if (historyValid && depth < 1.0) {
+		vec3 worldPos = ReconstructPosition(uv, depth, invViewProjection);
+		vec4 prevClip = prevViewProjection * vec4(worldPos, 1.0);
+		vec2 prevUV = prevClip.xy / prevClip.w * 0.5 + 0.5;
+
+		if (prevClip.w > 0.0 && all(greaterThanEqual(prevUV, vec2(0.0))) && all(lessThanEqual(prevUV, vec2(1.0)))) {
+			vec3 h = texture(history, prevUV).rgb;
+			float expectedDepth = (prevView * vec4(worldPos, 1.0)).z;
+			if (abs(h.g - expectedDepth) < depthTolerance * abs(expectedDepth)) {
+				frames = min(h.b + 1.0, maxFrames);
+				ao = mix(h.r, current.r, 1.0 / frames);
+			}
+		}
+	}
+
+	FragColor = vec4(ao, current.g, frames, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#version 330 core
+#include "../gbuffer/gbuffer_common.glsl"
+
+// NOTE: joint bilateral upsample of the accumulated half resolution ao, replaces ssao_blur.frag on that path.
+// Each full resolution pixel blends a 4x4 footprint of half resolution texels with tent weights, scaled down
+// where their view depth or normal differs from the pixel so ao does not bleed across edges.
+out float FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D ssaoInput;	// ao, view depth
+uniform sampler2D gDepth;
+uniform sampler2D gNormal;
+uniform mat4 invProjection;
+
+const float depthSigma = 0.02;	// relative to the pixel's view depth
+const float normalPower = 8.0;
+
+void main() {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 fullSize = textureSize(gDepth, 0);
+	ivec2 halfSize = textureSize(ssaoInput, 0);
+
+	float viewZ = ReconstructPosition(TexCoords, texelFetch(gDepth, pixel, 0).r, invProjection).z;
+	vec3 normal = DecodeNormal(texelFetch(gNormal, pixel, 0).rg);
+
+	// pixel center in half resolution texel space
+	vec2 halfPos = (vec2(pixel) + 0.5) * vec2(halfSize) / vec2(fullSize) - 0.5;
+	ivec2 base = ivec2(floor(halfPos));
+
+	float sum = 0.0;
+	float weightSum = 0.0;
+	for (int y = -1; y <= 2; y++) {
+		for (int x = -1; x <= 2; x++) {
+			ivec2 t = clamp(base + ivec2(x, y), ivec2(0), halfSize - 1);
+			vec2 s = texelFetch(ssaoInput, t, 0).rg;
+
+			vec2 d = abs(vec2(t) - halfPos);
+			float spatial = max(2.0 - d.x, 0.0) * max(2.0 - d.y, 0.0);
+			float depthWeight = exp(-abs(s.g - viewZ) / (depthSigma * abs(viewZ) + 1e-4));
+			// the normal the ao pass saw for this texel
+			ivec2 source = clamp(ivec2((vec2(t) + 0.5) * vec2(fullSize) / vec2(halfSize)), ivec2(0), fullSize - 1);
+			vec3 n = DecodeNormal(texelFetch(gNormal, source, 0).rg);
+			float normalWeight = pow(max(dot(n, normal), 0.0), normalPower);
+
+			float w = spatial * depthWeight * normalWeight;
+			sum += s.r * w;
+			weightSum += w;
+		}
+	}
+
+	// no neighbour on the same surface (thin features), fall back to the closest texel
+	if (weightSum < 1e-4) FragColor = texelFetch(ssaoInput, clamp(ivec2(halfPos + 0.5), ivec2(0), halfSize - 1), 0).r;
+	else FragColor = sum / weightSum;
+}
\ No newline at end of file
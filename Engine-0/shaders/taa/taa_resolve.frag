@@ -0,0 +1,164 @@
+#version 450 core
+#include "../gbuffer/gbuffer_common.glsl"
+
+// NOTE: temporal anti aliasing and upsampling. The scene passes render at renderSize with a sub pixel jitter that
+// changes every frame. Each output pixel filters the 3x3 jittered samples around it by their distance, and blends
+// them into last frame's output found through the velocity buffer (or the camera reprojection of the depth for
+// the sky and the forward path). The history is clipped to the color range of those samples in YCoCg, which
+// drops stale colors on disocclusion without keeping a depth history. Alpha is the geometry coverage.
+
+layout (location = 0) out vec4 History;		// read back next frame
+layout (location = 1) out vec4 Resolved;	// input of the post chain, free to be modified
+
+in vec2 TexCoords;
+
+uniform sampler2D sceneColor;	// render resolution, jittered
+uniform sampler2D gDepth;
+uniform sampler2D gVelocity;
+uniform sampler2D history;		// output resolution, linear filtered
+
+uniform vec2 renderSize;
+uniform vec2 outputSize;
+uniform vec2 jitter;				// offset of this frame's image in render pixels
+uniform mat4 invViewProjection;		// jittered, matches gDepth
+uniform mat4 prevViewProjection;	// unjittered
+uniform bool useVelocity;			// false when nothing wrote the velocity buffer (forward+)
+uniform bool historyValid;
+uniform float feedback;				// history weight of a pixel the current samples cover well
+
+vec3 RGBToYCoCg(vec3 c) {
+	return vec3(
+		 0.25 * c.r + 0.5 * c.g + 0.25 * c.b,
+		 0.5  * c.r             - 0.5  * c.b,
+		-0.25 * c.r + 0.5 * c.g - 0.25 * c.b);
+}
+
+vec3 YCoCgToRGB(vec3 c) {
+	return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+// inverse luminance weight, keeps single bright samples from flickering through the filter and the blend
+float LumaWeight(vec3 c) {
+	return 1.0 / (1.0 + max(c.r, max(c.g, c.b)));
+}
+
+// 5 tap catmull-rom, the bilinear taps are combined so the history stays sharp when it is resampled every frame
+vec4 SampleHistory(vec2 uv) {
+	vec2 samplePos = uv * outputSize;
+	vec2 texPos1 = floor(samplePos - 0.5) + 0.5;
+	vec2 f = samplePos - texPos1;
+
+	vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+	vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+	vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+	vec2 w3 = f * f * (-0.5 + 0.5 * f);
+	vec2 w12 = w1 + w2;
+
+	vec2 tc0 = (texPos1 - 1.0) / outputSize;
+	vec2 tc3 = (texPos1 + 2.0) / outputSize;
+	vec2 tc12 = (texPos1 + w2 / w12) / outputSize;
+
+	vec4 result =
+		texture(history, vec2(tc12.x, tc0.y)) * w12.x * w0.y +
+		texture(history, vec2(tc0.x, tc12.y)) * w0.x * w12.y +
+		texture(history, tc12) * w12.x * w12.y +
+		texture(history, vec2(tc3.x, tc12.y)) * w3.x * w12.y +
+		texture(history, vec2(tc12.x, tc3.y)) * w12.x * w3.y;
+	float weight = w12.x * w0.y + w0.x * w12.y + w12.x * w12.y + w3.x * w12.y + w12.x * w3.y;
+	return max(result / weight, 0.0);
+}
+
+// moves the history towards the neighborhood mean until it is inside the box
+vec3 ClipToBox(vec3 history, vec3 boxMin, vec3 boxMax) {
+	vec3 center = 0.5 * (boxMax + boxMin);
+	vec3 extent = max(0.5 * (boxMax - boxMin), 1e-5);
+	vec3 offset = history - center;
+	vec3 units = abs(offset / extent);
+	float maxUnit = max(units.x, max(units.y, units.z));
+	return maxUnit > 1.0 ? center + offset / maxUnit : history;
+}
+
+void main() {
+	// output pixel center in the texel space of the jittered image
+	vec2 samplePos = TexCoords * renderSize + jitter;
+	ivec2 nearest = ivec2(floor(samplePos));
+	ivec2 maxTexel = ivec2(renderSize) - 1;
+
+	vec4 current = vec4(0.0);
+	float weightSum = 0.0;
+	float maxWeight = 0.0;
+	vec3 m1 = vec3(0.0), m2 = vec3(0.0);
+	vec3 boxMin = vec3(1e9), boxMax = vec3(-1e9);
+	float coverageMin = 1.0, coverageMax = 0.0;
+	float closestDepth = 1.0;
+	ivec2 closestTexel = nearest;
+
+	for (int y = -1; y <= 1; y++) {
+		for (int x = -1; x <= 1; x++) {
+			ivec2 texel = clamp(nearest + ivec2(x, y), ivec2(0), maxTexel);
+			vec4 s = texelFetch(sceneColor, texel, 0);
+			s.rgb = max(s.rgb, 0.0);
+
+			// gaussian fit of blackman-harris over the distance in render pixels
+			vec2 d = vec2(texel) + 0.5 - samplePos;
+			float w = exp(-2.29 * dot(d, d)) * LumaWeight(s.rgb);
+			current += s * w;
+			weightSum += w;
+			maxWeight = max(maxWeight, exp(-2.29 * dot(d, d)));
+
+			vec3 c = RGBToYCoCg(s.rgb);
+			m1 += c;
+			m2 += c * c;
+			boxMin = min(boxMin, c);
+			boxMax = max(boxMax, c);
+			coverageMin = min(coverageMin, s.a);
+			coverageMax = max(coverageMax, s.a);
+
+			// motion of the closest surface, keeps the edges of moving objects with the object
+			float depth = texelFetch(gDepth, texel, 0).r;
+			if (depth < closestDepth) {
+				closestDepth = depth;
+				closestTexel = texel;
+			}
+		}
+	}
+	current /= max(weightSum, 1e-5);
+
+	vec2 motion;
+	if (useVelocity && closestDepth < 1.0) {
+		motion = texelFetch(gVelocity, closestTexel, 0).xy;
+	}
+	else {
+		// camera motion only, the depth of the closest texel is reprojected with last frame's matrix
+		float depth = texelFetch(gDepth, closestTexel, 0).r;
+		vec2 uv = (vec2(closestTexel) + 0.5) / renderSize;
+		vec3 worldPos = ReconstructPosition(uv, depth, invViewProjection);
+		vec4 prevClip = prevViewProjection * vec4(worldPos, 1.0);
+		motion = (uv - jitter / renderSize) - (prevClip.xy / prevClip.w * 0.5 + 0.5);
+	}
+	vec2 prevUV = TexCoords - motion;
+
+	if (!historyValid || any(lessThan(prevUV, vec2(0.0))) || any(greaterThan(prevUV, vec2(1.0)))) {
+		History = current;
+		Resolved = current;
+		return;
+	}
+
+	// variance box, tightened by the min max of the samples
+	vec3 mean = m1 / 9.0;
+	vec3 sigma = sqrt(abs(m2 / 9.0 - mean * mean));
+	boxMin = max(boxMin, mean - sigma * 1.25);
+	boxMax = min(boxMax, mean + sigma * 1.25);
+
+	vec4 previous = SampleHistory(prevUV);
+	previous.rgb = YCoCgToRGB(ClipToBox(RGBToYCoCg(previous.rgb), boxMin, boxMax));
+	previous.a = clamp(previous.a, coverageMin, coverageMax);
+
+	// the current frame counts for less where no sample lands close to this output pixel (upsampling)
+	float historyWeight = feedback * LumaWeight(previous.rgb);
+	float currentWeight = (1.0 - feedback) * maxWeight * LumaWeight(current.rgb);
+	vec4 result = (previous * historyWeight + current * currentWeight) / max(historyWeight + currentWeight, 1e-5);
+
+	History = result;
+	Resolved = result;
+}
\ No newline at end of file
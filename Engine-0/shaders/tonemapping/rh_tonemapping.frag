@@ -1,18 +1,12 @@
 #version 330 core
+#include "../postprocess/color_lut.glsl"
 out vec4 FragColor;
 in vec2 TexCoords;
 
 uniform sampler2D hdrScene;
-uniform float exposure;
+uniform sampler3D filmicLUT;	// exposure, filmic curve, grading and gamma baked by lut_bake.comp
 
 void main() {
-	const float gamma = 2.2;
 	vec3 hdrColor = texture(hdrScene, TexCoords).rgb;
-
-	// reinhard tonemapping
-	// vec3 mapped = hdrColor / (hdrColor + vec3(1.0));
-	// filmic tonemapping
-	vec3 mapped = vec3(1.0) - exp(-hdrColor * exposure);
-	mapped = pow(mapped, vec3(1.0 / gamma));
-	FragColor = vec4(mapped, 1.0);
+	FragColor = vec4(SampleLUT(filmicLUT, hdrColor), 1.0);
 }
\ No newline at end of file
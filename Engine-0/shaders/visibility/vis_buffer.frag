@@ -0,0 +1,10 @@
+#version 450 core
+
+// the only geometry pass output besides depth, attributes are fetched again in the resolve
+layout (location = 0) out uvec2 visibility;
+
+uniform uint drawID;	// 1 based, 0 is empty
+
+void main() {
+	visibility = uvec2(drawID, uint(gl_PrimitiveID));
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+#version 450 core
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 viewProjection;
+
+void main() {
+	gl_Position = viewProjection * model * vec4(aPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 450 core
+
+// writes the draw id as a 16 bit depth so every resolve draw only shades its own pixels (early depth equal test)
+
+in vec2 TexCoords;
+
+uniform usampler2D visibility;
+
+void main() {
+	uint id = texelFetch(visibility, ivec2(gl_FragCoord.xy), 0).x;
+	if (id == 0u) discard;
+	gl_FragDepth = float(id) / 65535.0;
+}
\ No newline at end of file
@@ -0,0 +1,148 @@
+#version 450 core
+#include "../gbuffer/gbuffer_common.glsl"
+
+// NOTE: visibility buffer resolve for one draw. The triangle is fetched from the mesh buffers (bound as storage
+// buffers), its attributes are interpolated with perspective correct barycentrics and the material is evaluated
+// the same way gbuffer_pbr.frag does, so the lighting pass does not know which path filled the g-buffer.
+
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec4 gAlbedoRoughness;
+layout (location = 2) out vec2 gMetallicAO;
+layout (location = 3) out vec2 gVelocity;
+
+// matches Vertex in mesh.h: position, normal, uv, tangent, bitangent
+#define VERTEX_STRIDE 14
+#define OFFSET_NORMAL 3
+#define OFFSET_UV 6
+#define OFFSET_TANGENT 8
+
+layout(std430, binding = 3) readonly buffer VertexBuf {
+	float vertexData[];
+};
+
+layout(std430, binding = 4) readonly buffer IndexBuf {
+	uint indexData[];
+};
+
+uniform usampler2D visibility;
+uniform mat4 model;
+uniform mat4 viewProjection;
+uniform mat4 prevModel;				// velocity, without the projection jitter
+uniform mat4 currViewProjection;
+uniform mat4 prevViewProjection;
+uniform bool indexed;		// meshes without indices draw their vertices in order
+uniform uint firstIndex;	// lod range in the element buffer
+uniform vec2 screenSize;
+
+struct Material {
+	bool useDiffuseValue;
+	bool useRoughnessValue;
+	bool useMetallicValue;
+
+	vec3 diffuse;
+	float roughness;
+	float metallic;
+
+	sampler2D texture_diffuse1;
+	sampler2D texture_normal1;
+	sampler2D texture_specular1;
+	sampler2D texture_ao1;
+	sampler2D texture_roughness1;
+	sampler2D texture_metallic1;
+};
+uniform Material material;
+
+struct Barycentrics {
+	vec3 lambda;
+	vec3 ddx;	// change of lambda for one pixel step in x
+	vec3 ddy;
+};
+
+vec3 FetchVec3(uint v, int offset) {
+	uint base = v * VERTEX_STRIDE + offset;
+	return vec3(vertexData[base], vertexData[base + 1], vertexData[base + 2]);
+}
+
+vec2 FetchVec2(uint v, int offset) {
+	uint base = v * VERTEX_STRIDE + offset;
+	return vec2(vertexData[base], vertexData[base + 1]);
+}
+
+// barycentrics of the pixel center from the clip space corners, plus their screen space derivatives for
+// texture lod (the resolve has no helper pixels on the triangle, so dFdx would cross triangle borders)
+Barycentrics ComputeBarycentrics(vec4 p0, vec4 p1, vec4 p2, vec2 ndc) {
+	Barycentrics b;
+	vec3 invW = 1.0 / vec3(p0.w, p1.w, p2.w);
+	vec2 n0 = p0.xy * invW.x;
+	vec2 n1 = p1.xy * invW.y;
+	vec2 n2 = p2.xy * invW.z;
+
+	float invDet = 1.0 / determinant(mat2(n2 - n1, n0 - n1));
+	vec3 dx = vec3(n1.y - n2.y, n2.y - n0.y, n0.y - n1.y) * invDet * invW;
+	vec3 dy = vec3(n2.x - n1.x, n0.x - n2.x, n1.x - n0.x) * invDet * invW;
+	float dxSum = dx.x + dx.y + dx.z;
+	float dySum = dy.x + dy.y + dy.z;
+
+	// 1/w is linear in screen space, interpolate it and divide the linear barycentrics by it
+	vec2 delta = ndc - n0;
+	float interpInvW = invW.x + delta.x * dxSum + delta.y * dySum;
+	float interpW = 1.0 / interpInvW;
+	b.lambda = interpW * (vec3(invW.x, 0.0, 0.0) + delta.x * dx + delta.y * dy);
+
+	// one pixel is 2 / size in ndc
+	vec2 pixel = 2.0 / screenSize;
+	dx *= pixel.x;
+	dy *= pixel.y;
+	dxSum *= pixel.x;
+	dySum *= pixel.y;
+	b.ddx = (b.lambda * interpInvW + dx) / (interpInvW + dxSum) - b.lambda;
+	b.ddy = (b.lambda * interpInvW + dy) / (interpInvW + dySum) - b.lambda;
+	return b;
+}
+
+void main() {
+	uvec2 vis = texelFetch(visibility, ivec2(gl_FragCoord.xy), 0).xy;
+	uint base = firstIndex + vis.y * 3u;
+	uint i0 = indexed ? indexData[base] : base;
+	uint i1 = indexed ? indexData[base + 1u] : base + 1u;
+	uint i2 = indexed ? indexData[base + 2u] : base + 2u;
+
+	vec3 v0 = FetchVec3(i0, 0);
+	vec3 v1 = FetchVec3(i1, 0);
+	vec3 v2 = FetchVec3(i2, 0);
+	mat4 mvp = viewProjection * model;
+	vec4 p0 = mvp * vec4(v0, 1.0);
+	vec4 p1 = mvp * vec4(v1, 1.0);
+	vec4 p2 = mvp * vec4(v2, 1.0);
+	vec2 ndc = gl_FragCoord.xy / screenSize * 2.0 - 1.0;
+	Barycentrics b = ComputeBarycentrics(p0, p1, p2, ndc);
+
+	vec4 localPos = vec4(mat3(v0, v1, v2) * b.lambda, 1.0);
+	gVelocity = ScreenVelocity(currViewProjection * model * localPos, prevViewProjection * prevModel * localPos);
+
+	vec2 uv0 = FetchVec2(i0, OFFSET_UV);
+	vec2 uv1 = FetchVec2(i1, OFFSET_UV);
+	vec2 uv2 = FetchVec2(i2, OFFSET_UV);
+	vec2 uv = mat3x2(uv0, uv1, uv2) * b.lambda;
+	vec2 uvDx = mat3x2(uv0, uv1, uv2) * b.ddx;
+	vec2 uvDy = mat3x2(uv0, uv1, uv2) * b.ddy;
+
+	// same TBN as gbuffer_default.vert
+	vec3 normal = mat3(FetchVec3(i0, OFFSET_NORMAL), FetchVec3(i1, OFFSET_NORMAL), FetchVec3(i2, OFFSET_NORMAL)) * b.lambda;
+	vec3 tangent = mat3(FetchVec3(i0, OFFSET_TANGENT), FetchVec3(i1, OFFSET_TANGENT), FetchVec3(i2, OFFSET_TANGENT)) * b.lambda;
+	vec3 Nw = normalize(vec3(model * vec4(normal, 0.0)));
+	vec3 Tw = normalize(vec3(model * vec4(tangent, 0.0)));
+	Tw = normalize(Tw - dot(Tw, Nw) * Nw);
+	vec3 Bw = cross(Nw, Tw);
+
+	vec3 n = textureGrad(material.texture_normal1, uv, uvDx, uvDy).xyz * 2.0 - 1.0;
+	gNormal = EncodeNormal(normalize(mat3(Tw, Bw, Nw) * n));
+
+	vec3 diffuse = material.useDiffuseValue ? material.diffuse : textureGrad(material.texture_diffuse1, uv, uvDx, uvDy).rgb;
+	float roughness = material.useRoughnessValue ? material.roughness : textureGrad(material.texture_roughness1, uv, uvDx, uvDy).r;
+	float metallic = material.useMetallicValue ? material.metallic : textureGrad(material.texture_metallic1, uv, uvDx, uvDy).r;
+	float ao = textureGrad(material.texture_ao1, uv, uvDx, uvDy).r;
+
+	gAlbedoRoughness = vec4(diffuse, roughness);
+	gMetallicAO = vec2(metallic, ao);
+}
\ No newline at end of file
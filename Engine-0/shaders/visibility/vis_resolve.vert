@@ -0,0 +1,9 @@
+#version 450 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aTexCoords;
+
+uniform float materialDepth; // draw id / 65535, tested with GL_EQUAL
+
+void main() {
+	gl_Position = vec4(aPos, materialDepth * 2.0 - 1.0, 1.0);
+}
\ No newline at end of file
@@ -19,6 +19,12 @@
 #include "modules/public/terrain_brute.h"
 #include "modules/public/terrain_geomip.h"
 #include "modules/public/terrain_tess.h"
+#include "modules/public/light_culling_cpu.h"
+#include "modules/public/benchmark.h"
+
+#include <chrono>
+#include <iterator>
+#include <thread>
 
 constexpr int W_WIDTH = 1600;
 constexpr int W_HEIGHT = 1200;
@@ -40,15 +46,44 @@ void processInput(GLFWwindow* window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 unsigned int getBufferOut(Renderer& renderer, int type);
+// headless checks of the cpu light culler, selected on the command line
+int RunLightCullingValidation(int lightCount);
+int RunLightCullingBenchmark(int lightCount, int width, int height);
 
 static bool gViewportCaptured = false;
 
-int main()
+int main(int argc, char** argv)
 {
+	// --bench-light-culling [lights] [width] [height] runs on the cpu only
+	// --validate-light-culling [lights] compares the cpu and gpu tile lists in a hidden window
+	// --benchmark [options] renders generated lights in a hidden window and writes a report, see benchmark.h
+	bool validateLightCulling = false;
+	int argLights = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--bench-light-culling")
+		{
+			int lights = i + 1 < argc ? std::atoi(argv[i + 1]) : 10000;
+			int width = i + 2 < argc ? std::atoi(argv[i + 2]) : W_WIDTH;
+			int height = i + 3 < argc ? std::atoi(argv[i + 3]) : W_HEIGHT;
+			return RunLightCullingBenchmark(lights, width, height);
+		}
+		if (arg == "--validate-light-culling")
+		{
+			validateLightCulling = true;
+			argLights = i + 1 < argc ? std::atoi(argv[i + 1]) : 4096;
+		}
+	}
+
+	BenchmarkConfig benchmarkConfig;
+	bool benchmarking = LightBenchmark::ParseArgs(argc, argv, benchmarkConfig);
+
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	if (validateLightCulling || benchmarking) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
 	GLFWwindow* window = glfwCreateWindow(W_WIDTH, W_HEIGHT, "Engine 0", NULL, NULL);
 	if (window == NULL)
@@ -71,7 +106,7 @@ int main()
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	glfwSetCursorPosCallback(window, mouse_callback);
 	glfwSetScrollCallback(window, scroll_callback);
-	glfwSwapInterval(1); // Enable vsync
+	glfwSwapInterval(benchmarking ? 0 : 1); // Enable vsync, off while benchmarking
 
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
 		throw std::runtime_error("GLAD init failed");
@@ -82,6 +117,13 @@ int main()
 	std::cout << "OpenGL " << maj << "." << min << " context\n";
 	bool HasCompute = maj > 4 || (maj == 4 && min >= 3);
 
+	if (validateLightCulling)
+	{
+		int result = HasCompute ? RunLightCullingValidation(argLights) : 1;
+		glfwTerminate();
+		return result;
+	}
+
 	Camera camera(
 		glm::vec3(2.10f, 9.43f, 39.18f),
 		glm::vec3(0.25f, -0.07f, -0.97f),
@@ -196,7 +238,8 @@ int main()
 	//	}
 	//}
 
-	for (int i = 0; i < 50; i++)
+	// the benchmark brings its own lights
+	for (int i = 0; i < 50 && !benchmarking; i++)
 	{
 		for (int j = 0; j < 50; j++)
 		{
@@ -208,12 +251,29 @@ int main()
 	// Entity lightEntity = WorldObjectFactory::CreatePointLight(entityManager, lightManager, transformManager, idManager, "light0", glm::vec3(0, 0.0f, 0), glm::vec3(1.0f), 50.0f);
 	// sceneRegistry.Register(lightEntity);
 
+	// shadowed key light over the grid
+	if (!benchmarking)
+	{
+		Entity keyLight = WorldObjectFactory::CreatePointLight(entityManager, lightManager, transformManager, idManager, "key light",
+			glm::vec3(0.0f, 8.0f, 2.0f), glm::vec3(1.0f, 0.9f, 0.8f), 200.0f, 40.0f, true, true);
+		sceneRegistry.Register(keyLight);
+	}
+
 
 	// Systems
 	LightSystem lightSystem(W_WIDTH, W_HEIGHT);
 	RenderSystem renderSystem(renderer);
 	ProbeSystem probeSystem;
 
+	LightBenchmark benchmark(benchmarkConfig);
+	if (benchmarking)
+	{
+		LandscapeComponent* landscape = landscapeManager.GetLandscapeComponent(landscapeEntity);
+		benchmark.GenerateLights(entityManager, lightManager, transformManager, idManager, sceneRegistry,
+			landscape ? landscape->terrain.get() : nullptr, transformManager.GetComponent(landscapeEntity));
+		benchmark.ApplySettings(renderSystem.settings);
+	}
+
 	// Setup imgui context
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
@@ -221,7 +281,7 @@ int main()
 	io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
 	io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
 	io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;         // Enable Docking
-	io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;       // Enable Multi-Viewport / Platform Windows
+	if (!benchmarking) io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable; // Enable Multi-Viewport / Platform Windows
 	//io.ConfigViewportsNoAutoMerge = true;
 	//io.ConfigViewportsNoTaskBarIcon = true;
 
@@ -238,6 +298,7 @@ int main()
 	ViewportWindow viewportWindow;
 	OutlinerWindow outlinerWindow(&sceneRegistry, &idManager);
 	PropertiesWindow propertiesWindow(&transformManager, &shaderManager, &assetManager, &materialsGroupManager, &probeManager);
+	RenderSettingsWindow renderSettingsWindow(&renderSystem.settings, &renderSystem.stats);
 
 	float my_color[4] = { 1.0, 1.0, 1.0, 1.0 };
 	static bool viewport_active;
@@ -266,6 +327,7 @@ int main()
 		//std::cout << "up z: " << camera.getCameraUp().z << std::endl;
 
 		processInput(window);
+		if (benchmarking) benchmark.BeginFrame(camera, transformManager);
 		
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
@@ -347,61 +409,118 @@ int main()
 
 			propertiesWindow.EndRender();
 		}
+		if (renderSettingsWindow.BeginRender())
+		{
+			renderSettingsWindow.EndRender();
+		}
+
+		// forward+ only covers the lit views, the buffer views still need the g-buffer
+		bool forwardShading = renderSystem.settings.shadingPath == ShadingPath::ForwardPlus && tex_type > 5;
+
+		// render scale and projection jitter, the buffer views are not temporally resolved
+		renderSystem.BeginFrame(camera, tex_type > 5);
+		lightSystem.SetScreenSize(renderer.getRenderWidth(), renderer.getRenderHeight());
+		// light table, only the changed lights are uploaded
+		lightSystem.SetStressLights(renderSystem.settings.stressLights);
+		lightSystem.SyncLights(sceneRegistry, lightManager, transformManager);
+		// probe grid, only the changed probes are moved
+		probeSystem.SyncProbes(sceneRegistry, probeManager);
 
 		// GBuffer pass
-		renderSystem.RenderGeometry(
-			sceneRegistry, 
-			transformManager, 
-			shaderManager, 
-			assetManager, 
-			landscapeManager,
-			materialsGroupManager, 
-			camera);
+		if (!forwardShading)
+		{
+			renderSystem.RenderGeometry(
+				sceneRegistry, 
+				transformManager, 
+				shaderManager, 
+				assetManager, 
+				landscapeManager,
+				materialsGroupManager, 
+				camera,
+				frameVAO);
+		}
 
 		// Shadow pass
 		renderSystem.RenderShadowPass(lightManager, transformManager, sceneRegistry, assetManager, landscapeManager, camera);
+		renderSystem.RenderPointShadowPass(lightManager, transformManager, sceneRegistry, camera);
+		lightSystem.SetShadowedLights(renderSystem.GetShadowedPointLights());
 		// SSAO pass
-		renderSystem.RenderSSAO(camera, frameVAO);
+		if (!forwardShading) renderSystem.RenderSSAO(camera, frameVAO);
 		// deferred shading stage
 		glDisable(GL_DEPTH_TEST);
 
 		if (tex_type > 5)
 		{
-			renderer.BlitGToLBuffers(W_WIDTH, W_HEIGHT);
-
-			// PBR shading
-			renderer.getHDRBuffer().bind();
 			EnvironmentProbeComponent* skyProbe = probeManager.GetSkyProbe();
 			probeSystem.RebuildProbes(sceneRegistry, probeManager);
 
-			std::vector<Entity> activeProbes = probeSystem.GetActiveProbes(sceneRegistry, probeManager, camera);
-			std::vector<EnvironmentProbeComponent*> IBLProbes;
-
-			for (auto& p : activeProbes) IBLProbes.push_back(probeManager.GetProbeComponent(p));
-
-			lightSystem.TileLighting(sceneRegistry, lightManager, transformManager, camera);
-			lightSystem.ConfigurePBRUniforms(renderer.getPBRShader(), sceneRegistry, lightManager, transformManager);
-			renderSystem.RenderPBR(skyProbe, IBLProbes, camera, frameVAO);
-			renderer.getHDRBuffer().unbind();
+			// the probe bounds are culled into the tile lists with the lights
+			probeSystem.UpdateProbes(probeManager, camera);
+			lightSystem.SetProbes(probeSystem.GetProbeBounds());
+
+			// the forward+ depth is only written by its own prepass, its lights are culled without depth bounds
+			renderSystem.stats.lightCulling.Begin();
+			lightSystem.CullLights(camera, renderSystem.settings.lightCulling, forwardShading ? 0 : renderer.getGDepth().id);
+			renderSystem.stats.lightCulling.End();
+			renderSystem.stats.lightCount = lightSystem.getLightCount();
+			renderSystem.stats.visibleLights = lightSystem.getVisibleLightCount();
+			renderSystem.stats.lightsUploaded = lightSystem.getUploadedLightCount();
+			renderSystem.stats.lightIndices = lightSystem.getIndexTotal();
+			renderSystem.stats.lightBufferBytes = lightSystem.getBufferBytes();
+
+			if (forwardShading)
+			{
+				// Forward+ shading, resolves into the hdr scene and the g-buffer depth
+				ForwardAttachments fa = renderer.getForwardAttachments();
+				lightSystem.ConfigurePBRUniforms(fa.pbrShader, sceneRegistry, lightManager, transformManager);
+				lightSystem.ConfigurePBRUniforms(fa.terrainShader, sceneRegistry, lightManager, transformManager);
+				lightSystem.ConfigurePBRUniforms(fa.defaultShader, sceneRegistry, lightManager, transformManager);
+				renderSystem.RenderForward(
+					sceneRegistry,
+					transformManager,
+					shaderManager,
+					assetManager,
+					landscapeManager,
+					materialsGroupManager,
+					probeSystem.GetTextures(), camera);
+				glDisable(GL_DEPTH_TEST);
+				renderer.BlitGToLBuffers(renderer.getRenderWidth(), renderer.getRenderHeight());
+			}
+			else
+			{
+				renderer.BlitGToLBuffers(renderer.getRenderWidth(), renderer.getRenderHeight());
+
+				// PBR shading
+				renderer.getHDRBuffer().bind();
+				if (renderSystem.settings.lightingPath == LightingPath::ClassifiedTiles)
+				{
+					lightSystem.ConfigureTileUniforms(renderer.getTileClassifyShader());
+					lightSystem.ConfigurePBRUniforms(renderer.getLightingTileShader(LIGHTING_TILE_NO_POINT_LIGHTS), sceneRegistry, lightManager, transformManager);
+					lightSystem.ConfigurePBRUniforms(renderer.getLightingTileShader(LIGHTING_TILE_FULL), sceneRegistry, lightManager, transformManager);
+				}
+				else lightSystem.ConfigurePBRUniforms(renderer.getPBRShader(), sceneRegistry, lightManager, transformManager);
+				renderSystem.RenderPBR(probeSystem.GetTextures(), camera, frameVAO);
+				renderer.getHDRBuffer().unbind();
+			}
 
-			// Brightness pass
-			renderSystem.RenderDeferredBrightness(frameVAO);
-			// Blur shading
-			renderSystem.RenderBlur(frameVAO);
-			// Bloom shading
+			// Temporal anti aliasing, upsamples to the screen
+			renderSystem.RenderTemporalResolve(camera, frameVAO);
+			// Auto exposure, stays on the gpu
+			renderSystem.RenderAutoExposure(deltaTime);
+			// Bloom (bright pass and blur, or the mip chain)
 			renderSystem.RenderBloom(frameVAO);
-			// Tone mapping
-			renderSystem.RenderTonemap(frameVAO);
-			// Composite output
-			renderSystem.RenderComposite(skyProbe, camera, frameVAO);
-			// Post processing
-			renderSystem.RenderPostProcess(frameVAO);
+			// Tone mapping, composite and post processing
+			renderSystem.RenderPostChain(skyProbe, camera, tex_type == 7, frameVAO);
 		}
 		else if (tex_type <= 5)
 		{
-			renderSystem.RenderBufferPass(frameVAO);
+			renderSystem.RenderBufferPass(camera, frameVAO);
 		}
 		glEnable(GL_DEPTH_TEST);
+		transformManager.ClearChanged();
+		lightManager.ClearChanged();
+		probeManager.ClearChanged();
+		sceneRegistry.ClearChanged();
 		
 		ImGui::Render();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -415,6 +534,8 @@ int main()
 		}
 		glfwPollEvents();
 		glfwSwapBuffers(window);
+
+		if (benchmarking && benchmark.EndFrame(renderSystem.stats, lightSystem)) glfwSetWindowShouldClose(window, true);
 	}
 
 	ImGui_ImplOpenGL3_Shutdown();
@@ -424,7 +545,8 @@ int main()
 	glfwDestroyWindow(window);
 	glfwTerminate();
 
-	return 0;
+	// a benchmark cut short did not write its report
+	return benchmarking && !benchmark.Finished() ? 1 : 0;
 }
 
 void processInput(GLFWwindow* window)
@@ -552,6 +674,8 @@ unsigned int getBufferOut(Renderer& renderer, int type)
 		return da.AO;
 	case 6:
 		// return renderer.getShadowMoments().id;
+		// the fused post pass writes the lit view straight into the post process target
+		if (!renderer.hasPostIntermediates()) return renderer.getPPSceneTex().id;
 		return renderer.getCompositeSceneTex().id;
 		//return renderer.getHDRSceneTex().id;
 	default:
@@ -559,3 +683,167 @@ unsigned int getBufferOut(Renderer& renderer, int type)
 		return renderer.getPPSceneTex().id;
 	}
 }
+
+// synthetic depth for the light culling checks: a ground plane up to the horizon (the lower 3/4 of the screen),
+// raised blocks on it that halve the distance, sky above. window depth in texel order, for near 0.1 and far 2500
+static std::vector<float> makeTestDepth(int width, int height)
+{
+	const float nearPlane = 0.1f, farPlane = 2500.0f;
+	std::vector<float> depth((size_t)width * height, 1.0f);
+	float horizon = height * 0.75f;
+	for (int y = 0; y < (int)horizon; y++)
+	{
+		float t = (horizon - y) / horizon;
+		for (int x = 0; x < width; x++)
+		{
+			float z = glm::min(5.0f / t, farPlane * 0.9f);
+			if (((x / 97) + (y / 61)) % 3 == 0) z *= 0.5f;
+			depth[(size_t)y * width + x] = (1.0f / z - 1.0f / nearPlane) / (1.0f / farPlane - 1.0f / nearPlane);
+		}
+	}
+	return depth;
+}
+
+static Camera makeTestCamera()
+{
+	return Camera(glm::vec3(0.0f, 10.0f, 60.0f), glm::normalize(glm::vec3(0.0f, -0.1f, -1.0f)), glm::vec3(0.0f, 1.0f, 0.0f), 45.0f);
+}
+
+// compares the tiled lists of the compute shader with the cpu ones, with and without depth bounds. the order inside
+// a list is ignored, full tiles only compare their counts, and lights that only one side accepts have to be within
+// rounding distance of a tile plane. returns 0 when everything matches
+int RunLightCullingValidation(int lightCount)
+{
+	Camera camera = makeTestCamera();
+	std::vector<float> depth = makeTestDepth(W_WIDTH, W_HEIGHT);
+
+	unsigned int depthTexture;
+	glGenTextures(1, &depthTexture);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, W_WIDTH, W_HEIGHT, 0, GL_RED, GL_FLOAT, depth.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	SceneEntityRegistry sceneRegistry;
+	LightManager lightManager;
+	TransformManager transformManager;
+	LightSystem lightSystem(W_WIDTH, W_HEIGHT);
+	lightSystem.SetStressLights(lightCount);
+	lightSystem.SyncLights(sceneRegistry, lightManager, transformManager);
+
+	CpuLightCuller culler;
+	int failures = 0;
+	for (bool depthBounds : { true, false })
+	{
+		TileLightLists gpuLists, cpuLists;
+		lightSystem.CullLights(camera, LightCulling::Tiled, depthBounds ? depthTexture : 0);
+		lightSystem.ReadTileLists(gpuLists);
+		lightSystem.BuildCpuTileLists(camera, depthBounds ? depth.data() : nullptr, cpuLists);
+		TileCullingInput input = lightSystem.GetTileCullingInput(camera, depthBounds ? depth.data() : nullptr);
+
+		int matching = 0, full = 0, rounding = 0, mismatches = 0;
+		for (int tile = 0; tile < gpuLists.tilesX * gpuLists.tilesY; tile++)
+		{
+			glm::uvec2 gpuInfo = gpuLists.tileInfo[tile];
+			glm::uvec2 cpuInfo = cpuLists.tileInfo[tile];
+			if (gpuInfo.y == MAX_LIGHTS_PER_TILE && cpuInfo.y == MAX_LIGHTS_PER_TILE)
+			{
+				full++;
+				continue;
+			}
+
+			std::vector<uint32_t> gpu(gpuLists.lightIndices.begin() + gpuInfo.x, gpuLists.lightIndices.begin() + gpuInfo.x + gpuInfo.y);
+			std::vector<uint32_t> cpu(cpuLists.lightIndices.begin() + cpuInfo.x, cpuLists.lightIndices.begin() + cpuInfo.x + cpuInfo.y);
+			std::sort(gpu.begin(), gpu.end());
+			std::sort(cpu.begin(), cpu.end());
+			if (gpu == cpu)
+			{
+				matching++;
+				continue;
+			}
+
+			std::vector<uint32_t> difference;
+			std::set_symmetric_difference(gpu.begin(), gpu.end(), cpu.begin(), cpu.end(), std::back_inserter(difference));
+			bool tileFailed = false;
+			for (uint32_t id : difference)
+			{
+				const GPULight& light = lightSystem.getTable().Data()[id];
+				float margin = culler.TileMargin(input, light, tile % gpuLists.tilesX, tile / gpuLists.tilesX);
+				if (glm::abs(margin) <= 1e-3f * glm::max(1.0f, light.pos_radius.w)) rounding++;
+				else tileFailed = true;
+			}
+			if (tileFailed)
+			{
+				if (mismatches < 8)
+					std::cout << "  tile " << tile << ": gpu " << gpuInfo.y << " lights, cpu " << cpuInfo.y << " lights" << std::endl;
+				mismatches++;
+			}
+		}
+
+		std::cout << "light culling " << (depthBounds ? "with" : "without") << " depth bounds: "
+			<< matching << " tiles match, " << full << " full, " << rounding << " lights differ by rounding, "
+			<< mismatches << " tiles mismatch" << std::endl;
+		failures += mismatches;
+	}
+
+	glDeleteTextures(1, &depthTexture);
+	std::cout << (failures ? "ERROR::LIGHT_CULLING::VALIDATION_FAILED" : "light culling validation passed") << std::endl;
+	return failures ? 1 : 0;
+}
+
+// lights x tiles tested per second on each cpu path, single threaded and on every hardware thread
+int RunLightCullingBenchmark(int lightCount, int width, int height)
+{
+	Camera camera = makeTestCamera();
+	std::vector<float> depth = makeTestDepth(width, height);
+
+	// same distribution as the stress lights
+	std::mt19937 gen(1337);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<GPULight> lights(lightCount);
+	std::vector<uint32_t> ids(lightCount);
+	for (int i = 0; i < lightCount; i++)
+	{
+		lights[i].pos_radius = glm::vec4(-250.0f + unit(gen) * 500.0f, 1.0f + unit(gen) * 20.0f, -250.0f + unit(gen) * 500.0f, 4.0f + unit(gen) * 8.0f);
+		lights[i].color_intensity = glm::vec4(1.0f);
+		ids[i] = i;
+	}
+
+	TileCullingInput input;
+	input.view = camera.getViewMatrix();
+	input.projection = camera.getProjectionMatrix((float)width, (float)height, 0.1f, 2500.0f);
+	input.screenWidth = width;
+	input.screenHeight = height;
+	input.depth = depth.data();
+
+	CpuLightCuller culler;
+	TileLightLists lists;
+	int hardwareThreads = (int)glm::max(1u, std::thread::hardware_concurrency());
+	std::cout << lightCount << " lights, " << width << "x" << height << ", " << hardwareThreads << " threads" << std::endl;
+
+	std::vector<CpuLightCuller::Path> paths = { CpuLightCuller::Path::Scalar, CpuLightCuller::Path::SSE };
+	if (CpuLightCuller::HasAVX2()) paths.push_back(CpuLightCuller::Path::AVX2);
+	for (CpuLightCuller::Path path : paths)
+	{
+		for (int threads : { 1, hardwareThreads })
+		{
+			// best of a few runs after a warm up
+			culler.CullTiles(input, lights.data(), ids.data(), ids.size(), lists, threads, path);
+			double best = 1e30;
+			for (int run = 0; run < 5; run++)
+			{
+				auto start = std::chrono::high_resolution_clock::now();
+				culler.CullTiles(input, lights.data(), ids.data(), ids.size(), lists, threads, path);
+				auto end = std::chrono::high_resolution_clock::now();
+				best = std::min(best, std::chrono::duration<double>(end - start).count());
+			}
+
+			double tests = (double)lightCount * lists.tilesX * lists.tilesY;
+			size_t entries = lists.tileInfo.empty() ? 0 : lists.tileInfo.back().x + lists.tileInfo.back().y;
+			std::cout << "  " << CpuLightCuller::PathName(path) << ", " << threads << " thread(s): "
+				<< best * 1000.0 << " ms, " << tests / best / 1.0e6 << " M lights x tiles/s, "
+				<< entries << " list entries" << std::endl;
+		}
+	}
+	return 0;
+}
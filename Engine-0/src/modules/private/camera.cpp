@@ -27,10 +27,22 @@ void Camera::setFOV(const float fov)
     this->fov = fov;
 }
 
+void Camera::setJitter(const glm::vec2& ndcOffset)
+{
+    jitter = ndcOffset;
+}
+
 // Getter implementations
-glm::mat4 Camera::getProjectionMatrix(float width, float height, float near, float far)
+glm::mat4 Camera::getProjectionMatrix(float width, float height, float near, float far, bool jittered)
 {
-    return glm::perspective(glm::radians(fov), width / height, near, far);
+    glm::mat4 projection = glm::perspective(glm::radians(fov), width / height, near, far);
+    if (jittered)
+    {
+        // shifts the whole image by the jitter after the perspective divide
+        projection[2][0] -= jitter.x;
+        projection[2][1] -= jitter.y;
+    }
+    return projection;
 }
 
 glm::mat4 Camera::getViewMatrix()
@@ -59,3 +71,8 @@ float Camera::getFOV() const
 {
     return fov;
 }
+
+glm::vec2 Camera::getJitter() const
+{
+    return jitter;
+}
@@ -0,0 +1,333 @@
+#include "../public/light_culling_cpu.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx,avx2")))
+#endif
+#include <immintrin.h>
+
+namespace
+{
+	// same as UnprojectCorner in lighting_tiled.comp
+	glm::vec3 UnprojectCorner(const glm::mat4& invProjection, glm::vec2 pixel, glm::vec2 screenSize)
+	{
+		glm::vec2 ndc = pixel / screenSize * 2.0f - 1.0f;
+		glm::vec4 p = invProjection * glm::vec4(ndc, 1.0f, 1.0f);
+		return glm::vec3(p) / p.w;
+	}
+
+	float ViewDistance(const glm::mat4& invProjection, float depth)
+	{
+		glm::vec4 p = invProjection * glm::vec4(0.0f, 0.0f, depth * 2.0f - 1.0f, 1.0f);
+		return -p.z / p.w;
+	}
+
+	// appends the ids of the set mask bits until the list is full, returns the new count
+	inline uint32_t AppendMask(int mask, const uint32_t* ids, uint32_t* list, uint32_t count, uint32_t maxCount)
+	{
+		for (int bit = 0; mask && count < maxCount; bit++, mask >>= 1)
+		{
+			if (mask & 1) list[count++] = ids[bit];
+		}
+		return count;
+	}
+}
+
+CpuLightCuller::TileFrustum CpuLightCuller::BuildTile(const TileCullingInput& input, const glm::mat4& invProjection, int tileX, int tileY) const
+{
+	TileFrustum tile;
+	glm::vec2 screenSize((float)input.screenWidth, (float)input.screenHeight);
+	glm::ivec2 pixelMin(tileX * input.tileSize, tileY * input.tileSize);
+	glm::ivec2 pixelMax = glm::min(pixelMin + input.tileSize, glm::ivec2(input.screenWidth, input.screenHeight));
+
+	glm::vec2 tileMin(pixelMin);
+	glm::vec2 tileMax(pixelMax);
+	glm::vec3 c0 = UnprojectCorner(invProjection, tileMin, screenSize);
+	glm::vec3 c1 = UnprojectCorner(invProjection, glm::vec2(tileMax.x, tileMin.y), screenSize);
+	glm::vec3 c2 = UnprojectCorner(invProjection, tileMax, screenSize);
+	glm::vec3 c3 = UnprojectCorner(invProjection, glm::vec2(tileMin.x, tileMax.y), screenSize);
+	glm::vec3 center = UnprojectCorner(invProjection, 0.5f * (tileMin + tileMax), screenSize);
+
+	glm::vec3 normals[4] = { glm::cross(c0, c1), glm::cross(c1, c2), glm::cross(c2, c3), glm::cross(c3, c0) };
+	for (int i = 0; i < 4; i++)
+	{
+		glm::vec3 n = glm::normalize(normals[i]);
+		tile.normals[i] = glm::dot(n, center) < 0.0f ? -n : n;
+	}
+
+	if (!input.depth)
+	{
+		tile.depthRange = glm::vec2(ViewDistance(invProjection, 0.0f), ViewDistance(invProjection, 1.0f));
+		return tile;
+	}
+
+	// depth range of the covered pixels, sky only tiles get an empty range
+	float minDepth = 1.0f, maxDepth = 0.0f;
+	for (int y = pixelMin.y; y < pixelMax.y; y++)
+	{
+		const float* row = input.depth + (size_t)y * input.screenWidth;
+		for (int x = pixelMin.x; x < pixelMax.x; x++)
+		{
+			float depth = row[x];
+			if (depth >= 1.0f) continue;
+			minDepth = std::min(minDepth, depth);
+			maxDepth = std::max(maxDepth, depth);
+		}
+	}
+	tile.depthRange = maxDepth < minDepth
+		? glm::vec2(1.0f, 0.0f)
+		: glm::vec2(ViewDistance(invProjection, minDepth), ViewDistance(invProjection, maxDepth));
+	return tile;
+}
+
+namespace
+{
+	uint32_t CullScalar(const glm::vec3* normals, glm::vec2 depthRange, const float* x, const float* y, const float* z,
+		const float* r, const uint32_t* ids, size_t count, uint32_t* list, uint32_t maxCount)
+	{
+		uint32_t listCount = 0;
+		for (size_t i = 0; i < count && listCount < maxCount; i++)
+		{
+			float distance = -z[i];
+			if (distance + r[i] < depthRange.x || distance - r[i] > depthRange.y) continue;
+
+			bool inside = true;
+			for (int p = 0; p < 4; p++)
+			{
+				if (normals[p].x * x[i] + normals[p].y * y[i] + normals[p].z * z[i] < -r[i])
+				{
+					inside = false;
+					break;
+				}
+			}
+			if (inside) list[listCount++] = ids[i];
+		}
+		return listCount;
+	}
+
+	uint32_t CullSSE(const glm::vec3* normals, glm::vec2 depthRange, const float* x, const float* y, const float* z,
+		const float* r, const uint32_t* ids, size_t count, uint32_t* list, uint32_t maxCount)
+	{
+		__m128 nx[4], ny[4], nz[4];
+		for (int p = 0; p < 4; p++)
+		{
+			nx[p] = _mm_set1_ps(normals[p].x);
+			ny[p] = _mm_set1_ps(normals[p].y);
+			nz[p] = _mm_set1_ps(normals[p].z);
+		}
+		__m128 rangeMin = _mm_set1_ps(depthRange.x);
+		__m128 rangeMax = _mm_set1_ps(depthRange.y);
+
+		uint32_t listCount = 0;
+		for (size_t i = 0; i < count && listCount < maxCount; i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(x + i);
+			__m128 cy = _mm_loadu_ps(y + i);
+			__m128 cz = _mm_loadu_ps(z + i);
+			__m128 cr = _mm_loadu_ps(r + i);
+			__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), cr);
+			__m128 distance = _mm_sub_ps(_mm_setzero_ps(), cz);
+
+			__m128 inside = _mm_and_ps(
+				_mm_cmpge_ps(_mm_add_ps(distance, cr), rangeMin),
+				_mm_cmple_ps(_mm_sub_ps(distance, cr), rangeMax));
+			for (int p = 0; p < 4; p++)
+			{
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)), _mm_mul_ps(nz[p], cz));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negRadius));
+			}
+			listCount = AppendMask(_mm_movemask_ps(inside), ids + i, list, listCount, maxCount);
+		}
+		return listCount;
+	}
+
+	AVX2_TARGET uint32_t CullAVX2(const glm::vec3* normals, glm::vec2 depthRange, const float* x, const float* y, const float* z,
+		const float* r, const uint32_t* ids, size_t count, uint32_t* list, uint32_t maxCount)
+	{
+		__m256 nx[4], ny[4], nz[4];
+		for (int p = 0; p < 4; p++)
+		{
+			nx[p] = _mm256_set1_ps(normals[p].x);
+			ny[p] = _mm256_set1_ps(normals[p].y);
+			nz[p] = _mm256_set1_ps(normals[p].z);
+		}
+		__m256 rangeMin = _mm256_set1_ps(depthRange.x);
+		__m256 rangeMax = _mm256_set1_ps(depthRange.y);
+
+		uint32_t listCount = 0;
+		for (size_t i = 0; i < count && listCount < maxCount; i += 8)
+		{
+			__m256 cx = _mm256_loadu_ps(x + i);
+			__m256 cy = _mm256_loadu_ps(y + i);
+			__m256 cz = _mm256_loadu_ps(z + i);
+			__m256 cr = _mm256_loadu_ps(r + i);
+			__m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), cr);
+			__m256 distance = _mm256_sub_ps(_mm256_setzero_ps(), cz);
+
+			// no fma, the shader's results are matched more closely with separate multiplies and adds
+			__m256 inside = _mm256_and_ps(
+				_mm256_cmp_ps(_mm256_add_ps(distance, cr), rangeMin, _CMP_GE_OQ),
+				_mm256_cmp_ps(_mm256_sub_ps(distance, cr), rangeMax, _CMP_LE_OQ));
+			for (int p = 0; p < 4; p++)
+			{
+				__m256 d = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(nx[p], cx), _mm256_mul_ps(ny[p], cy)),
+					_mm256_mul_ps(nz[p], cz));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negRadius, _CMP_GE_OQ));
+			}
+
+			int mask = _mm256_movemask_ps(inside);
+			if (mask) listCount = AppendMask(mask, ids + i, list, listCount, maxCount);
+		}
+		return listCount;
+	}
+}
+
+void CpuLightCuller::CullTileRange(const TileCullingInput& input, const glm::mat4& invProjection, int tilesX, int firstTile, int lastTile, int stride, Path path)
+{
+	uint32_t maxCount = (uint32_t)input.maxLightsPerTile;
+	size_t lightCount = ids.size();
+
+	for (int tileID = firstTile; tileID < lastTile; tileID += stride)
+	{
+		TileFrustum tile = BuildTile(input, invProjection, tileID % tilesX, tileID / tilesX);
+		uint32_t* list = scratch.data() + (size_t)tileID * maxCount;
+		if (tile.depthRange.x > tile.depthRange.y)
+		{
+			counts[tileID] = 0;
+			continue;
+		}
+
+		if (path == Path::AVX2)
+			counts[tileID] = CullAVX2(tile.normals, tile.depthRange, viewX.data(), viewY.data(), viewZ.data(), radius.data(), ids.data(), lightCount, list, maxCount);
+		else if (path == Path::SSE)
+			counts[tileID] = CullSSE(tile.normals, tile.depthRange, viewX.data(), viewY.data(), viewZ.data(), radius.data(), ids.data(), lightCount, list, maxCount);
+		else
+			counts[tileID] = CullScalar(tile.normals, tile.depthRange, viewX.data(), viewY.data(), viewZ.data(), radius.data(), ids.data(), lightCount, list, maxCount);
+	}
+}
+
+void CpuLightCuller::CullTiles(
+	const TileCullingInput& input,
+	const GPULight* lights,
+	const uint32_t* lightIDs,
+	size_t count,
+	TileLightLists& out,
+	int threads,
+	Path path)
+{
+	if (path == Path::Auto) path = HasAVX2() ? Path::AVX2 : Path::SSE;
+	if (path == Path::AVX2 && !HasAVX2()) path = Path::SSE;
+
+	out.tilesX = (input.screenWidth + input.tileSize - 1) / input.tileSize;
+	out.tilesY = (input.screenHeight + input.tileSize - 1) / input.tileSize;
+	int tileCount = out.tilesX * out.tilesY;
+
+	// view space spheres, computed like the shader does (view * vec4(position, 1))
+	size_t padded = (count + 7) & ~(size_t)7;
+	viewX.assign(padded, 0.0f);
+	viewY.assign(padded, 0.0f);
+	viewZ.assign(padded, 0.0f);
+	radius.assign(padded, -FLT_MAX);
+	ids.assign(padded, 0u);
+	for (size_t i = 0; i < count; i++)
+	{
+		const glm::vec4& posRadius = lights[lightIDs[i]].pos_radius;
+		glm::vec4 vp = input.view * glm::vec4(glm::vec3(posRadius), 1.0f);
+		viewX[i] = vp.x;
+		viewY[i] = vp.y;
+		viewZ[i] = vp.z;
+		radius[i] = posRadius.w;
+		ids[i] = lightIDs[i];
+	}
+	ids.resize(count);
+
+	scratch.resize((size_t)tileCount * input.maxLightsPerTile);
+	counts.assign(tileCount, 0u);
+	glm::mat4 invProjection = glm::inverse(input.projection);
+
+	// tiles are interleaved over the workers, the expensive tiles (many lights, deep ranges) are usually clustered
+	if (threads <= 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min(threads, tileCount);
+	if (threads <= 1)
+	{
+		CullTileRange(input, invProjection, out.tilesX, 0, tileCount, 1, path);
+	}
+	else
+	{
+		std::vector<std::thread> workers;
+		workers.reserve(threads - 1);
+		for (int t = 1; t < threads; t++)
+			workers.emplace_back(&CpuLightCuller::CullTileRange, this, std::cref(input), std::cref(invProjection), out.tilesX, t, tileCount, threads, path);
+		CullTileRange(input, invProjection, out.tilesX, 0, tileCount, threads, path);
+		for (std::thread& worker : workers) worker.join();
+	}
+
+	// compaction
+	out.tileInfo.resize(tileCount);
+	size_t total = 0;
+	for (int i = 0; i < tileCount; i++)
+	{
+		out.tileInfo[i] = glm::uvec2((uint32_t)total, counts[i]);
+		total += counts[i];
+	}
+	out.lightIndices.resize(std::max(total, (size_t)1));
+	for (int i = 0; i < tileCount; i++)
+	{
+		if (!counts[i]) continue;
+		std::memcpy(out.lightIndices.data() + out.tileInfo[i].x, scratch.data() + (size_t)i * input.maxLightsPerTile, sizeof(uint32_t) * counts[i]);
+	}
+}
+
+float CpuLightCuller::TileMargin(const TileCullingInput& input, const GPULight& light, int tileX, int tileY) const
+{
+	TileFrustum tile = BuildTile(input, glm::inverse(input.projection), tileX, tileY);
+	glm::vec3 vp = glm::vec3(input.view * glm::vec4(glm::vec3(light.pos_radius), 1.0f));
+	float r = light.pos_radius.w;
+
+	float distance = -vp.z;
+	float margin = std::min(distance + r - tile.depthRange.x, tile.depthRange.y - (distance - r));
+	for (int p = 0; p < 4; p++) margin = std::min(margin, glm::dot(tile.normals[p], vp) + r);
+	return margin;
+}
+
+bool CpuLightCuller::HasAVX2()
+{
+	static const bool supported = []()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+
+		// the os has to save the ymm registers too
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}();
+	return supported;
+}
+
+const char* CpuLightCuller::PathName(Path path)
+{
+	switch (path)
+	{
+	case Path::Scalar: return "scalar";
+	case Path::SSE: return "sse";
+	case Path::AVX2: return "avx2";
+	default: return "auto";
+	}
+}
\ No newline at end of file
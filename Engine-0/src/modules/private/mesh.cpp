@@ -1,4 +1,5 @@
 #include "../public/mesh.h"
+#include <algorithm>
 
 Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices)
 {
@@ -8,18 +9,49 @@ Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices)
 	setupMesh();
 }
 
-void Mesh::Draw(Shader& shader)
+void Mesh::Draw(Shader& shader, int lod)
 {
 	// draw mesh
 	shader.use();
 	glBindVertexArray(VAO);
-	if (!indices.empty())
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+	if (!lods.empty())
+	{
+		const MeshLOD& level = lods[std::clamp(lod, 0, (int)lods.size() - 1)];
+		glDrawElements(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT, (void*)(level.firstIndex * sizeof(unsigned int)));
+	}
 	else
 		glDrawArrays(GL_TRIANGLES, 0, vertices.size());
 	glBindVertexArray(0);
 }
 
+void Mesh::SetLODs(const std::vector<std::vector<unsigned int>>& lodIndices, const std::vector<float>& lodErrors)
+{
+	if (indices.empty() || lodIndices.empty()) return;
+
+	lods.resize(1);
+	std::vector<unsigned int> elements = indices;
+	for (size_t i = 0; i < lodIndices.size(); i++)
+	{
+		MeshLOD level;
+		level.firstIndex = (unsigned int)elements.size();
+		level.indexCount = (unsigned int)lodIndices[i].size();
+		level.error = i < lodErrors.size() ? lodErrors[i] : 0.0f;
+		lods.push_back(level);
+		elements.insert(elements.end(), lodIndices[i].begin(), lodIndices[i].end());
+	}
+
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(unsigned int), elements.data(), GL_STATIC_DRAW);
+	glBindVertexArray(0);
+}
+
+unsigned int Mesh::getTriangleCount(int lod) const
+{
+	if (lods.empty()) return (unsigned int)vertices.size() / 3;
+	return lods[std::clamp(lod, 0, (int)lods.size() - 1)].indexCount / 3;
+}
+
 void Mesh::setupMesh()
 {
 	glGenVertexArrays(1, &VAO);
@@ -35,6 +67,10 @@ void Mesh::setupMesh()
 		glGenBuffers(1, &EBO);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+
+		MeshLOD base;
+		base.indexCount = (unsigned int)indices.size();
+		lods.push_back(base);
 	}
 
 	// vertex positions
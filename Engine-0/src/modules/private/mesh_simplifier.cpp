@@ -0,0 +1,296 @@
+#include "../public/mesh_simplifier.h"
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+
+namespace
+{
+	// symmetric 4x4 quadric, upper triangle only
+	struct Quadric
+	{
+		double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+		double a11 = 0, a12 = 0, a13 = 0;
+		double a22 = 0, a23 = 0;
+		double a33 = 0;
+		double weight = 0;
+
+		void AddPlane(double a, double b, double c, double d, double w)
+		{
+			a00 += w * a * a; a01 += w * a * b; a02 += w * a * c; a03 += w * a * d;
+			a11 += w * b * b; a12 += w * b * c; a13 += w * b * d;
+			a22 += w * c * c; a23 += w * c * d;
+			a33 += w * d * d;
+			weight += w;
+		}
+
+		void Add(const Quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+			a11 += q.a11; a12 += q.a12; a13 += q.a13;
+			a22 += q.a22; a23 += q.a23;
+			a33 += q.a33;
+			weight += q.weight;
+		}
+
+		double Evaluate(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double r = a00 * x * x + a11 * y * y + a22 * z * z
+				+ 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2.0 * (a03 * x + a13 * y + a23 * z)
+				+ a33;
+			return r > 0.0 ? r : 0.0;
+		}
+	};
+
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& p) const
+		{
+			unsigned int h[3];
+			std::memcpy(h, &p, sizeof(h));
+			return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+		}
+	};
+
+	struct Collapse
+	{
+		unsigned int from;
+		unsigned int to;
+		double cost;		// geometric + attribute error, used for ordering
+		double geometric;	// quadric error only, used for the reported error
+	};
+
+	glm::vec3 TriangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+	{
+		return glm::cross(b - a, c - a);
+	}
+}
+
+SimplifyResult MeshSimplifier::Simplify(
+	const std::vector<Vertex>& vertices,
+	const std::vector<unsigned int>& indices,
+	size_t targetIndexCount,
+	float attributeWeight)
+{
+	SimplifyResult result;
+	result.indices = indices;
+
+	const size_t vertexCount = vertices.size();
+	if (indices.size() < 3 || indices.size() <= targetIndexCount || vertexCount == 0)
+		return result;
+
+	// weld vertices by position so seams and quadrics are shared between attribute splits
+	std::vector<unsigned int> positionID(vertexCount);
+	std::vector<unsigned int> wedgeCount;
+	{
+		std::unordered_map<glm::vec3, unsigned int, PositionHash> lookup;
+		lookup.reserve(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			auto it = lookup.emplace(vertices[i].Position, (unsigned int)wedgeCount.size());
+			if (it.second) wedgeCount.push_back(0);
+			positionID[i] = it.first->second;
+			wedgeCount[positionID[i]]++;
+		}
+	}
+
+	// bounds radius, used to keep the attribute penalty and the reported error scale independent
+	glm::vec3 minP(FLT_MAX), maxP(-FLT_MAX);
+	for (const Vertex& v : vertices)
+	{
+		minP = glm::min(minP, v.Position);
+		maxP = glm::max(maxP, v.Position);
+	}
+	double radius = std::max(0.5 * (double)glm::length(maxP - minP), 1e-6);
+	double attributeScale = (double)attributeWeight * radius * radius;
+
+	// plane quadrics per welded position, weighted by triangle area
+	std::vector<Quadric> quadrics(wedgeCount.size());
+	for (size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		const glm::vec3& p0 = vertices[indices[t]].Position;
+		const glm::vec3& p1 = vertices[indices[t + 1]].Position;
+		const glm::vec3& p2 = vertices[indices[t + 2]].Position;
+		glm::vec3 n = TriangleNormal(p0, p1, p2);
+		float len = glm::length(n);
+		if (len < 1e-12f) continue;
+		n /= len;
+		double d = -glm::dot(n, p0);
+		double area = 0.5 * len;
+		for (int k = 0; k < 3; k++)
+			quadrics[positionID[indices[t + k]]].AddPlane(n.x, n.y, n.z, d, area);
+	}
+
+	// lock open borders (edges used by a single triangle) and seams (positions with several vertices)
+	std::vector<bool> locked(vertexCount, false);
+	{
+		std::unordered_map<unsigned long long, int> edgeUse;
+		edgeUse.reserve(indices.size());
+		auto edgeKey = [](unsigned int a, unsigned int b)
+			{
+				if (a > b) std::swap(a, b);
+				return ((unsigned long long)a << 32) | b;
+			};
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+			for (int k = 0; k < 3; k++)
+				edgeUse[edgeKey(positionID[indices[t + k]], positionID[indices[t + (k + 1) % 3]])]++;
+
+		std::vector<bool> borderPosition(wedgeCount.size(), false);
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int a = positionID[indices[t + k]];
+				unsigned int b = positionID[indices[t + (k + 1) % 3]];
+				if (edgeUse[edgeKey(a, b)] == 1)
+					borderPosition[a] = borderPosition[b] = true;
+			}
+
+		for (size_t i = 0; i < vertexCount; i++)
+			locked[i] = wedgeCount[positionID[i]] > 1 || borderPosition[positionID[i]];
+	}
+
+	std::vector<unsigned int>& tris = result.indices;
+	std::vector<bool> dead(tris.size() / 3, false);
+	std::vector<std::vector<unsigned int>> adjacency(vertexCount);
+	for (unsigned int t = 0; t < tris.size() / 3; t++)
+		for (int k = 0; k < 3; k++)
+			adjacency[tris[t * 3 + k]].push_back(t);
+
+	size_t liveIndices = tris.size();
+	double maxError = 0.0;
+
+	auto makeCollapse = [&](unsigned int from, unsigned int to)
+		{
+			Quadric q = quadrics[positionID[from]];
+			q.Add(quadrics[positionID[to]]);
+			// area weighted mean squared distance to the merged planes
+			double geometric = q.Evaluate(vertices[to].Position) / std::max(q.weight, 1e-12);
+
+			const Vertex& a = vertices[from];
+			const Vertex& b = vertices[to];
+			glm::vec2 duv = a.TexCoords - b.TexCoords;
+			double normalDelta = std::max(1.0 - (double)glm::dot(a.Normal, b.Normal), 0.0);
+			double cost = geometric + attributeScale * (glm::dot(duv, duv) + normalDelta);
+			return Collapse{ from, to, cost, geometric };
+		};
+
+	// reject collapses that flip or degenerate a surviving triangle
+	auto collapseValid = [&](unsigned int from, unsigned int to)
+		{
+			for (unsigned int t : adjacency[from])
+			{
+				if (dead[t]) continue;
+				unsigned int* tri = &tris[t * 3];
+				if (tri[0] == to || tri[1] == to || tri[2] == to) continue;
+
+				glm::vec3 p[3], q[3];
+				for (int k = 0; k < 3; k++)
+				{
+					p[k] = vertices[tri[k]].Position;
+					q[k] = tri[k] == from ? vertices[to].Position : p[k];
+				}
+				glm::vec3 before = TriangleNormal(p[0], p[1], p[2]);
+				glm::vec3 after = TriangleNormal(q[0], q[1], q[2]);
+				if (glm::dot(before, after) <= 0.0f) return false;
+			}
+			return true;
+		};
+
+	std::vector<Collapse> candidates;
+	std::vector<bool> touched(vertexCount);
+
+	// greedy passes over an independent set of the cheapest edges, cheaper than a heap with
+	// lazy updates and stable enough for offline LOD building
+	while (liveIndices > targetIndexCount)
+	{
+		candidates.clear();
+		for (unsigned int t = 0; t < tris.size() / 3; t++)
+		{
+			if (dead[t]) continue;
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int a = tris[t * 3 + k];
+				unsigned int b = tris[t * 3 + (k + 1) % 3];
+				if (!locked[a]) candidates.push_back(makeCollapse(a, b));
+				if (!locked[b]) candidates.push_back(makeCollapse(b, a));
+			}
+		}
+		if (candidates.empty()) break;
+
+		std::sort(candidates.begin(), candidates.end(),
+			[](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+		std::fill(touched.begin(), touched.end(), false);
+		size_t collapsed = 0;
+
+		for (const Collapse& c : candidates)
+		{
+			if (liveIndices <= targetIndexCount) break;
+			if (touched[c.from] || touched[c.to]) continue;
+			if (!collapseValid(c.from, c.to)) continue;
+
+			for (unsigned int t : adjacency[c.from])
+			{
+				if (dead[t]) continue;
+				unsigned int* tri = &tris[t * 3];
+				if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to)
+				{
+					dead[t] = true;
+					liveIndices -= 3;
+					continue;
+				}
+				for (int k = 0; k < 3; k++) if (tri[k] == c.from) tri[k] = c.to;
+				adjacency[c.to].push_back(t);
+			}
+			adjacency[c.from].clear();
+			quadrics[positionID[c.to]].Add(quadrics[positionID[c.from]]);
+
+			touched[c.from] = touched[c.to] = true;
+			maxError = std::max(maxError, c.geometric);
+			collapsed++;
+		}
+		if (collapsed == 0) break;
+	}
+
+	// compact the surviving triangles
+	std::vector<unsigned int> compact;
+	compact.reserve(liveIndices);
+	for (unsigned int t = 0; t < tris.size() / 3; t++)
+	{
+		if (dead[t]) continue;
+		compact.insert(compact.end(), tris.begin() + t * 3, tris.begin() + t * 3 + 3);
+	}
+	result.indices = std::move(compact);
+	result.error = (float)(std::sqrt(maxError) / radius);
+
+	return result;
+}
+
+std::vector<SimplifyResult> MeshSimplifier::BuildLODChain(
+	const std::vector<Vertex>& vertices,
+	const std::vector<unsigned int>& indices,
+	const MeshLODSettings& settings)
+{
+	std::vector<SimplifyResult> chain;
+	chain.reserve(settings.maxLODs);
+	const std::vector<unsigned int>* source = &indices;
+
+	for (int lod = 1; lod < settings.maxLODs; lod++)
+	{
+		size_t target = (size_t)(source->size() / 3 * settings.reduction) * 3;
+		if (target < 36) break;
+
+		SimplifyResult level = Simplify(vertices, *source, target, settings.attributeWeight);
+		if (level.indices.size() > source->size() * settings.minReduction) break;
+
+		// errors accumulate down the chain
+		if (!chain.empty()) level.error = std::max(level.error, chain.back().error);
+		chain.push_back(std::move(level));
+		source = &chain.back().indices;
+	}
+
+	return chain;
+}
\ No newline at end of file
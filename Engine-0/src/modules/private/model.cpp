@@ -1,4 +1,6 @@
 #include "../public/model.h"
+#include <chrono>
+#include <iomanip>
 
 void Model::loadModel(std::string path)
 {
@@ -23,6 +25,52 @@ void Model::loadModel(std::string path)
 	processNode(scene->mRootNode, scene);
 }
 
+void Model::buildLODs(const std::string& path, const MeshLODSettings& settings)
+{
+	if (meshDataList.empty()) return;
+
+	std::vector<size_t> triangles(settings.maxLODs, 0);
+	std::vector<float> errors(settings.maxLODs, 0.0f);
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (MeshData& part : meshDataList)
+	{
+		Mesh& mesh = part.mesh;
+		if (mesh.indices.empty()) continue;
+
+		std::vector<SimplifyResult> chain = MeshSimplifier::BuildLODChain(mesh.vertices, mesh.indices, settings);
+		std::vector<std::vector<unsigned int>> lodIndices;
+		std::vector<float> lodErrors;
+		for (SimplifyResult& level : chain)
+		{
+			lodIndices.push_back(std::move(level.indices));
+			lodErrors.push_back(level.error);
+		}
+		mesh.SetLODs(lodIndices, lodErrors);
+
+		// parts that stop early report their last level for the remaining ones
+		for (int lod = 0; lod < settings.maxLODs; lod++)
+		{
+			triangles[lod] += mesh.getTriangleCount(lod);
+			int clamped = std::min(lod, mesh.getLODCount() - 1);
+			errors[lod] = std::max(errors[lod], mesh.getLODs()[clamped].error);
+		}
+	}
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::cout << "LOD::" << path << " (" << meshDataList.size() << " parts, " << std::fixed << std::setprecision(1) << ms << " ms)" << std::endl;
+	for (int lod = 0; lod < settings.maxLODs; lod++)
+	{
+		if (triangles[0] == 0) break;
+		std::cout << "  LOD" << lod << ": " << triangles[lod] << " tris ("
+			<< std::setprecision(0) << 100.0 * triangles[lod] / triangles[0] << "%), error "
+			<< std::setprecision(4) << errors[lod] << std::endl;
+	}
+	std::cout.unsetf(std::ios::fixed);
+	std::cout << std::setprecision(6);
+}
+
 void Model::processNode(aiNode* node, const aiScene* scene)
 {
 	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
@@ -1,7 +1,7 @@
 #include "../public/shader.h"
 
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines)
 {
 	std::string vertexCode;
 	std::string fragmentCode;
@@ -32,6 +32,10 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
 	}
 
+	resolveIncludes(vertexCode, vertexPath);
+	resolveIncludes(fragmentCode, fragmentPath);
+	injectDefines(vertexCode, defines);
+	injectDefines(fragmentCode, defines);
 	const char* vShaderCode = vertexCode.c_str();
 	const char* fShaderCode = fragmentCode.c_str();
 
@@ -120,6 +124,9 @@ Shader::Shader(const char* vertexPath, const char* geometryPath, const char* fra
 		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
 	}
 
+	resolveIncludes(vertexCode, vertexPath);
+	resolveIncludes(fragmentCode, fragmentPath);
+	resolveIncludes(geometryCode, geometryPath);
 	const char* vShaderCode = vertexCode.c_str();
 	const char* fShaderCode = fragmentCode.c_str();
 	const char* gShaderCode = geometryCode.c_str();
@@ -187,7 +194,7 @@ Shader::Shader(const char* vertexPath, const char* geometryPath, const char* fra
 	glDeleteShader(geometry);
 }
 
-Shader::Shader(const char* computePath)
+Shader::Shader(const char* computePath, const std::vector<std::string>& defines)
 {
 	std::string computeCode;
 	std::ifstream cShaderFile;
@@ -207,6 +214,8 @@ Shader::Shader(const char* computePath)
 			<< computePath << std::endl;
 	}
 
+	resolveIncludes(computeCode, computePath);
+	injectDefines(computeCode, defines);
 	const char* cShaderCode = computeCode.c_str();
 
 	unsigned int computeShader = glCreateShader(GL_COMPUTE_SHADER);
@@ -284,6 +293,10 @@ Shader::Shader(const char* vertexPath, const char* tesCtrlPath, const char* tesE
 		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
 	}
 
+	resolveIncludes(vertexCode, vertexPath);
+	resolveIncludes(fragmentCode, fragmentPath);
+	resolveIncludes(tesControlCode, tesCtrlPath);
+	resolveIncludes(tesEvaluationCode, tesEvalPath);
 	const char* vShaderCode = vertexCode.c_str();
 	const char* fShaderCode = fragmentCode.c_str();
 	const char* tcShaderCode = tesControlCode.c_str();
@@ -439,4 +452,57 @@ GLint Shader::getUniformLocation(const std::string& name) const
 	return location;
 }
 
+void Shader::injectDefines(std::string& code, const std::vector<std::string>& defines)
+{
+	if (defines.empty()) return;
+
+	std::string block;
+	for (const std::string& define : defines) block += "#define " + define + "\n";
+
+	// #version has to stay the first statement
+	size_t version = code.find("#version");
+	size_t lineEnd = version == std::string::npos ? std::string::npos : code.find('\n', version);
+	if (lineEnd == std::string::npos) code = block + code;
+	else code.insert(lineEnd + 1, block);
+}
+
+void Shader::resolveIncludes(std::string& code, const std::string& path, int depth)
+{
+	if (depth > 8)
+	{
+		std::cout << "ERROR::SHADER::INCLUDE_DEPTH_EXCEEDED: " << path << std::endl;
+		return;
+	}
 
+	std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+	size_t pos = 0;
+	while ((pos = code.find("#include", pos)) != std::string::npos)
+	{
+		size_t lineEnd = code.find('\n', pos);
+		size_t open = code.find('"', pos);
+		size_t close = open == std::string::npos ? std::string::npos : code.find('"', open + 1);
+		if (close == std::string::npos || (lineEnd != std::string::npos && close > lineEnd))
+		{
+			std::cout << "ERROR::SHADER::MALFORMED_INCLUDE: " << path << std::endl;
+			return;
+		}
+
+		// paths are relative to the including file
+		std::string includePath = directory + code.substr(open + 1, close - open - 1);
+		std::ifstream includeFile(includePath);
+		std::string included;
+		if (includeFile)
+		{
+			std::stringstream includeStream;
+			includeStream << includeFile.rdbuf();
+			included = includeStream.str();
+			if (included.compare(0, 3, "\xEF\xBB\xBF") == 0) included.erase(0, 3);
+			resolveIncludes(included, includePath, depth + 1);
+		}
+		else std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND: " << includePath << std::endl;
+
+		size_t length = (lineEnd == std::string::npos ? code.size() : lineEnd) - pos;
+		code.replace(pos, length, included);
+		pos += included.size();
+	}
+}
\ No newline at end of file
@@ -224,13 +224,7 @@ int GeomipTerrain::AddTriangle(int index, int indexC, int index1, int index2)
 void GeomipTerrain::Render(Shader& shader, Camera& camera, glm::mat4& model)
 {
 	shader.use();
-	lodManager.UpdateLOD(camera.getCameraPos(), model);
-	glBindVertexArray(terrainVAO);
-
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
-	// for wireframe mode
-	// glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	UpdateLOD(camera.getCameraPos(), model);
 
 	// setup view projection matrix
 	float pw = 1600.0f;
@@ -239,6 +233,43 @@ void GeomipTerrain::Render(Shader& shader, Camera& camera, glm::mat4& model)
 
 	Frustum frustum(viewProj);
 
+	DrawPatches(model, [&frustum](const glm::vec3& center, float radius)
+		{
+			return frustum.IsPatchSphereInFrustum(center, radius);
+		});
+}
+
+void GeomipTerrain::RenderShadow(Shader& shader, Camera& camera, const ShadowCasterCuller& culler, glm::mat4& model)
+{
+	shader.use();
+	// patches keep the camera LOD so the caster matches the receiver surface
+	UpdateLOD(camera.getCameraPos(), model);
+
+	DrawPatches(model, [&culler](const glm::vec3& center, float radius)
+		{
+			return culler.IsSphereVisible(center, radius);
+		});
+}
+
+void GeomipTerrain::UpdateLOD(const glm::vec3& origin, glm::mat4& model)
+{
+	if (lodValid && origin == lastLODOrigin && model == lastLODModel) return;
+
+	lodManager.UpdateLOD(origin, model);
+	lastLODOrigin = origin;
+	lastLODModel = model;
+	lodValid = true;
+}
+
+void GeomipTerrain::DrawPatches(glm::mat4& model, const std::function<bool(const glm::vec3&, float)>& isPatchVisible)
+{
+	glBindVertexArray(terrainVAO);
+
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_BACK);
+	// for wireframe mode
+	// glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+
 	float scale = glm::length(glm::vec3(model[0]));
 
 	// traverse all patches
@@ -249,23 +280,18 @@ void GeomipTerrain::Render(Shader& shader, Camera& camera, glm::mat4& model)
 			float wx = patchX * (patchSize - 1) * worldScale;
 			float wz = patchZ * (patchSize - 1) * worldScale;
 			float wPatchSize = (patchSize - 1) * worldScale;
-			float patchRad = wPatchSize * glm::sqrt(2.0f) * 0.5f;
 
 			// since height is just based on range 0-1 * heightScale, max height is heightScale
 			glm::vec3 patchCenter = glm::vec3(wx + wPatchSize * 0.5f, heightScale * 0.5f, wz + wPatchSize * 0.5f);
 
-			float patchRadLocal = wPatchSize * glm::sqrt(2.0f) * 0.5f;
+			// bounding sphere of the patch box, including the full height range
+			float patchRadLocal = glm::length(glm::vec3(wPatchSize * 0.5f, heightScale * 0.5f, wPatchSize * 0.5f));
 
 			glm::vec3 patchCenterWorld = glm::vec3(model * glm::vec4(patchCenter, 1.0f));
 			float patchRadWorld = patchRadLocal * scale;
 
-			// cull if sphere is outside the frustum
-			if (!frustum.IsPatchSphereInFrustum(patchCenterWorld, patchRadWorld))
-			{
-				// printf("0");
-				continue;
-			}
-			// else printf("1");
+			// cull if sphere is outside the view volume
+			if (!isPatchVisible(patchCenterWorld, patchRadWorld)) continue;
 
 			const LODManager::PatchLOD& patchLOD = lodManager.GetPatchLOD(patchX, patchZ);
 			// core LOD level
@@ -286,11 +312,8 @@ void GeomipTerrain::Render(Shader& shader, Camera& camera, glm::mat4& model)
 
 			glDrawElementsBaseVertex(GL_TRIANGLES, slice.count, GL_UNSIGNED_INT, (void*)baseIndex, baseVertex);
 		}
-		// printf("\n");
 	}
-	// printf("\n");
 	glBindVertexArray(0);
 	// glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 	glDisable(GL_CULL_FACE);
 }
-
@@ -9,6 +9,7 @@ const std::unordered_map<GLenum, GLenum> Texture::unsizedFormatToType = {
     { GL_BGRA, GL_UNSIGNED_BYTE },
     { GL_DEPTH_COMPONENT, GL_FLOAT },
     { GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8 },
+    { GL_RG_INTEGER, GL_UNSIGNED_INT },
     { GL_SRGB,             GL_UNSIGNED_BYTE },
     { GL_SRGB_ALPHA,       GL_UNSIGNED_BYTE }
 };
@@ -18,6 +19,9 @@ const std::unordered_map<GLenum, GLenum> Texture::sizedFormatToType = {
     { GL_RG8,            GL_UNSIGNED_BYTE },
     { GL_RGB8,           GL_UNSIGNED_BYTE },
     { GL_RGBA8,          GL_UNSIGNED_BYTE },
+    { GL_R16,            GL_UNSIGNED_SHORT },
+    { GL_RG16,           GL_UNSIGNED_SHORT },
+    { GL_RGBA16,         GL_UNSIGNED_SHORT },
     { GL_R16F,           GL_FLOAT },
     { GL_RG16F,          GL_FLOAT },
     { GL_RGB16F,         GL_FLOAT },
@@ -26,6 +30,7 @@ const std::unordered_map<GLenum, GLenum> Texture::sizedFormatToType = {
     { GL_RG32F,          GL_FLOAT },
     { GL_RGB32F,         GL_FLOAT },
     { GL_RGBA32F,        GL_FLOAT },
+    { GL_RG32UI,         GL_UNSIGNED_INT },
     { GL_DEPTH_COMPONENT16, GL_UNSIGNED_SHORT },
     { GL_DEPTH_COMPONENT24, GL_UNSIGNED_INT },
     { GL_DEPTH_COMPONENT32F, GL_FLOAT },
@@ -2,6 +2,8 @@
 #include <iostream>
 #include <vector>
 #include <unordered_map>
+#include <algorithm>
+#include <cfloat>
 
 #include "mesh_data.h"
 #include "model.h"
@@ -16,6 +18,11 @@
 struct Asset
 {
 	std::vector<MeshData> parts;
+
+	// local space bounding sphere, used for screen size LOD selection
+	glm::vec3 boundsCenter = glm::vec3(0.0f);
+	float boundsRadius = 0.0f;
+	int lodCount = 1;
 };
 
 class AssetLibrary
@@ -45,6 +52,7 @@ public:
 		{
 			asset.parts.push_back(meshData);
 		}
+		ComputeBounds(asset);
 
 		return GetLibrary().emplace(name, std::move(asset)).first->second;
 	}
@@ -78,5 +86,28 @@ private:
 		GetLibrary().emplace("Sphere", Asset{ {MeshData{sphereMesh, {}}} });
 		GetLibrary().emplace("Cone", Asset{ {MeshData{coneMesh, {}}} });
 
+		for (auto& pair : GetLibrary()) ComputeBounds(pair.second);
+	}
+
+	static void ComputeBounds(Asset& asset)
+	{
+		glm::vec3 minP(FLT_MAX), maxP(-FLT_MAX);
+		asset.lodCount = 1;
+		for (const MeshData& part : asset.parts)
+		{
+			for (const Vertex& v : part.mesh.vertices)
+			{
+				minP = glm::min(minP, v.Position);
+				maxP = glm::max(maxP, v.Position);
+			}
+			asset.lodCount = std::max(asset.lodCount, part.mesh.getLODCount());
+		}
+		if (minP.x > maxP.x) return;
+
+		asset.boundsCenter = 0.5f * (minP + maxP);
+		asset.boundsRadius = 0.0f;
+		for (const MeshData& part : asset.parts)
+			for (const Vertex& v : part.mesh.vertices)
+				asset.boundsRadius = std::max(asset.boundsRadius, glm::length(v.Position - asset.boundsCenter));
 	}
 };
\ No newline at end of file
@@ -0,0 +1,443 @@
+#pragma once
+#include "camera.h"
+#include "component_manager.h"
+#include "entity_manager.h"
+#include "factory.h"
+#include "light_system.h"
+#include "render_settings.h"
+#include "terrain.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+// NOTE: many lights benchmark. The scene's own objects stay, its point lights are replaced by lightCount generated
+// ones, and the camera follows a fixed path for warmupFrames + frames frames in a hidden window without vsync.
+// Every measured frame records the cpu light work (gather, upload, culling), the gpu culling and shading times and
+// the light counts, written as csv or json (by the output extension) with a mean / p50 / p95 / max summary.
+// gpu timings come from the render stats timers, which read their results two frames late.
+//
+// Engine-0 --benchmark [--lights 10000] [--distribution grid|clustered|terrain] [--radius 4 12]
+//     [--camera static|orbit|flyover] [--frames 300] [--warmup 30] [--moving 0.0]
+//     [--culling tiled|clustered|cpu] [--shading deferred|forward] [--seed 1337] [--output benchmark.csv]
+
+enum class LightDistribution
+{
+	Grid,			// even grid over the area, a few lights per tile
+	Clustered,		// gaussian blobs around random centers, many lights in few tiles
+	Terrain			// uniform over the landscape, just above its surface
+};
+
+enum class BenchmarkCameraPath
+{
+	Static,			// the scene's start camera
+	Orbit,			// circle around the area, looking at its center
+	Flyover			// low diagonal pass over the lights, most of them on screen
+};
+
+struct BenchmarkConfig
+{
+	int lightCount = 10000;
+	LightDistribution distribution = LightDistribution::Terrain;
+	float minRadius = 4.0f;
+	float maxRadius = 12.0f;
+	float intensity = 10.0f;
+	float areaSize = 500.0f;			// side of the square the lights are spread over, centered on the origin
+	BenchmarkCameraPath cameraPath = BenchmarkCameraPath::Orbit;
+	int warmupFrames = 30;
+	int frames = 300;
+	float movingLights = 0.0f;			// fraction of the lights moved every frame, exercises the partial uploads
+	LightCulling culling = LightCulling::Clustered;
+	ShadingPath shading = ShadingPath::Deferred;
+	unsigned int seed = 1337;
+	std::string output = "benchmark.csv";
+};
+
+struct BenchmarkFrame
+{
+	int frame = 0;
+	float frameMs = 0.0f;				// cpu time of the whole frame, swap included
+	float gatherMs = 0.0f;
+	float uploadMs = 0.0f;
+	float cullCpuMs = 0.0f;
+	float cullGpuMs = 0.0f;
+	float shadingGpuMs = 0.0f;
+	int lights = 0;
+	int visibleLights = 0;
+	int uploadedLights = 0;
+	int lightIndices = 0;
+};
+
+class LightBenchmark
+{
+public:
+	// true when --benchmark is on the command line, the other options fill config
+	static bool ParseArgs(int argc, char** argv, BenchmarkConfig& config)
+	{
+		bool enabled = false;
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+			if (arg == "--benchmark") enabled = true;
+			else if (arg == "--lights" && hasValue) config.lightCount = std::max(0, std::atoi(argv[++i]));
+			else if (arg == "--frames" && hasValue) config.frames = std::max(1, std::atoi(argv[++i]));
+			else if (arg == "--warmup" && hasValue) config.warmupFrames = std::max(0, std::atoi(argv[++i]));
+			else if (arg == "--moving" && hasValue) config.movingLights = glm::clamp((float)std::atof(argv[++i]), 0.0f, 1.0f);
+			else if (arg == "--seed" && hasValue) config.seed = (unsigned int)std::atoi(argv[++i]);
+			else if (arg == "--output" && hasValue) config.output = argv[++i];
+			else if (arg == "--radius" && i + 2 < argc)
+			{
+				config.minRadius = (float)std::atof(argv[++i]);
+				config.maxRadius = std::max(config.minRadius, (float)std::atof(argv[++i]));
+			}
+			else if (arg == "--distribution" && hasValue)
+			{
+				std::string value = argv[++i];
+				if (value == "grid") config.distribution = LightDistribution::Grid;
+				else if (value == "clustered") config.distribution = LightDistribution::Clustered;
+				else if (value == "terrain") config.distribution = LightDistribution::Terrain;
+				else std::cout << "ERROR::BENCHMARK::UNKNOWN_DISTRIBUTION " << value << std::endl;
+			}
+			else if (arg == "--camera" && hasValue)
+			{
+				std::string value = argv[++i];
+				if (value == "static") config.cameraPath = BenchmarkCameraPath::Static;
+				else if (value == "orbit") config.cameraPath = BenchmarkCameraPath::Orbit;
+				else if (value == "flyover") config.cameraPath = BenchmarkCameraPath::Flyover;
+				else std::cout << "ERROR::BENCHMARK::UNKNOWN_CAMERA_PATH " << value << std::endl;
+			}
+			else if (arg == "--culling" && hasValue)
+			{
+				std::string value = argv[++i];
+				if (value == "tiled") config.culling = LightCulling::Tiled;
+				else if (value == "clustered") config.culling = LightCulling::Clustered;
+				else if (value == "cpu") config.culling = LightCulling::TiledCPU;
+				else std::cout << "ERROR::BENCHMARK::UNKNOWN_CULLING " << value << std::endl;
+			}
+			else if (arg == "--shading" && hasValue)
+			{
+				std::string value = argv[++i];
+				if (value == "deferred") config.shading = ShadingPath::Deferred;
+				else if (value == "forward") config.shading = ShadingPath::ForwardPlus;
+				else std::cout << "ERROR::BENCHMARK::UNKNOWN_SHADING " << value << std::endl;
+			}
+		}
+		return enabled;
+	}
+
+	LightBenchmark(const BenchmarkConfig& config) : config(config) {}
+
+	void ApplySettings(RenderSettings& settings) const
+	{
+		settings.lightCulling = config.culling;
+		settings.shadingPath = config.shading;
+		settings.stressLights = 0;
+	}
+
+	// creates the point light entities. terrain (with its transform) is only needed by the terrain distribution,
+	// without it the lights are spread over the area at a random height
+	void GenerateLights(
+		EntityManager& entityManager,
+		LightManager& lightManager,
+		TransformManager& transformManager,
+		IDManager& idManager,
+		SceneEntityRegistry& sceneRegistry,
+		Terrain* terrain = nullptr,
+		const TransformComponent* terrainTransform = nullptr)
+	{
+		std::mt19937 gen(config.seed);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		float halfArea = config.areaSize * 0.5f;
+
+		// grid side and blob centers
+		int gridSide = std::max(1, (int)std::ceil(std::sqrt((float)config.lightCount)));
+		std::vector<glm::vec3> centers(std::max(1, config.lightCount / 500));
+		for (glm::vec3& center : centers)
+			center = glm::vec3(-halfArea + unit(gen) * config.areaSize, 0.0f, -halfArea + unit(gen) * config.areaSize);
+		std::normal_distribution<float> blob(0.0f, config.areaSize * 0.02f);
+
+		bool onTerrain = config.distribution == LightDistribution::Terrain && terrain && terrain->HasHeightData() && terrainTransform;
+		if (config.distribution == LightDistribution::Terrain && !onTerrain)
+			std::cout << "ERROR::BENCHMARK::NO_TERRAIN_HEIGHT_DATA, lights are spread over the area" << std::endl;
+
+		lights.clear();
+		lights.reserve(config.lightCount);
+		for (int i = 0; i < config.lightCount; i++)
+		{
+			glm::vec3 position;
+			switch (config.distribution)
+			{
+			case LightDistribution::Grid:
+			{
+				float spacing = config.areaSize / gridSide;
+				position = glm::vec3(-halfArea + (i % gridSide + 0.5f) * spacing, 4.0f, -halfArea + (i / gridSide + 0.5f) * spacing);
+				break;
+			}
+			case LightDistribution::Clustered:
+			{
+				const glm::vec3& center = centers[gen() % centers.size()];
+				position = center + glm::vec3(blob(gen), 1.0f + unit(gen) * 15.0f, blob(gen));
+				break;
+			}
+			default:
+				position = onTerrain
+					? TerrainPoint(*terrain, *terrainTransform, unit(gen), unit(gen)) + glm::vec3(0.0f, 1.0f + unit(gen) * 3.0f, 0.0f)
+					: glm::vec3(-halfArea + unit(gen) * config.areaSize, 1.0f + unit(gen) * 20.0f, -halfArea + unit(gen) * config.areaSize);
+				break;
+			}
+
+			glm::vec3 color(unit(gen), unit(gen), unit(gen));
+			color /= glm::max(color.r, glm::max(color.g, glm::max(color.b, 1e-3f)));
+			float radius = config.minRadius + unit(gen) * (config.maxRadius - config.minRadius);
+
+			Entity entity = WorldObjectFactory::CreatePointLight(entityManager, lightManager, transformManager, idManager,
+				"bench light " + std::to_string(i), position, color, config.intensity, radius);
+			sceneRegistry.Register(entity);
+			lights.push_back({ entity, position });
+
+			// the moving subset goes around all the lights, as static lights they would invalidate the shadow caches
+			TransformComponent* transform = transformManager.GetComponent(entity);
+			if (transform && config.movingLights > 0.0f) transform->isStatic = false;
+		}
+	}
+
+	// camera of the current frame, and the moving lights. call before the lights are synced
+	void BeginFrame(Camera& camera, TransformManager& transformManager)
+	{
+		float t = (float)frameIndex / (float)std::max(1, config.warmupFrames + config.frames);
+		float halfArea = config.areaSize * 0.5f;
+		switch (config.cameraPath)
+		{
+		case BenchmarkCameraPath::Orbit:
+		{
+			float angle = t * glm::two_pi<float>();
+			glm::vec3 position(std::cos(angle) * halfArea * 0.6f, 40.0f, std::sin(angle) * halfArea * 0.6f);
+			camera.setCameraPos(position);
+			camera.setCameraFront(glm::normalize(glm::vec3(0.0f, 5.0f, 0.0f) - position));
+			break;
+		}
+		case BenchmarkCameraPath::Flyover:
+		{
+			glm::vec3 start(-halfArea, 25.0f, halfArea), end(halfArea, 25.0f, -halfArea);
+			camera.setCameraPos(glm::mix(start, end, t));
+			camera.setCameraFront(glm::normalize(end - start + glm::vec3(0.0f, -0.35f * config.areaSize, 0.0f)));
+			break;
+		}
+		default:
+			break;
+		}
+		camera.setCameraUp(glm::vec3(0.0f, 1.0f, 0.0f));
+
+		// a different subset every frame, bobbing around the generated position
+		int moving = (int)(config.movingLights * lights.size());
+		for (int i = 0; i < moving; i++)
+		{
+			size_t index = ((size_t)frameIndex * moving + i) % lights.size();
+			TransformComponent* transform = transformManager.GetComponent(lights[index].entity);
+			if (!transform) continue;
+			transform->position = lights[index].origin + glm::vec3(0.0f, std::sin(frameIndex * 0.1f + (float)index) * 2.0f, 0.0f);
+			transformManager.MarkChanged(lights[index].entity);
+		}
+
+		frameStart = std::chrono::high_resolution_clock::now();
+	}
+
+	// records the frame, true once the last frame is recorded and the report is written
+	bool EndFrame(const RenderStats& stats, const LightSystem& lightSystem)
+	{
+		float frameMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count();
+		if (frameIndex++ < config.warmupFrames) return false;
+
+		const LightSystemTimings& timings = lightSystem.getTimings();
+		BenchmarkFrame frame;
+		frame.frame = frameIndex - config.warmupFrames - 1;
+		frame.frameMs = frameMs;
+		frame.gatherMs = timings.gatherMs;
+		frame.uploadMs = timings.uploadMs;
+		frame.cullCpuMs = timings.cullingMs;
+		frame.cullGpuMs = stats.lightCulling.GetLastMilliseconds();
+		frame.shadingGpuMs = stats.shading.GetLastMilliseconds();
+		frame.lights = stats.lightCount;
+		frame.visibleLights = stats.visibleLights;
+		frame.uploadedLights = stats.lightsUploaded;
+		frame.lightIndices = stats.lightIndices;
+		frames.push_back(frame);
+
+		if ((int)frames.size() < config.frames) return false;
+		WriteReport();
+		return true;
+	}
+
+	bool Finished() const { return (int)frames.size() >= config.frames; }
+
+private:
+	struct GeneratedLight
+	{
+		Entity entity;
+		glm::vec3 origin;
+	};
+
+	struct Summary
+	{
+		float mean = 0.0f, p50 = 0.0f, p95 = 0.0f, max = 0.0f;
+	};
+
+	BenchmarkConfig config;
+	std::vector<GeneratedLight> lights;
+	std::vector<BenchmarkFrame> frames;
+	int frameIndex = 0;
+	std::chrono::high_resolution_clock::time_point frameStart;
+
+	// world position of the terrain surface at (u, v) in [0, 1] over its height data, same model matrix as the renderer
+	static glm::vec3 TerrainPoint(Terrain& terrain, const TransformComponent& transform, float u, float v)
+	{
+		int x = std::min((int)(u * terrain.GetWidth()), terrain.GetWidth() - 1);
+		int z = std::min((int)(v * terrain.GetDepth()), terrain.GetDepth() - 1);
+		glm::vec3 local(x * terrain.GetWorldScale(), terrain.GetScaledHeightAtPoint(x, z), z * terrain.GetWorldScale());
+
+		glm::mat4 model = glm::mat4(1.0f);
+		model = glm::translate(model, transform.position);
+		model = glm::rotate(model, transform.rotation.x, glm::vec3(1, 0, 0));
+		model = glm::rotate(model, transform.rotation.y, glm::vec3(0, 1, 0));
+		model = glm::rotate(model, transform.rotation.z, glm::vec3(0, 0, 1));
+		model = glm::scale(model, transform.scale);
+		return glm::vec3(model * glm::vec4(local, 1.0f));
+	}
+
+	static Summary Summarize(std::vector<float> values)
+	{
+		Summary summary;
+		if (values.empty()) return summary;
+		std::sort(values.begin(), values.end());
+		for (float value : values) summary.mean += value;
+		summary.mean /= values.size();
+		summary.p50 = values[values.size() / 2];
+		summary.p95 = values[std::min(values.size() - 1, values.size() * 95 / 100)];
+		summary.max = values.back();
+		return summary;
+	}
+
+	template <typename Getter>
+	Summary SummarizeStage(Getter getter) const
+	{
+		std::vector<float> values;
+		values.reserve(frames.size());
+		for (const BenchmarkFrame& frame : frames) values.push_back((float)getter(frame));
+		return Summarize(values);
+	}
+
+	static const char* DistributionName(LightDistribution distribution)
+	{
+		switch (distribution)
+		{
+		case LightDistribution::Grid: return "grid";
+		case LightDistribution::Clustered: return "clustered";
+		default: return "terrain";
+		}
+	}
+
+	static const char* CameraPathName(BenchmarkCameraPath path)
+	{
+		switch (path)
+		{
+		case BenchmarkCameraPath::Static: return "static";
+		case BenchmarkCameraPath::Orbit: return "orbit";
+		default: return "flyover";
+		}
+	}
+
+	static const char* CullingName(LightCulling culling)
+	{
+		switch (culling)
+		{
+		case LightCulling::Tiled: return "tiled";
+		case LightCulling::Clustered: return "clustered";
+		default: return "cpu";
+		}
+	}
+
+	void WriteReport() const
+	{
+		struct Stage
+		{
+			const char* name;
+			Summary summary;
+		};
+		std::vector<Stage> stages = {
+			{ "frame_ms", SummarizeStage([](const BenchmarkFrame& f) { return f.frameMs; }) },
+			{ "gather_ms", SummarizeStage([](const BenchmarkFrame& f) { return f.gatherMs; }) },
+			{ "upload_ms", SummarizeStage([](const BenchmarkFrame& f) { return f.uploadMs; }) },
+			{ "cull_cpu_ms", SummarizeStage([](const BenchmarkFrame& f) { return f.cullCpuMs; }) },
+			{ "cull_gpu_ms", SummarizeStage([](const BenchmarkFrame& f) { return f.cullGpuMs; }) },
+			{ "shading_gpu_ms", SummarizeStage([](const BenchmarkFrame& f) { return f.shadingGpuMs; }) },
+			{ "visible_lights", SummarizeStage([](const BenchmarkFrame& f) { return f.visibleLights; }) },
+			{ "light_indices", SummarizeStage([](const BenchmarkFrame& f) { return f.lightIndices; }) },
+		};
+
+		std::cout << "benchmark: " << config.lightCount << " lights (" << DistributionName(config.distribution) << "), "
+			<< CameraPathName(config.cameraPath) << " camera, " << CullingName(config.culling) << " culling, "
+			<< frames.size() << " frames" << std::endl;
+		for (const Stage& stage : stages)
+		{
+			std::cout << "  " << stage.name << ": mean " << stage.summary.mean << ", p50 " << stage.summary.p50
+				<< ", p95 " << stage.summary.p95 << ", max " << stage.summary.max << std::endl;
+		}
+
+		std::ofstream file(config.output);
+		if (!file)
+		{
+			std::cout << "ERROR::BENCHMARK::FILE_NOT_WRITTEN " << config.output << std::endl;
+			return;
+		}
+
+		bool json = config.output.size() >= 5 && config.output.compare(config.output.size() - 5, 5, ".json") == 0;
+		if (!json)
+		{
+			file << "frame,frame_ms,gather_ms,upload_ms,cull_cpu_ms,cull_gpu_ms,shading_gpu_ms,lights,visible_lights,uploaded_lights,light_indices\n";
+			for (const BenchmarkFrame& f : frames)
+			{
+				file << f.frame << "," << f.frameMs << "," << f.gatherMs << "," << f.uploadMs << "," << f.cullCpuMs << ","
+					<< f.cullGpuMs << "," << f.shadingGpuMs << "," << f.lights << "," << f.visibleLights << ","
+					<< f.uploadedLights << "," << f.lightIndices << "\n";
+			}
+			std::cout << "benchmark written to " << config.output << std::endl;
+			return;
+		}
+
+		file << "{\n  \"config\": {"
+			<< "\"lights\": " << config.lightCount
+			<< ", \"distribution\": \"" << DistributionName(config.distribution) << "\""
+			<< ", \"min_radius\": " << config.minRadius
+			<< ", \"max_radius\": " << config.maxRadius
+			<< ", \"camera\": \"" << CameraPathName(config.cameraPath) << "\""
+			<< ", \"culling\": \"" << CullingName(config.culling) << "\""
+			<< ", \"shading\": \"" << (config.shading == ShadingPath::ForwardPlus ? "forward" : "deferred") << "\""
+			<< ", \"moving\": " << config.movingLights
+			<< ", \"warmup\": " << config.warmupFrames
+			<< ", \"frames\": " << config.frames
+			<< ", \"seed\": " << config.seed << "},\n";
+
+		file << "  \"summary\": {";
+		for (size_t i = 0; i < stages.size(); i++)
+		{
+			const Summary& s = stages[i].summary;
+			file << (i ? ", " : "") << "\"" << stages[i].name << "\": {\"mean\": " << s.mean << ", \"p50\": " << s.p50
+				<< ", \"p95\": " << s.p95 << ", \"max\": " << s.max << "}";
+		}
+		file << "},\n  \"frames\": [\n";
+		for (size_t i = 0; i < frames.size(); i++)
+		{
+			const BenchmarkFrame& f = frames[i];
+			file << "    {\"frame\": " << f.frame << ", \"frame_ms\": " << f.frameMs << ", \"gather_ms\": " << f.gatherMs
+				<< ", \"upload_ms\": " << f.uploadMs << ", \"cull_cpu_ms\": " << f.cullCpuMs << ", \"cull_gpu_ms\": " << f.cullGpuMs
+				<< ", \"shading_gpu_ms\": " << f.shadingGpuMs << ", \"lights\": " << f.lights << ", \"visible_lights\": " << f.visibleLights
+				<< ", \"uploaded_lights\": " << f.uploadedLights << ", \"light_indices\": " << f.lightIndices << "}"
+				<< (i + 1 < frames.size() ? ",\n" : "\n");
+		}
+		file << "  ]\n}\n";
+		std::cout << "benchmark written to " << config.output << std::endl;
+	}
+};
\ No newline at end of file
@@ -13,6 +13,7 @@ private:
     glm::vec3 cameraFront;
     glm::vec3 cameraUp;
     float fov;
+    glm::vec2 jitter = glm::vec2(0.0f); // sub pixel offset of the projection in ndc, temporal anti aliasing
 
 public:
     // Constructor with initialization list
@@ -23,13 +24,16 @@ public:
     void setCameraFront(const glm::vec3& front);
     void setCameraUp(const glm::vec3& up);
     void setFOV(const float fov);
+    void setJitter(const glm::vec2& ndcOffset);
 
 
     // Getter methods
-    glm::mat4 getProjectionMatrix(float width, float height, float near, float far);
+    // jittered adds the temporal aa offset, only for passes that rasterize or reproject the jittered scene
+    glm::mat4 getProjectionMatrix(float width, float height, float near, float far, bool jittered = false);
     glm::mat4 getViewMatrix();
     glm::vec3 getCameraPos() const;
     glm::vec3 getCameraFront() const;
     glm::vec3 getCameraUp() const;
     float getFOV() const;
+    glm::vec2 getJitter() const;
 };
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "worldcomponents.h"
 #include "entity_manager.h"
 #include <optional>
+#include <unordered_set>
 
 // NOTE: this is mostly for holding data sets (currently uses a map, with the entity as the key) of components for preparing the components that is needed for a certain system.
 class TransformManager
@@ -13,6 +14,14 @@ public:
 		auto it = components.find(entity);
 		return (it != components.end()) ? &it->second : nullptr;
 	}
+
+	// entities edited this frame, cleared at the end of the frame
+	void MarkChanged(Entity entity) { changed.insert(entity); }
+	const std::unordered_set<Entity>& GetChanged() const { return changed; }
+	void ClearChanged() { changed.clear(); }
+
+private:
+	std::unordered_set<Entity> changed;
 };
 
 class IDManager
@@ -86,6 +95,14 @@ public:
 	{
 		return skyProbeComponent ? &skyProbeComponent->second : nullptr;
 	}
+
+	// local probes added, moved or removed this frame, cleared at the end of the frame
+	void MarkChanged(Entity entity) { changed.insert(entity); }
+	const std::unordered_set<Entity>& GetChanged() const { return changed; }
+	void ClearChanged() { changed.clear(); }
+
+private:
+	std::unordered_set<Entity> changed;
 };
 
 class LightManager
@@ -117,6 +134,14 @@ public:
 	{
 		directionalLightComponents.clear();
 	}
+
+	// point lights added, edited or removed this frame, cleared at the end of the frame
+	void MarkChanged(Entity entity) { changed.insert(entity); }
+	const std::unordered_set<Entity>& GetChanged() const { return changed; }
+	void ClearChanged() { changed.clear(); }
+
+private:
+	std::unordered_set<Entity> changed;
 };
 
 class LandscapeManager
@@ -24,6 +24,7 @@ public:
     void Register(Entity entity)
     {
         sceneEntities.insert(entity);
+        changed.insert(entity);
     }
 
     bool Contains(Entity entity) const
@@ -36,6 +37,11 @@ public:
         return sceneEntities;
     }
 
+    // entities registered this frame, cleared at the end of the frame
+    const std::unordered_set<Entity>& GetChanged() const { return changed; }
+    void ClearChanged() { changed.clear(); }
+
 private:
     std::unordered_set<Entity> sceneEntities;
+    std::unordered_set<Entity> changed;
 };
\ No newline at end of file
@@ -140,17 +140,19 @@ public:
         glm::vec3 color = glm::vec3(1.0f),
         float intensity = 10.0f,
         float radius = 2.5f,
-        bool enabled = true
+        bool enabled = true,
+        bool castShadows = false
     )
     {
         Entity entity = entityManager.CreateEntity();
 
-        PointLightComponent lightComp{ color, intensity, radius, enabled };
+        PointLightComponent lightComp{ color, intensity, radius, enabled, castShadows };
         TransformComponent transformComp;
         transformComp.position = position;
 
         idManager.components[entity].ID = name;
         lightManager.pointLightComponents[entity] = std::move(lightComp);
+        lightManager.MarkChanged(entity);
         transformManager.components[entity] = std::move(transformComp);
 
         return entity;
@@ -169,13 +171,14 @@ public:
 
         EnvironmentProbeComponent probeComp;
         probeComp.settings = settings;
-        probeComp.maps = IBLGenerator::Build(probeComp.settings);
+        probeComp.maps = IBLGenerator::Build(probeComp.settings, false); // no skybox, the environment map is dropped
         probeComp.buildProbe = false;
         probeComp.position = position;
         probeComp.radius = radius;
 
         idManager.components[entity].ID = name;
         probeManager.probeComponents[entity] = std::move(probeComp);
+        probeManager.MarkChanged(entity);
 
         return entity;
     }
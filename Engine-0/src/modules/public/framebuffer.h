@@ -82,6 +82,13 @@ public:
 		unbind();
 	}
 
+	// attaches a single layer of an array texture, rebinding is cheap enough to do per pass
+	void attachTextureLayer(GLenum attachment, unsigned int textureID, int layer, int level = 0) {
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, attachment, textureID, level, layer);
+		unbind();
+	}
+
 	void attachRenderbuffer(GLenum attachment, GLenum internalFormat) {
 		bind();
 		glGenRenderbuffers(1, &rbo);
@@ -134,6 +141,35 @@ public:
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
+	// multisampled color texture and depth renderbuffer, resolved with glBlitFramebuffer.
+	// the depth format has to match the texture it is resolved into
+	Framebuffer(int width, int height, int samples, GLenum colorFormat, GLenum depthFormat) : width(width), height(height), samples(samples)
+	{
+		glGenFramebuffers(1, &FBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture);
+		glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples, colorFormat, width, height, GL_TRUE);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, texture, 0);
+		glGenRenderbuffers(1, &rbo);
+		glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, depthFormat, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rbo);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete." << std::endl;
+
+		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	int getSamples() const
+	{
+		return samples;
+	}
+
 	void bind()
 	{
 		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
@@ -1,5 +1,7 @@
 #pragma once
 #include "../../common.h"
+#include <cstdint>
+#include <xmmintrin.h>
 
 struct Frustum
 {
@@ -39,4 +41,90 @@ struct Frustum
 		}
 		return true;
 	}
+
+	// NOTE: sse batch of IsPatchSphereInFrustum over spheres stored as separate x, y, z, radius arrays, four
+	// spheres per iteration. The arrays must be readable up to count rounded up to a multiple of 4. Writes the
+	// indices of the spheres that pass and returns how many there are.
+	size_t CullSpheres(const float* x, const float* y, const float* z, const float* r, size_t count, uint32_t* visible) const
+	{
+		__m128 px[6], py[6], pz[6], pw[6];
+		for (int i = 0; i < 6; i++)
+		{
+			px[i] = _mm_set1_ps(planes[i].x);
+			py[i] = _mm_set1_ps(planes[i].y);
+			pz[i] = _mm_set1_ps(planes[i].z);
+			pw[i] = _mm_set1_ps(planes[i].w);
+		}
+
+		size_t visibleCount = 0;
+		for (size_t i = 0; i < count; i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(x + i);
+			__m128 cy = _mm_loadu_ps(y + i);
+			__m128 cz = _mm_loadu_ps(z + i);
+			__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(r + i));
+
+			__m128 inside = _mm_cmpeq_ps(cx, cx);
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 dist = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(px[p], cx), _mm_mul_ps(py[p], cy)),
+					_mm_add_ps(_mm_mul_ps(pz[p], cz), pw[p]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, negRadius));
+			}
+
+			int mask = _mm_movemask_ps(inside);
+			for (int lane = 0; mask && lane < 4; lane++, mask >>= 1)
+			{
+				if ((mask & 1) && i + lane < count) visible[visibleCount++] = (uint32_t)(i + lane);
+			}
+		}
+		return visibleCount;
+	}
+
+	// same as above without the near plane. For shadow casters, anything between the light and the volume still casts into it
+	bool IsSphereInFrustumNoNear(glm::vec3 center, float radius) const
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			if (i == 4) continue;
+			float dist = glm::dot(glm::vec3(planes[i]), center) + planes[i].w;
+			if (dist < -radius) return false;
+		}
+		return true;
+	}
+
+	// sphere swept along dir for the given length (a capsule), outside only if both ends are behind the same plane
+	bool IsSweptSphereInFrustum(glm::vec3 center, float radius, glm::vec3 dir, float length) const
+	{
+		glm::vec3 end = center + dir * length;
+		for (int i = 0; i < 6; i++)
+		{
+			glm::vec3 n = glm::vec3(planes[i]);
+			float d0 = glm::dot(n, center) + planes[i].w;
+			float d1 = glm::dot(n, end) + planes[i].w;
+			if (d0 < -radius && d1 < -radius) return false;
+		}
+		return true;
+	}
+};
+
+// NOTE: culling volume for directional shadow casters.
+// A caster is kept when it overlaps the light volume (near plane ignored, the volume is extruded towards the light)
+// and when its shadow, swept along the light direction, can land inside the receiver (camera) frustum.
+struct ShadowCasterCuller
+{
+	Frustum light;
+	Frustum receiver;
+	glm::vec3 lightDir;		// direction the light travels
+	float extrusion;		// how far a shadow can reach from its caster
+
+	ShadowCasterCuller(const glm::mat4& lightViewProj, const glm::mat4& cameraViewProj, const glm::vec3& lightDir, float extrusion)
+		: light(lightViewProj), receiver(cameraViewProj), lightDir(glm::normalize(lightDir)), extrusion(extrusion) {}
+
+	bool IsSphereVisible(glm::vec3 center, float radius) const
+	{
+		return light.IsSphereInFrustumNoNear(center, radius) &&
+			receiver.IsSweptSphereInFrustum(center, radius, lightDir, extrusion);
+	}
 };
\ No newline at end of file
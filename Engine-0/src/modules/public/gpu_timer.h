@@ -0,0 +1,42 @@
+#pragma once
+#include <glad/glad.h>
+
+// NOTE: GL_TIME_ELAPSED timer for a single pass. Two queries are alternated so reading a result never waits on
+// the current frame, timings are one frame late. Timers cannot be nested (one GL_TIME_ELAPSED query at a time).
+class GpuTimer
+{
+public:
+	void Begin()
+	{
+		if (!queries[0]) glGenQueries(2, queries);
+
+		// collect the result of the query issued two frames ago before reusing it
+		if (pending[current])
+		{
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &elapsed);
+			float sample = (float)((double)elapsed / 1.0e6);
+			ms = ms == 0.0f ? sample : ms * 0.9f + sample * 0.1f; // smoothed for display
+			lastMs = sample;
+			pending[current] = false;
+		}
+		glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+	}
+
+	void End()
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		pending[current] = true;
+		current ^= 1;
+	}
+
+	float GetMilliseconds() const { return ms; }
+	float GetLastMilliseconds() const { return lastMs; }	// unsmoothed, for per frame logs
+
+private:
+	GLuint queries[2] = { 0, 0 };
+	bool pending[2] = { false, false };
+	int current = 0;
+	float ms = 0.0f;
+	float lastMs = 0.0f;
+};
\ No newline at end of file
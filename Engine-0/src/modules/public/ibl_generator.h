@@ -1,5 +1,13 @@
 #pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include "../../common.h"
 #include "framebuffer.h"
 #include "shader.h"
@@ -7,7 +15,7 @@
 struct IBLSettings
 {
 	uint32_t envSize = 512;
-	uint32_t irradianceSize = 32;
+	uint32_t irradianceSize = 32;		// texels per face the irradiance sh projection samples
 	uint32_t prefilterSize = 128;
 	uint32_t brdfLUTSize = 512;
 	uint32_t maxMipLevels = 5;
@@ -16,36 +24,48 @@ struct IBLSettings
 
 struct IBLMaps
 {
-	unsigned int envMap;
-	unsigned int irradianceMap;
+	unsigned int envMap;			// 0 unless kept by Build (the sky, for the skybox)
 	unsigned int prefilterMap;
-	unsigned int brdfLUT;
+	unsigned int brdfLUT;			// shared by every probe, not owned
+	glm::vec4 irradianceSH[9];		// rgb of each coefficient, see irradiance_sh.comp
 };
 
+// bump when the baked maps change, older cache files are then ignored
+static constexpr uint32_t IBL_CACHE_VERSION = 2;
+static constexpr const char* IBL_CACHE_DIRECTORY = "cache/ibl";
+
+// NOTE: the environment and prefiltered cubemaps are stored as R11F_G11F_B10F, irradiance is kept as 9 spherical
+// harmonic coefficients (projected from the environment on the gpu) and every probe samples the same brdf lut.
+// The environment map is only needed afterwards by the skybox, so local probes drop it once baked.
+// Baked maps are cached on disk (IBL_CACHE_DIRECTORY), one file per fnv-1a hash of the eqr file contents and the
+// settings. A hit loads every face and mip straight into the textures, so neither the hdr decode nor any of the
+// convolution passes (or their shaders) run. The file holds a small header and the sh coefficients, then each
+// map's transfer format, size and level count followed by the raw texels, level by level and face by face.
 class IBLGenerator
 {
 public:
-	static IBLMaps Build(const IBLSettings& settings)
+	static IBLMaps Build(const IBLSettings& settings, bool keepEnvMap = true)
 	{
-		static Shader EQRToCubemap("shaders/IBL/cubemap.vert", "shaders/IBL/eqr_to_cubemap.frag");
-		static Shader IrradianceShader("shaders/IBL/cubemap.vert", "shaders/IBL/irradiance_convolution.frag");
-		static Shader PrefilterShader("shaders/IBL/cubemap.vert", "shaders/IBL/prefilter_cubemap.frag");
-		static Shader IntegratedBRDF("shaders/IBL/brdf.vert", "shaders/IBL/brdf.frag");
-		static unsigned int cubeVAO = createCubeVAO();
-		static unsigned int frameVAO = createFrameVAO();
-
 		IBLMaps maps{};
 		if (settings.eqrMapPath.empty())
 		{
 			static unsigned int placeholderCubeMap = createPlaceholderCubemap();
 			static unsigned int placeholderTexture = TextureLibrary::GetTexture("White Texture - Default").id;
 			maps.envMap = placeholderCubeMap;
-			maps.irradianceMap = placeholderCubeMap;
 			maps.prefilterMap = placeholderCubeMap;
 			maps.brdfLUT = placeholderTexture;
+			std::fill(maps.irradianceSH, maps.irradianceSH + 9, glm::vec4(0.0f)); // black like the cubemap
 			return maps;
 		}
 
+		maps.brdfLUT = SharedBRDFLUT(settings.brdfLUTSize);
+		uint64_t cacheKey = CacheKey(settings);
+		if (cacheKey && LoadCache(cacheKey, settings, keepEnvMap, maps)) return maps;
+
+		static Shader EQRToCubemap("shaders/IBL/cubemap.vert", "shaders/IBL/eqr_to_cubemap.frag");
+		static Shader PrefilterShader("shaders/IBL/cubemap.vert", "shaders/IBL/prefilter_cubemap.frag");
+		static unsigned int cubeVAO = createCubeVAO();
+
 		unsigned int eqrTexture = loadHDR(settings.eqrMapPath.c_str(), true);
 
 		// FBO helper
@@ -57,7 +77,7 @@ public:
 		glBindTexture(GL_TEXTURE_CUBE_MAP, maps.envMap);
 		for (unsigned int i = 0; i < 6; ++i)
 		{
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB32F, settings.envSize, settings.envSize, 0, GL_RGB, GL_FLOAT, nullptr);
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_R11F_G11F_B10F, settings.envSize, settings.envSize, 0, GL_RGB, GL_FLOAT, nullptr);
 		}
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -102,48 +122,14 @@ public:
 		glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 
 		// Irradiance
-		glGenTextures(1, &maps.irradianceMap);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, maps.irradianceMap);
-		for (unsigned int i = 0; i < 6; ++i)
-		{
-			// no need for high resolution due to low frequency detailing
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB32F, settings.irradianceSize, settings.irradianceSize, 0, GL_RGB, GL_FLOAT, nullptr);
-		}
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-
-		captureFBO.editRenderbufferStorage(settings.irradianceSize, settings.irradianceSize, GL_DEPTH_COMPONENT24);
-
-		IrradianceShader.use();
-		IrradianceShader.setInt("environmentMap", 0);
-		IrradianceShader.setMat4("projection", captureProjection);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, maps.envMap);
-
-		captureFBO.bind();
-		for (unsigned int i = 0; i < 6; i++)
-		{
-			IrradianceShader.setMat4("view", captureViews[i]);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, maps.irradianceMap, 0);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-			glBindVertexArray(cubeVAO);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
-			glBindVertexArray(0);
-		}
-		captureFBO.unbind();
+		ProjectIrradianceSH(maps.envMap, settings, maps.irradianceSH);
 
 		// Pre-filtered map
 		glGenTextures(1, &maps.prefilterMap);
 		glBindTexture(GL_TEXTURE_CUBE_MAP, maps.prefilterMap);
 		for (unsigned int i = 0; i < 6; ++i)
 		{
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB32F, settings.prefilterSize, settings.prefilterSize, 0, GL_RGB, GL_FLOAT, nullptr);
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_R11F_G11F_B10F, settings.prefilterSize, settings.prefilterSize, 0, GL_RGB, GL_FLOAT, nullptr);
 		}
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -186,38 +172,301 @@ public:
 		}
 		captureFBO.unbind();
 
-		// Precomputed BRDF
-		glGenTextures(1, &maps.brdfLUT);
-		glBindTexture(GL_TEXTURE_2D, maps.brdfLUT);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, settings.brdfLUTSize, settings.brdfLUTSize, 0, GL_RG, GL_FLOAT, 0);
+		glDeleteTextures(1, &eqrTexture);
+		if (cacheKey) SaveCache(cacheKey, settings, maps);
+		if (!keepEnvMap)
+		{
+			glDeleteTextures(1, &maps.envMap);
+			maps.envMap = 0;
+		}
+		return maps;
+	}
+
+	// the brdf lut is shared and stays alive
+	static void Destroy(const IBLMaps& maps)
+	{
+		if (maps.envMap) glDeleteTextures(1, &maps.envMap);
+		glDeleteTextures(1, &maps.prefilterMap);
+	}
+private:
+	// one per size, built the first time a probe asks for it
+	static unsigned int SharedBRDFLUT(uint32_t size)
+	{
+		static std::unordered_map<uint32_t, unsigned int> luts;
+		auto it = luts.find(size);
+		if (it != luts.end()) return it->second;
+
+		static Shader IntegratedBRDF("shaders/IBL/brdf.vert", "shaders/IBL/brdf.frag");
+		static unsigned int frameVAO = createFrameVAO();
+
+		unsigned int brdfLUT;
+		glGenTextures(1, &brdfLUT);
+		glBindTexture(GL_TEXTURE_2D, brdfLUT);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, size, size, 0, GL_RG, GL_FLOAT, 0);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-		glBindFramebuffer(GL_FRAMEBUFFER, captureFBO.FBO);
-		glBindRenderbuffer(GL_RENDERBUFFER, captureFBO.getRBO());
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, settings.brdfLUTSize, settings.brdfLUTSize);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, maps.brdfLUT, 0);
-		glViewport(0, 0, settings.brdfLUTSize, settings.brdfLUTSize);
+		Framebuffer captureFBO(size, size);
+		captureFBO.attachRenderbuffer(GL_DEPTH_ATTACHMENT, GL_DEPTH_COMPONENT24);
+		captureFBO.bind();
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUT, 0);
+		glViewport(0, 0, size, size);
 		IntegratedBRDF.use();
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		glBindVertexArray(frameVAO);
 		glDrawArrays(GL_TRIANGLES, 0, 6);
 		captureFBO.unbind();
 
-		glDeleteTextures(1, &eqrTexture);
-		return maps;
+		luts[size] = brdfLUT;
+		return brdfLUT;
 	}
 
-	static void Destroy(const IBLMaps& maps)
+	// 9 sh coefficients of the environment's irradiance, read back once per bake
+	static void ProjectIrradianceSH(unsigned int envMap, const IBLSettings& settings, glm::vec4* sh)
 	{
-		glDeleteTextures(1, &maps.envMap);
-		glDeleteTextures(1, &maps.irradianceMap);
-		glDeleteTextures(1, &maps.prefilterMap);
-		glDeleteTextures(1, &maps.brdfLUT);
+		static Shader SHShader("shaders/IBL/irradiance_sh.comp");
+		static GLuint shBuffer = 0;
+		if (!shBuffer)
+		{
+			glGenBuffers(1, &shBuffer);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, shBuffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::vec4) * 9, nullptr, GL_DYNAMIC_READ);
+		}
+
+		int sampleSize = (int)std::max(std::min(settings.irradianceSize, settings.envSize), 1u);
+		SHShader.use();
+		SHShader.setInt("environmentMap", 0);
+		SHShader.setInt("sampleSize", sampleSize);
+		SHShader.setFloat("sampleLod", std::log2((float)settings.envSize / (float)sampleSize));
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, envMap);
+		// binding 15 is the probe sh buffer while shading, ApplyLightingUniforms binds it again
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, shBuffer);
+		glDispatchCompute(1, 1, 1);
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, shBuffer);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(glm::vec4) * 9, sh);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 	}
-private:
+
+	// how a map is read back and uploaded again, in envMap, prefilterMap order
+	struct CacheFormat
+	{
+		GLenum internalFormat, format, type;
+		uint32_t texelBytes;
+		bool cubemap;
+	};
+
+	struct CacheHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+	};
+
+	struct CacheMap
+	{
+		uint32_t internalFormat, format, type, texelBytes;
+		uint32_t cubemap, size, levels;
+	};
+
+	static const CacheFormat* CacheFormats()
+	{
+		static const CacheFormat formats[2] = {
+			{ GL_R11F_G11F_B10F, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV, 4, true },
+			{ GL_R11F_G11F_B10F, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV, 4, true },
+		};
+		return formats;
+	}
+
+	static uint64_t Fnv1a(uint64_t hash, const void* data, size_t bytes)
+	{
+		const unsigned char* p = (const unsigned char*)data;
+		for (size_t i = 0; i < bytes; i++)
+		{
+			hash ^= p[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// hash of the eqr file and the settings, 0 when the file cannot be read
+	static uint64_t CacheKey(const IBLSettings& settings)
+	{
+		std::ifstream file(settings.eqrMapPath, std::ios::binary);
+		if (!file) return 0;
+
+		uint64_t hash = 14695981039346656037ull;
+		std::vector<char> chunk(1 << 20);
+		while (file)
+		{
+			file.read(chunk.data(), chunk.size());
+			hash = Fnv1a(hash, chunk.data(), (size_t)file.gcount());
+		}
+
+		uint32_t fields[6] = { IBL_CACHE_VERSION, settings.envSize, settings.irradianceSize,
+			settings.prefilterSize, settings.brdfLUTSize, settings.maxMipLevels };
+		hash = Fnv1a(hash, fields, sizeof(fields));
+		return hash ? hash : 1;
+	}
+
+	static std::string CachePath(uint64_t key)
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.ibl", (unsigned long long)key);
+		return std::string(IBL_CACHE_DIRECTORY) + "/" + name;
+	}
+
+	static void SaveCache(uint64_t key, const IBLSettings& settings, const IBLMaps& maps)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(IBL_CACHE_DIRECTORY, error);
+		std::string path = CachePath(key);
+		std::ofstream file(path, std::ios::binary);
+		if (!file)
+		{
+			std::cout << "ERROR::IBL_CACHE::CANNOT_WRITE " << path << std::endl;
+			return;
+		}
+
+		CacheHeader header = { { 'I', 'B', 'L', 'C' }, IBL_CACHE_VERSION, key };
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)maps.irradianceSH, sizeof(maps.irradianceSH));
+
+		const unsigned int textures[2] = { maps.envMap, maps.prefilterMap };
+		const uint32_t sizes[2] = { settings.envSize, settings.prefilterSize };
+		std::vector<char> texels;
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		for (int m = 0; m < 2; m++)
+		{
+			const CacheFormat& format = CacheFormats()[m];
+			GLenum target = format.cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+			glBindTexture(target, textures[m]);
+
+			// every level the texture has
+			uint32_t levels = 0;
+			for (GLint level = 0; level < 16; level++)
+			{
+				GLint width = 0;
+				glGetTexLevelParameteriv(format.cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+				if (width <= 0) break;
+				levels++;
+			}
+
+			CacheMap map = { format.internalFormat, format.format, format.type, format.texelBytes,
+				format.cubemap ? 1u : 0u, sizes[m], levels };
+			file.write((const char*)&map, sizeof(map));
+
+			for (uint32_t level = 0; level < levels; level++)
+			{
+				uint32_t size = std::max(sizes[m] >> level, 1u);
+				texels.resize((size_t)size * size * format.texelBytes);
+				for (int face = 0; face < (format.cubemap ? 6 : 1); face++)
+				{
+					GLenum faceTarget = format.cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+					glGetTexImage(faceTarget, level, format.format, format.type, texels.data());
+					file.write(texels.data(), texels.size());
+				}
+			}
+			glBindTexture(target, 0);
+		}
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+		if (!file) std::cout << "ERROR::IBL_CACHE::CANNOT_WRITE " << path << std::endl;
+	}
+
+	// false on a miss, a file from another version or a map that does not match the settings, nothing is left
+	// allocated then. the environment map is skipped unless kept
+	static bool LoadCache(uint64_t key, const IBLSettings& settings, bool keepEnvMap, IBLMaps& maps)
+	{
+		std::ifstream file(CachePath(key), std::ios::binary);
+		if (!file) return false;
+
+		CacheHeader header{};
+		file.read((char*)&header, sizeof(header));
+		if (!file || std::string(header.magic, 4) != "IBLC" || header.version != IBL_CACHE_VERSION || header.key != key)
+			return false;
+		glm::vec4 sh[9];
+		file.read((char*)sh, sizeof(sh));
+
+		unsigned int textures[2] = {};
+		const uint32_t sizes[2] = { settings.envSize, settings.prefilterSize };
+		std::vector<char> texels;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		bool loaded = (bool)file;
+		for (int m = 0; m < 2 && loaded; m++)
+		{
+			CacheMap map{};
+			file.read((char*)&map, sizeof(map));
+			// a damaged header could ask for huge allocations, only the layout SaveCache writes is accepted
+			const CacheFormat& format = CacheFormats()[m];
+			if (!file || map.levels == 0 || map.levels > 16 || map.size != sizes[m] || map.texelBytes != format.texelBytes ||
+				map.internalFormat != format.internalFormat || map.format != format.format || map.type != format.type ||
+				map.cubemap != (format.cubemap ? 1u : 0u))
+			{
+				loaded = false;
+				break;
+			}
+
+			if (m == 0 && !keepEnvMap)
+			{
+				std::streamoff bytes = 0;
+				for (uint32_t level = 0; level < map.levels; level++)
+				{
+					uint32_t size = std::max(map.size >> level, 1u);
+					bytes += (std::streamoff)size * size * map.texelBytes * (map.cubemap ? 6 : 1);
+				}
+				file.seekg(bytes, std::ios::cur);
+				continue;
+			}
+
+			GLenum target = map.cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+			glGenTextures(1, &textures[m]);
+			glBindTexture(target, textures[m]);
+			for (uint32_t level = 0; level < map.levels && loaded; level++)
+			{
+				uint32_t size = std::max(map.size >> level, 1u);
+				texels.resize((size_t)size * size * map.texelBytes);
+				for (int face = 0; face < (map.cubemap ? 6 : 1); face++)
+				{
+					file.read(texels.data(), texels.size());
+					if (!file)
+					{
+						loaded = false;
+						break;
+					}
+					GLenum faceTarget = map.cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+					glTexImage2D(faceTarget, level, map.internalFormat, size, size, 0, map.format, map.type, texels.data());
+				}
+			}
+
+			// same sampling state Build gives the maps
+			glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			if (map.cubemap) glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+			glTexParameteri(target, GL_TEXTURE_MIN_FILTER, map.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+			glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, map.levels - 1);
+			glBindTexture(target, 0);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		if (!loaded)
+		{
+			std::cout << "ERROR::IBL_CACHE::CORRUPT " << CachePath(key) << std::endl;
+			glDeleteTextures(2, textures);
+			return false;
+		}
+
+		maps.envMap = textures[0];
+		maps.prefilterMap = textures[1];
+		std::copy(sh, sh + 9, maps.irradianceSH);
+		return true;
+	}
+
 	static unsigned int loadHDR(const char* path, bool flipVertically)
 	{
 		stbi_set_flip_vertically_on_load(flipVertically);
@@ -0,0 +1,71 @@
+#pragma once
+#include "light_table.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// NOTE: cpu version of lighting_tiled.comp, with the same tile planes (unprojected tile corners through the eye),
+// the same depth range reduction and the same sphere tests, so its lists can be compared to the gpu ones or
+// uploaded in their place. Lights are moved to view space once into padded arrays, then the tiles are split over
+// worker threads and every tile tests 8 lights at a time with avx2 (4 at a time with sse where avx2 is missing).
+// The only differences to the shader are the order inside a list (the gpu appends with an atomic) and which lights
+// are kept when a tile overflows maxLightsPerTile (the gpu keeps whichever came first). The lists are compacted,
+// tile offsets are a running sum instead of tile * maxLightsPerTile.
+
+struct TileCullingInput
+{
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::mat4 projection = glm::mat4(1.0f);	// the same unjittered matrix the gpu culling gets
+	int screenWidth = 0;
+	int screenHeight = 0;
+	int tileSize = 16;
+	int maxLightsPerTile = 256;
+	const float* depth = nullptr;			// window depth in texel order (row 0 at the bottom), null culls in 2D
+};
+
+struct TileLightLists
+{
+	int tilesX = 0;
+	int tilesY = 0;
+	std::vector<glm::uvec2> tileInfo;		// offset and count per tile, row major from the bottom left
+	std::vector<uint32_t> lightIndices;		// light table slots
+};
+
+class CpuLightCuller
+{
+public:
+	enum class Path { Auto, Scalar, SSE, AVX2 };
+
+	// culls lights[lightIDs[i]] for i < count into per tile lists of lightIDs entries.
+	// threads = 0 uses every hardware thread
+	void CullTiles(
+		const TileCullingInput& input,
+		const GPULight* lights,
+		const uint32_t* lightIDs,
+		size_t count,
+		TileLightLists& out,
+		int threads = 0,
+		Path path = Path::Auto);
+
+	// smallest distance of the sphere to any of the tile's rejection tests, positive inside. lights that only one
+	// side accepts with a margin close to 0 are float rounding, not culling bugs
+	float TileMargin(const TileCullingInput& input, const GPULight& light, int tileX, int tileY) const;
+
+	static bool HasAVX2();
+	static const char* PathName(Path path);
+
+private:
+	struct TileFrustum
+	{
+		glm::vec3 normals[4];
+		glm::vec2 depthRange;	// view distance, x > y when the tile only covers sky
+	};
+
+	std::vector<float> viewX, viewY, viewZ, radius;		// padded to 8 with lights that fail every test
+	std::vector<uint32_t> ids;
+	std::vector<uint32_t> scratch;						// maxLightsPerTile per tile before compaction
+	std::vector<uint32_t> counts;
+
+	TileFrustum BuildTile(const TileCullingInput& input, const glm::mat4& invProjection, int tileX, int tileY) const;
+	void CullTileRange(const TileCullingInput& input, const glm::mat4& invProjection, int tilesX, int firstTile, int lastTile, int stride, Path path);
+};
\ No newline at end of file
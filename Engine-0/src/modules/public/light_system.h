@@ -3,93 +3,560 @@
 #include "component_manager.h"
 #include "shader.h"
 #include "shader_storage_buffer.h"
+#include "render_settings.h"
+#include "light_table.h"
+#include "frustum.h"
+#include "light_culling_cpu.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
 
-static constexpr int MAX_LIGHTS = 1600;
-static constexpr int MAX_LIGHTS_PER_TILE = 256;
+static constexpr int MAX_LIGHTS_PER_TILE = 256; // tiled culling only, the clustered lists have no cap
+static constexpr int MAX_PROBES_PER_TILE = 8;   // local environment probes listed per screen tile
+static constexpr int PROBE_LIST_STRIDE = MAX_PROBES_PER_TILE + 1;  // count, then the probe indices
+static constexpr int MAX_LOCAL_PROBES = 32;     // the culling keeps 32 bit probe masks, at least MAX_RESIDENT_PROBES
 
-// mirror struct from comp shader
-struct GPULight
+// cpu time of the last frame's light work, for the benchmark reports
+struct LightSystemTimings
 {
-    glm::vec4 pos_radius;
-    glm::vec4 color_intensity;
+    float gatherMs = 0.0f;      // change sets applied to the light table
+    float uploadMs = 0.0f;      // dirty ranges written into the light buffer
+    float cullingMs = 0.0f;     // frustum test and the culling dispatches (or the whole cpu culling)
 };
 
+// NOTE: point light culling into per cluster light lists (see cluster_common.glsl). Clustered culling counts the
+// lights of every cluster, prefix sums the counts into offsets and fills one compacted index list, so nothing caps
+// the light count except memory: the light, cluster and index buffers grow when they run out. The index total is
+// only known on the gpu, it is read back a frame later (behind a fence, so it never stalls) and a frame that
+// overflows keeps the lights that fit until the buffer has grown. Tiled culling is the same layout with a single
+// slice and fixed lists of MAX_LIGHTS_PER_TILE, culled against the depth bounds of each tile.
+// The light buffer mirrors a LightTable that follows the light, transform and scene change events, so a frame
+// only uploads the lights that changed. The gpu culling walks a list of the lights that pass a cpu frustum test,
+// which is rebuilt only when the lights or the camera changed.
+// The tiled lists can also be built on the cpu (light_culling_cpu.h) and uploaded, which is the reference the gpu
+// lists are validated against and a fallback when the compute culling is not wanted.
+// Local environment probes are culled in the same passes into fixed lists per screen tile (all slices share them),
+// so the shading only blends the probes that reach its tile. When more than MAX_PROBES_PER_TILE reach a tile the
+// ones nearest to the camera are kept, in every path: the culling collects a mask of the tile's probes and walks
+// it in the probe order the cpu sorts each frame.
 class LightSystem
 {
 private:
     Shader lightCompShader;
+    Shader clusterCountShader, clusterScanShader, clusterFillShader;
     ShaderStorageBuffer lightSSBO;
     ShaderStorageBuffer lightIndexSSBO;
-    ShaderStorageBuffer tileInfoSSBO;
+    ShaderStorageBuffer tileInfoSSBO;       // offset and count per cluster (per tile when tiled)
+    ShaderStorageBuffer clusterCountSSBO;
+    ShaderStorageBuffer indexTotalSSBO;
+    ShaderStorageBuffer visibleSSBO;        // table slots that passed the frustum test
+    ShaderStorageBuffer shadowIndexSSBO;    // point shadow record per table slot, -1 when unshadowed
+    GLsizeiptr lightCapacity = 0, indexCapacity = 0, infoCapacity = 0, countCapacity = 0, visibleCapacity = 0; // bytes
+    GLsizeiptr shadowIndexCapacity = 0;
+    ShaderStorageBuffer probeSSBO;          // position and radius of the local probes
+    ShaderStorageBuffer probeListSSBO;      // PROBE_LIST_STRIDE uints per screen tile
+    GLsizeiptr probeCapacity = 0, probeListCapacity = 0;
+    GLsync indexTotalFence = nullptr;
     int screenWidth, screenHeight;
-    int tileSize, tileCount;
-    int numTilesX,numTilesY;
+    int tileSize;
+    int clusterTileSize, sliceCount;
+    int numTilesX, numTilesY;
+    bool clustered = true;                  // layout of the last culling, for the shading uniforms
+    bool cpuCulled = false;                 // the last tiled lists came from the cpu
+    int indexTotal = 0;                     // last read back clustered index count
+
+    LightTable table;
+    std::vector<std::pair<uint32_t, uint32_t>> dirtyRanges;
+    int uploadedLights = 0;                 // written into the light buffer by the last sync
+    bool lightsChanged = true;              // since the visible list was built
+
+    std::vector<uint32_t> visibleLights;
+    int visibleCount = 0;
+
+    std::vector<std::pair<int, int>> shadowSlots, uploadedShadowSlots;  // table slot and shadow record
+
+    std::vector<glm::vec4> probes;          // uploaded probe bounds
+    std::vector<GLuint> probeOrder;         // indices of the probes in use, nearest to the camera first
+    std::vector<GLuint> cpuProbeLists;
+    glm::mat4 visibleMatrix = glm::mat4(0.0f);
+
+    CpuLightCuller cpuCuller;
+    TileLightLists cpuLists;
+    LightSystemTimings timings;
+
+    // synthetic lights on top of the scene's, for stress testing the culling
+    int stressLightCount = 0;
+
+    static constexpr float NEAR_PLANE = 0.1f;
+    static constexpr float FAR_PLANE = 2500.0f;
+
+    static float ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // grows the buffer to hold at least size bytes, with headroom. contents are lost
+    static void Reserve(ShaderStorageBuffer& buffer, GLsizeiptr& capacity, GLsizeiptr size, GLuint bindingPoint)
+    {
+        if (size <= capacity) return;
+        if (capacity) glDeleteBuffers(1, &buffer.SSBO);
+        capacity = size + size / 2;
+        buffer = ShaderStorageBuffer(bindingPoint, 1, capacity);
+    }
+
+    // one shadow record index per table slot, a grown buffer is reset to unshadowed and rewritten by the next
+    // SetShadowedLights
+    void ReserveShadowIndices()
+    {
+        GLsizeiptr oldCapacity = shadowIndexCapacity;
+        Reserve(shadowIndexSSBO, shadowIndexCapacity, sizeof(int32_t) * std::max(table.Size(), (size_t)1024), 11);
+        if (shadowIndexCapacity == oldCapacity) return;
+
+        int32_t unshadowed = -1;
+        shadowIndexSSBO.bind();
+        glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32I, 0, shadowIndexCapacity & ~(GLsizeiptr)3, GL_RED_INTEGER, GL_INT, &unshadowed);
+        uploadedShadowSlots.clear();
+    }
+
+    void UpdateTileCount()
+    {
+        int size = clustered ? clusterTileSize : tileSize;
+        numTilesX = (screenWidth + size - 1) / size;
+        numTilesY = (screenHeight + size - 1) / size;
+    }
+
+    void UpdateLight(Entity entity, SceneEntityRegistry& sceneRegistry, LightManager& lightManager, TransformManager& transformManager)
+    {
+        PointLightComponent* lightComp = lightManager.GetPointLightComponent(entity);
+        TransformComponent* transformComp = transformManager.GetComponent(entity);
+        if (!lightComp || !lightComp->enabled || !transformComp || !sceneRegistry.Contains(entity))
+        {
+            table.Remove(entity);
+            return;
+        }
+
+        GPULight light{ 
+            glm::vec4(transformComp->position, lightComp->radius),
+            glm::vec4(lightComp->color, lightComp->intensity) 
+        };
+        table.Set(entity, light);
+    }
+
+    // copies the dirty ranges of the table into the light buffer, everything when the buffer had to grow
+    void UploadLights()
+    {
+        if (!table.TakeDirtyRanges(dirtyRanges))
+        {
+            uploadedLights = 0;
+            return;
+        }
+        lightsChanged = true;
+
+        GLsizeiptr oldCapacity = lightCapacity;
+        Reserve(lightSSBO, lightCapacity, sizeof(GPULight) * std::max(table.Size(), (size_t)1), 0);
+        if (lightCapacity != oldCapacity)
+        {
+            dirtyRanges.assign(1, { 0u, (uint32_t)table.Size() });
+        }
+        ReserveShadowIndices();
+
+        uploadedLights = 0;
+        for (const auto& range : dirtyRanges)
+        {
+            uint32_t count = range.second - range.first;
+            if (!count) continue;
+            lightSSBO.setData(sizeof(GPULight) * range.first, sizeof(GPULight) * count, table.Data() + range.first);
+            uploadedLights += count;
+        }
+    }
+
+    // sse sphere test of every light against the unjittered camera frustum (the jitter moves the screen edges by
+    // less than a pixel), skipped while neither the lights nor the camera moved
+    void UpdateVisibleLights(Camera& camera)
+    {
+        glm::mat4 cullMatrix = camera.getProjectionMatrix(screenWidth, screenHeight, NEAR_PLANE, FAR_PLANE) * camera.getViewMatrix();
+        if (!lightsChanged && cullMatrix == visibleMatrix) return;
+        lightsChanged = false;
+        visibleMatrix = cullMatrix;
+
+        visibleLights.resize(std::max(table.Size(), (size_t)1));
+        Frustum frustum(cullMatrix);
+        visibleCount = (int)frustum.CullSpheres(
+            table.CentersX(), table.CentersY(), table.CentersZ(), table.Radii(), table.Size(), visibleLights.data());
+
+        Reserve(visibleSSBO, visibleCapacity, sizeof(uint32_t) * std::max(visibleCount, 1), 10);
+        if (visibleCount) visibleSSBO.setData(0, sizeof(uint32_t) * visibleCount, visibleLights.data());
+    }
+
+    void TileCulling(Camera& camera, GLuint depthTexture)
+    {
+        int tileCount = numTilesX * numTilesY;
+        Reserve(tileInfoSSBO, infoCapacity, sizeof(glm::uvec2) * tileCount, 1);
+        Reserve(lightIndexSSBO, indexCapacity, sizeof(GLuint) * tileCount * MAX_LIGHTS_PER_TILE, 2);
+
+        // the culling writes every tile's offset and count, nothing to reset here
+        glm::mat4 projection = camera.getProjectionMatrix(screenWidth, screenHeight, NEAR_PLANE, FAR_PLANE);
+        lightCompShader.use();
+        lightCompShader.setMat4("view", camera.getViewMatrix());
+        lightCompShader.setMat4("invProjection", glm::inverse(projection));
+        lightCompShader.setIVec2("screenSize", screenWidth, screenHeight);
+        lightCompShader.setIVec2("tileCount", numTilesX, numTilesY);
+        lightCompShader.setInt("lightCount", visibleCount);
+        lightCompShader.setInt("probeCount", (int)probes.size());
+        ApplyProbeOrder(lightCompShader);
+        lightCompShader.setBool("useDepthBounds", depthTexture != 0);
+        lightCompShader.setInt("gDepth", 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+
+        glDispatchCompute(numTilesX, numTilesY, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // the lists are compacted on the cpu, so only the used part of the index buffer is uploaded
+    void CpuTileCulling(Camera& camera)
+    {
+        BuildCpuTileLists(camera, nullptr, cpuLists);
+        Reserve(tileInfoSSBO, infoCapacity, sizeof(glm::uvec2) * cpuLists.tileInfo.size(), 1);
+        Reserve(lightIndexSSBO, indexCapacity, sizeof(GLuint) * cpuLists.lightIndices.size(), 2);
+        tileInfoSSBO.setData(0, sizeof(glm::uvec2) * cpuLists.tileInfo.size(), cpuLists.tileInfo.data());
+        lightIndexSSBO.setData(0, sizeof(GLuint) * cpuLists.lightIndices.size(), cpuLists.lightIndices.data());
+        CpuProbeCulling(camera);
+    }
+
+    // tiles under the screen rect of a sphere's view space box, the whole screen once it reaches the near plane.
+    // false when it is off screen. same bounds as cluster_assign.comp
+    bool SphereTileRect(const glm::mat4& view, const glm::mat4& projection, const glm::vec4& sphere, glm::ivec2& tileMin, glm::ivec2& tileMax) const
+    {
+        int size = clustered ? clusterTileSize : tileSize;
+        glm::vec3 vp = glm::vec3(view * glm::vec4(glm::vec3(sphere), 1.0f));
+        float r = sphere.w;
+        float distance = -vp.z;
+        if (distance + r < NEAR_PLANE || distance - r > FAR_PLANE) return false;
+
+        tileMin = glm::ivec2(0);
+        tileMax = glm::ivec2(numTilesX - 1, numTilesY - 1);
+        if (distance - r <= NEAR_PLANE) return true;
+
+        glm::vec2 ndcMin(1e9f), ndcMax(-1e9f);
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner = vp + r * glm::vec3((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f);
+            glm::vec4 clip = projection * glm::vec4(corner, 1.0f);
+            glm::vec2 ndc = glm::vec2(clip) / clip.w;
+            ndcMin = glm::min(ndcMin, ndc);
+            ndcMax = glm::max(ndcMax, ndc);
+        }
+        if (ndcMax.x < -1.0f || ndcMax.y < -1.0f || ndcMin.x > 1.0f || ndcMin.y > 1.0f) return false;
+
+        glm::vec2 screen((float)screenWidth, (float)screenHeight);
+        tileMin = glm::clamp(glm::ivec2(glm::floor((ndcMin * 0.5f + 0.5f) * screen)) / size, glm::ivec2(0), tileMax);
+        tileMax = glm::clamp(glm::ivec2(glm::floor((ndcMax * 0.5f + 0.5f) * screen)) / size, glm::ivec2(0), tileMax);
+        return true;
+    }
+
+    // sorts the probes in use by the camera distance to their sphere, free layers are left out
+    void UpdateProbeOrder(Camera& camera)
+    {
+        glm::vec3 cameraPos = camera.getCameraPos();
+        probeOrder.clear();
+        for (size_t i = 0; i < probes.size(); i++)
+        {
+            if (probes[i].w >= 0.0f) probeOrder.push_back((GLuint)i);
+        }
+        auto distance = [&](GLuint i) { return std::max(glm::length(glm::vec3(probes[i]) - cameraPos) - probes[i].w, 0.0f); };
+        std::stable_sort(probeOrder.begin(), probeOrder.end(), [&](GLuint a, GLuint b) { return distance(a) < distance(b); });
+    }
+
+    void ApplyProbeOrder(Shader& shader)
+    {
+        shader.use();
+        shader.setInt("probeOrderCount", (int)probeOrder.size());
+        if (!probeOrder.empty()) glUniform1uiv(shader.getUniformLocation("probeOrder"), (GLsizei)probeOrder.size(), probeOrder.data());
+    }
+
+    // probe lists of the cpu tiled path, from the screen rects alone (the cpu lists have no depth bounds either).
+    // probes are appended nearest first, so full tiles keep the nearest ones
+    void CpuProbeCulling(Camera& camera)
+    {
+        cpuProbeLists.assign((size_t)numTilesX * numTilesY * PROBE_LIST_STRIDE, 0u);
+        glm::mat4 view = camera.getViewMatrix();
+        glm::mat4 projection = camera.getProjectionMatrix(screenWidth, screenHeight, NEAR_PLANE, FAR_PLANE);
+        for (GLuint i : probeOrder)
+        {
+            glm::ivec2 tileMin, tileMax;
+            if (!SphereTileRect(view, projection, probes[i], tileMin, tileMax)) continue;
+            for (int y = tileMin.y; y <= tileMax.y; y++)
+            {
+                for (int x = tileMin.x; x <= tileMax.x; x++)
+                {
+                    GLuint* list = &cpuProbeLists[(size_t)(y * numTilesX + x) * PROBE_LIST_STRIDE];
+                    if (list[0] < (GLuint)MAX_PROBES_PER_TILE) list[1 + list[0]++] = i;
+                }
+            }
+        }
+        probeListSSBO.setData(0, sizeof(GLuint) * cpuProbeLists.size(), cpuProbeLists.data());
+    }
+
+    void ClusterCulling(Camera& camera)
+    {
+        int clusterCount = numTilesX * numTilesY * sliceCount;
+        Reserve(tileInfoSSBO, infoCapacity, sizeof(glm::uvec2) * clusterCount, 1);
+        if ((GLsizeiptr)(sizeof(GLuint) * clusterCount) > countCapacity)
+        {
+            // the scan leaves the counts at zero for the next frame, only a new buffer needs clearing
+            Reserve(clusterCountSSBO, countCapacity, sizeof(GLuint) * clusterCount, 8);
+            clusterCountSSBO.bind();
+            GLuint zero = 0;
+            glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        }
+
+        // last frame's index total, grown before this frame's lists are filled
+        if (indexTotalFence && glClientWaitSync(indexTotalFence, 0, 0) != GL_TIMEOUT_EXPIRED)
+        {
+            GLuint total = 0;
+            indexTotalSSBO.bind();
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &total);
+            indexTotal = (int)total;
+            glDeleteSync(indexTotalFence);
+            indexTotalFence = nullptr;
+        }
+        Reserve(lightIndexSSBO, indexCapacity, sizeof(GLuint) * std::max(indexTotal, clusterCount * 8), 2);
+
+        glm::mat4 view = camera.getViewMatrix();
+        glm::mat4 projection = camera.getProjectionMatrix(screenWidth, screenHeight, NEAR_PLANE, FAR_PLANE);
+        // the counting pass also marks the probes of each tile after the lights, the fill pass turns the marks into
+        // the tile lists
+        GLuint countGroups = (GLuint)(visibleCount + (int)probes.size() + 63) / 64;
+        GLuint fillGroups = (GLuint)(visibleCount + numTilesX * numTilesY + 63) / 64;
+
+        for (Shader* shader : { &clusterCountShader, &clusterFillShader })
+        {
+            ConfigureTileUniforms(*shader);
+            shader->setMat4("view", view);
+            shader->setMat4("projection", projection);
+            shader->setInt("lightCount", visibleCount);
+            shader->setInt("probeCount", (int)probes.size());
+        }
+        ApplyProbeOrder(clusterFillShader);
+
+        // probes are or'ed into the tile masks with atomics, the masks start at zero
+        GLuint zero = 0;
+        probeListSSBO.bind();
+        glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, sizeof(GLuint) * numTilesX * numTilesY * PROBE_LIST_STRIDE,
+            GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, clusterCountSSBO.SSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, indexTotalSSBO.SSBO);
+
+        clusterCountShader.use();
+        if (countGroups) glDispatchCompute(countGroups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        clusterScanShader.use();
+        clusterScanShader.setInt("clusterCount", clusterCount);
+        clusterScanShader.setInt("indexCapacity", (int)(indexCapacity / sizeof(GLuint)));
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        clusterFillShader.use();
+        if (fillGroups) glDispatchCompute(fillGroups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        if (!indexTotalFence) indexTotalFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
 
 public:
     LightSystem(
         int screenWidth = 1600,
         int screenHeight = 1200,
-        int tileSize = 16
+        int tileSize = 16,
+        int clusterTileSize = 64,
+        int sliceCount = 24
     )
     {
         this->screenWidth = screenWidth;
         this->screenHeight = screenHeight;
         this->tileSize = tileSize;
-        this->numTilesX = (screenWidth + tileSize - 1) / tileSize;
-        this->numTilesY = (screenHeight + tileSize - 1) / tileSize;
-        this->tileCount = numTilesX * numTilesY;
+        this->clusterTileSize = clusterTileSize;
+        this->sliceCount = sliceCount;
+        UpdateTileCount();
 
-        lightCompShader = Shader("shaders/lighting/lighting_tiled.comp");
+        // one work group per tile, at most 32x32 invocations
+        lightCompShader = Shader("shaders/lighting/lighting_tiled.comp", { "TILE_SIZE " + std::to_string(tileSize) });
+        clusterCountShader = Shader("shaders/lighting/cluster_assign.comp");
+        clusterScanShader = Shader("shaders/lighting/cluster_scan.comp");
+        clusterFillShader = Shader("shaders/lighting/cluster_assign.comp", { std::string("FILL_LISTS") });
 
-        lightSSBO = ShaderStorageBuffer(0, 1, sizeof(GPULight) * MAX_LIGHTS);
-        tileInfoSSBO = ShaderStorageBuffer(1, 1, sizeof(glm::uvec2) * tileCount);
-        lightIndexSSBO = ShaderStorageBuffer(2, 1, sizeof(GLuint) * tileCount * MAX_LIGHTS_PER_TILE);
+        // the rest is sized by the first culling
+        Reserve(lightSSBO, lightCapacity, sizeof(GPULight) * 1024, 0);
+        Reserve(visibleSSBO, visibleCapacity, sizeof(uint32_t) * 1024, 10);
+        ReserveShadowIndices();
+        Reserve(probeSSBO, probeCapacity, sizeof(glm::vec4) * 16, 13);
+        indexTotalSSBO = ShaderStorageBuffer(9, 1, sizeof(GLuint));
     }
 
-    void TileLighting(
-        SceneEntityRegistry& sceneRegistry,
-        LightManager& lightManager,
-        TransformManager& transformManager,
-        Camera& camera)
+    // the tiles follow the resolution of the lighting pass (the render scale), buffers grow on the next culling
+    void SetScreenSize(int width, int height)
     {
-        std::vector<GPULight> lights;
-        lights.reserve(MAX_LIGHTS);
+        if (width == screenWidth && height == screenHeight) return;
+        screenWidth = width;
+        screenHeight = height;
+        UpdateTileCount();
+    }
 
-        for (Entity entity : sceneRegistry.GetAll())
-        {
-            PointLightComponent* lightComp = lightManager.GetPointLightComponent(entity);
-            TransformComponent* transformComp = transformManager.GetComponent(entity);
-            if (!lightComp || !lightComp->enabled || !transformComp) continue;
+    // count synthetic lights scattered over the scene, 0 removes them. regenerated only when the count changes
+    void SetStressLights(int count)
+    {
+        if (count == stressLightCount) return;
+        stressLightCount = count;
+        table.RemoveUnowned();
 
-            GPULight light{ 
-                glm::vec4(transformComp->position, lightComp->radius),
-                glm::vec4(lightComp->color, lightComp->intensity) 
-            };
+        std::mt19937 gen(1337);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for (int i = 0; i < count; i++)
+        {
+            glm::vec3 position(-250.0f + unit(gen) * 500.0f, 1.0f + unit(gen) * 20.0f, -250.0f + unit(gen) * 500.0f);
+            glm::vec3 color(unit(gen), unit(gen), unit(gen));
+            GPULight light;
+            light.pos_radius = glm::vec4(position, 4.0f + unit(gen) * 8.0f);
+            light.color_intensity = glm::vec4(color / glm::max(color.r, glm::max(color.g, color.b)), 10.0f);
+            table.AddUnowned(light);
+        }
+    }
 
-            lights.push_back(light);
-            if (lights.size() >= MAX_LIGHTS) break;
+    // applies this frame's light, transform and registry changes to the light table and uploads what changed.
+    // runs every frame (also when nothing is shaded), the change sets are cleared at the end of the frame.
+    // edits of a point light component have to be marked on the light manager
+    void SyncLights(SceneEntityRegistry& sceneRegistry, LightManager& lightManager, TransformManager& transformManager)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (Entity entity : sceneRegistry.GetChanged()) UpdateLight(entity, sceneRegistry, lightManager, transformManager);
+        for (Entity entity : lightManager.GetChanged()) UpdateLight(entity, sceneRegistry, lightManager, transformManager);
+        for (Entity entity : transformManager.GetChanged())
+        {
+            if (lightManager.GetPointLightComponent(entity)) UpdateLight(entity, sceneRegistry, lightManager, transformManager);
         }
-        int lightCount = (int)lights.size();
-        lightSSBO.setData(0, sizeof(GPULight) * lightCount, lights.data());
+        timings.gatherMs = ElapsedMs(start);
 
-        std::vector<glm::uvec2> tileData(tileCount);
-        for (int t = 0; t < tileCount; ++t)
+        start = std::chrono::high_resolution_clock::now();
+        UploadLights();
+        timings.uploadMs = ElapsedMs(start);
+    }
+
+    void CullLights(
+        Camera& camera,
+        LightCulling culling,
+        GLuint depthTexture = 0) // this frame's depth for the tile depth bounds, 0 culls in 2D only
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        clustered = culling == LightCulling::Clustered;
+        cpuCulled = culling == LightCulling::TiledCPU;
+        UpdateTileCount();
+        UpdateVisibleLights(camera);
+        Reserve(probeListSSBO, probeListCapacity, sizeof(GLuint) * numTilesX * numTilesY * PROBE_LIST_STRIDE, 14);
+        UpdateProbeOrder(camera);
+        BindForShading();
+
+        if (clustered) ClusterCulling(camera);
+        else if (cpuCulled) CpuTileCulling(camera);
+        else TileCulling(camera, depthTexture);
+        BindForShading();
+        timings.cullingMs = ElapsedMs(start);
+    }
+
+    int getLightCount() const { return (int)table.Size(); }
+    int getVisibleLightCount() const { return visibleCount; }
+    int getUploadedLightCount() const { return uploadedLights; }
+    const LightSystemTimings& getTimings() const { return timings; }
+    int getIndexTotal() const
+    {
+        if (clustered) return indexTotal;
+        return cpuCulled ? (int)cpuLists.lightIndices.size() : numTilesX * numTilesY * MAX_LIGHTS_PER_TILE;
+    }
+    size_t getBufferBytes() const { return (size_t)(lightCapacity + indexCapacity + infoCapacity + countCapacity + visibleCapacity + shadowIndexCapacity + probeCapacity + probeListCapacity); }
+
+    // inputs of the tiled culling for the current camera, as the compute shader gets them
+    TileCullingInput GetTileCullingInput(Camera& camera, const float* depth = nullptr)
+    {
+        TileCullingInput input;
+        input.view = camera.getViewMatrix();
+        input.projection = camera.getProjectionMatrix(screenWidth, screenHeight, NEAR_PLANE, FAR_PLANE);
+        input.screenWidth = screenWidth;
+        input.screenHeight = screenHeight;
+        input.tileSize = tileSize;
+        input.maxLightsPerTile = MAX_LIGHTS_PER_TILE;
+        input.depth = depth;
+        return input;
+    }
+
+    // tiled lists of the frustum visible lights built on the cpu. depth is the window depth at the lighting
+    // resolution in texel order, null culls in 2D like the forward+ path
+    void BuildCpuTileLists(
+        Camera& camera,
+        const float* depth,
+        TileLightLists& lists,
+        int threads = 0,
+        CpuLightCuller::Path path = CpuLightCuller::Path::Auto)
+    {
+        UpdateVisibleLights(camera);
+        cpuCuller.CullTiles(GetTileCullingInput(camera, depth), table.Data(), visibleLights.data(), visibleCount, lists, threads, path);
+    }
+
+    // reads back the lists of the last tiled gpu culling, waits for the gpu. for validation only
+    void ReadTileLists(TileLightLists& lists)
+    {
+        lists.tilesX = numTilesX;
+        lists.tilesY = numTilesY;
+        lists.tileInfo.resize((size_t)numTilesX * numTilesY);
+        lists.lightIndices.resize(lists.tileInfo.size() * MAX_LIGHTS_PER_TILE);
+
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        tileInfoSSBO.bind();
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(glm::uvec2) * lists.tileInfo.size(), lists.tileInfo.data());
+        lightIndexSSBO.bind();
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint) * lists.lightIndices.size(), lists.lightIndices.data());
+    }
+
+    const LightTable& getTable() const { return table; }
+
+    // point lights sampling the shadow atlas with their record index (RenderSystem::GetShadowedPointLights), after
+    // SyncLights since slots move when lights are removed. only rewritten when a slot or record changed
+    void SetShadowedLights(const std::vector<std::pair<Entity, int>>& shadowed)
+    {
+        shadowSlots.clear();
+        for (const auto& entry : shadowed)
         {
-            tileData[t].x = t * MAX_LIGHTS_PER_TILE;
-            tileData[t].y = 0u;
+            int slot = table.SlotOf(entry.first);
+            if (slot >= 0) shadowSlots.emplace_back(slot, entry.second);
         }
-        tileInfoSSBO.setData(0, sizeof(glm::uvec2) * tileCount, tileData.data());
+        std::sort(shadowSlots.begin(), shadowSlots.end());
 
-        lightCompShader.use();
-        lightCompShader.setMat4("view", camera.getViewMatrix());
-        lightCompShader.setMat4("projection", camera.getProjectionMatrix(screenWidth, screenHeight, 0.1f, 2500.0f));
-        lightCompShader.setIVec2("screenSize", screenWidth, screenHeight);
-        lightCompShader.setIVec2("tileCount", numTilesX, numTilesY);
-        lightCompShader.setInt("tileSize", tileSize);
-        lightCompShader.setInt("lightCount", lightCount);
+        ReserveShadowIndices();
+        if (shadowSlots == uploadedShadowSlots) return;
 
-        glDispatchCompute(numTilesX, numTilesY, 1);
-        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        int32_t unshadowed = -1;
+        for (const auto& entry : uploadedShadowSlots)
+            shadowIndexSSBO.setData(sizeof(int32_t) * entry.first, sizeof(int32_t), &unshadowed);
+        for (const auto& entry : shadowSlots)
+        {
+            int32_t record = entry.second;
+            shadowIndexSSBO.setData(sizeof(int32_t) * entry.first, sizeof(int32_t), &record);
+        }
+        uploadedShadowSlots = shadowSlots;
+    }
+
+    // position and radius of the local environment probes (ProbeSystem::GetProbeBounds), culled with the
+    // lights from the next CullLights on. uploaded only when they changed
+    void SetProbes(const std::vector<glm::vec4>& bounds)
+    {
+        size_t count = std::min(bounds.size(), (size_t)MAX_LOCAL_PROBES);
+        if (probes.size() == count && std::equal(probes.begin(), probes.end(), bounds.begin())) return;
+        if (count < bounds.size())
+            std::cout << "ERROR::LIGHT_SYSTEM::TOO_MANY_PROBES " << bounds.size() << ", only the first " << MAX_LOCAL_PROBES << " are culled" << std::endl;
+        probes.assign(bounds.begin(), bounds.begin() + count);
+        Reserve(probeSSBO, probeCapacity, sizeof(glm::vec4) * std::max(probes.size(), (size_t)1), 13);
+        if (!probes.empty()) probeSSBO.setData(0, sizeof(glm::vec4) * probes.size(), probes.data());
     }
 
     void BindForShading() const
@@ -97,6 +564,26 @@ public:
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, lightSSBO.SSBO);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, tileInfoSSBO.SSBO);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, lightIndexSSBO.SSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, visibleSSBO.SSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, shadowIndexSSBO.SSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, probeSSBO.SSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, probeListSSBO.SSBO);
+    }
+
+    // cluster layout of the last culling, for the shading passes and the lighting tile classification
+    void ConfigureTileUniforms(Shader& shader)
+    {
+        shader.use();
+        shader.setInt("tileSize", clustered ? clusterTileSize : tileSize);
+        shader.setIVec2("screenSize", screenWidth, screenHeight);
+        shader.setIVec2("tileCount", numTilesX, numTilesY);
+        shader.setVec2("depthRange", glm::vec2(NEAR_PLANE, FAR_PLANE));
+
+        // slice = log(z / near) * slices / log(far / near)
+        int slices = clustered ? sliceCount : 1;
+        float scale = clustered ? (float)slices / logf(FAR_PLANE / NEAR_PLANE) : 0.0f;
+        shader.setInt("sliceCount", slices);
+        shader.setVec2("sliceParams", glm::vec2(scale, -logf(NEAR_PLANE) * scale));
     }
 
     void ConfigurePBRUniforms(
@@ -105,11 +592,7 @@ public:
         LightManager& lightManager,
         TransformManager& transformManager)
     {
-        pbrShader.use();
-        // BindForShading();
-        pbrShader.setInt("tileSize", tileSize);
-        pbrShader.setIVec2("screenSize", screenWidth, screenHeight);
-        pbrShader.setIVec2("tileCount", numTilesX, numTilesY);
+        ConfigureTileUniforms(pbrShader);
 
         auto dirLightCompEntity = lightManager.GetAnyDirectionalLight();
         if (!dirLightCompEntity) return;
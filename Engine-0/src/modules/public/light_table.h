@@ -0,0 +1,141 @@
+#pragma once
+#include "entity_manager.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// mirror struct from comp shader
+struct GPULight
+{
+	glm::vec4 pos_radius;
+	glm::vec4 color_intensity;
+};
+
+// NOTE: dense point light table, mirrored into the gpu light buffer. Lights are added, moved and removed by entity
+// (removal swaps the last light into the hole), and every written slot is recorded so only the dirty ranges are
+// uploaded. Centers and radii are also kept as separate arrays for the sse frustum culling. Lights without an owner
+// (the stress test lights) are not in the entity map and are only removed all at once.
+class LightTable
+{
+public:
+	static constexpr Entity NO_OWNER = std::numeric_limits<Entity>::max();
+
+	void Set(Entity owner, const GPULight& light)
+	{
+		auto it = slots.find(owner);
+		if (it != slots.end())
+		{
+			Write(it->second, light);
+			return;
+		}
+		slots[owner] = Append(owner, light);
+	}
+
+	void Remove(Entity owner)
+	{
+		auto it = slots.find(owner);
+		if (it == slots.end()) return;
+		uint32_t slot = it->second;
+		slots.erase(it);
+		RemoveSlot(slot);
+	}
+
+	void AddUnowned(const GPULight& light)
+	{
+		Append(NO_OWNER, light);
+	}
+
+	void RemoveUnowned()
+	{
+		// from the back, so the swapped in light has already been checked
+		for (size_t slot = lights.size(); slot-- > 0;)
+			if (owners[slot] == NO_OWNER) RemoveSlot((uint32_t)slot);
+	}
+
+	// sorted runs of slots written since the last call, runs closer than mergeGap slots are joined.
+	// ranges are [first, last). false when nothing was written or removed
+	bool TakeDirtyRanges(std::vector<std::pair<uint32_t, uint32_t>>& ranges, uint32_t mergeGap = 16)
+	{
+		bool changed = !dirty.empty() || shrunk;
+		shrunk = false;
+		ranges.clear();
+		std::sort(dirty.begin(), dirty.end());
+		for (uint32_t slot : dirty)
+		{
+			if (slot >= lights.size()) continue; // removed from the end afterwards
+			if (!ranges.empty() && slot <= ranges.back().second + mergeGap)
+				ranges.back().second = std::max(ranges.back().second, slot + 1);
+			else
+				ranges.emplace_back(slot, slot + 1);
+		}
+		dirty.clear();
+		return changed;
+	}
+
+	// slot of the entity's light, -1 when it has none
+	int SlotOf(Entity owner) const
+	{
+		auto it = slots.find(owner);
+		return it != slots.end() ? (int)it->second : -1;
+	}
+
+	size_t Size() const { return lights.size(); }
+	const GPULight* Data() const { return lights.data(); }
+
+	// readable up to Size() rounded up to 4
+	const float* CentersX() const { return centerX.data(); }
+	const float* CentersY() const { return centerY.data(); }
+	const float* CentersZ() const { return centerZ.data(); }
+	const float* Radii() const { return radius.data(); }
+
+private:
+	std::vector<GPULight> lights;
+	std::vector<Entity> owners;
+	std::unordered_map<Entity, uint32_t> slots;
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<uint32_t> dirty;
+	bool shrunk = false;    // lights were removed, the visible set has to be rebuilt even without dirty slots
+
+	uint32_t Append(Entity owner, const GPULight& light)
+	{
+		uint32_t slot = (uint32_t)lights.size();
+		lights.push_back(light);
+		owners.push_back(owner);
+		size_t padded = (lights.size() + 3) & ~(size_t)3;
+		centerX.resize(padded, 0.0f);
+		centerY.resize(padded, 0.0f);
+		centerZ.resize(padded, 0.0f);
+		radius.resize(padded, 0.0f);
+		Write(slot, light);
+		return slot;
+	}
+
+	void Write(uint32_t slot, const GPULight& light)
+	{
+		lights[slot] = light;
+		centerX[slot] = light.pos_radius.x;
+		centerY[slot] = light.pos_radius.y;
+		centerZ[slot] = light.pos_radius.z;
+		radius[slot] = light.pos_radius.w;
+		dirty.push_back(slot);
+	}
+
+	void RemoveSlot(uint32_t slot)
+	{
+		uint32_t last = (uint32_t)lights.size() - 1;
+		if (slot != last)
+		{
+			Entity moved = owners[last];
+			owners[slot] = moved;
+			if (moved != NO_OWNER) slots[moved] = slot;
+			Write(slot, lights[last]);
+		}
+		lights.pop_back();
+		owners.pop_back();
+		shrunk = true;
+	}
+};
\ No newline at end of file
@@ -17,17 +17,35 @@ struct Vertex {
 	glm::vec3 Bitangent;
 };
 
+// a level of detail is a range of the element buffer, all levels share the vertex buffer
+struct MeshLOD
+{
+	unsigned int firstIndex = 0;
+	unsigned int indexCount = 0;
+	float error = 0.0f; // simplification error relative to the mesh radius
+};
+
 class Mesh {
 public:
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
 
 	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices = {});
-	void Draw(Shader& shader);
+	void Draw(Shader& shader, int lod = 0);
+
+	// appends simplified index lists after the base indices. lods[0] is always the full mesh
+	void SetLODs(const std::vector<std::vector<unsigned int>>& lodIndices, const std::vector<float>& lodErrors);
 
 	const std::vector<unsigned int>& getIndices() const { return indices; }
+	const std::vector<MeshLOD>& getLODs() const { return lods; }
+	int getLODCount() const { return lods.empty() ? 1 : (int)lods.size(); }
+	unsigned int getTriangleCount(int lod = 0) const;
 	unsigned int getVAO() const { return VAO; }
+	// raw buffers, also bound as storage buffers by the visibility buffer resolve
+	unsigned int getVBO() const { return VBO; }
+	unsigned int getEBO() const { return EBO; }
 private:
 	unsigned int VAO, VBO, EBO;
+	std::vector<MeshLOD> lods;
 	void setupMesh();
 };
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+// NOTE: Quadric error metric (Garland-Heckbert) simplifier used to build asset LODs on import.
+// Every collapse merges a vertex into one of its neighbours (half-edge collapse), so a LOD is only
+// a new index list over the original vertex buffer and the GPU vertex data is shared by all levels.
+// Vertices that share a position with another vertex (UV/normal seams) or sit on an open border
+// are locked, which keeps seams and silhouettes of open meshes intact.
+
+struct MeshLODSettings
+{
+	int maxLODs = 4;				// including the full detail level
+	float reduction = 0.5f;			// index count ratio between two consecutive levels
+	float minReduction = 0.85f;		// stop when a level cannot get below this ratio of its parent
+	float attributeWeight = 0.5f;	// uv and normal penalty, scaled by the mesh radius
+};
+
+struct SimplifyResult
+{
+	std::vector<unsigned int> indices;
+	float error = 0.0f; // largest collapse error relative to the mesh radius
+};
+
+class MeshSimplifier
+{
+public:
+	static SimplifyResult Simplify(
+		const std::vector<Vertex>& vertices,
+		const std::vector<unsigned int>& indices,
+		size_t targetIndexCount,
+		float attributeWeight = 0.5f);
+
+	// builds the LOD chain (excluding the base level), each level simplified from the previous one
+	static std::vector<SimplifyResult> BuildLODChain(
+		const std::vector<Vertex>& vertices,
+		const std::vector<unsigned int>& indices,
+		const MeshLODSettings& settings = MeshLODSettings());
+};
\ No newline at end of file
@@ -8,14 +8,16 @@
 #include "shader.h"
 #include "mesh.h"
 #include "mesh_data.h"
+#include "mesh_simplifier.h"
 #include "utils.h"
 #include "texture_library.h"
 #include "texture_metadata.h"
 
 class Model {
 public:
-	Model(const char* path) {
+	Model(const char* path, bool generateLODs = true, const MeshLODSettings& lodSettings = MeshLODSettings()) {
 		loadModel(path);
+		if (generateLODs) buildLODs(path, lodSettings);
 	}
 
 	const std::vector<MeshData>& getMeshData() const
@@ -28,6 +30,7 @@ private:
 	std::string directory;
 
 	void loadModel(std::string path);
+	void buildLODs(const std::string& path, const MeshLODSettings& settings);
 	void processNode(aiNode* node, const aiScene* scene);
 	MeshData processMeshData(aiMesh* mesh, const aiScene* scene);
 	unsigned int TextureFromFile(const char* path, const std::string& directory, int& width, int& height, TextureColorSpace space = TextureColorSpace::Linear);
@@ -0,0 +1,313 @@
+#pragma once
+#include "entity_manager.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+static constexpr int POINT_SHADOW_ATLAS_SIZE = 4096;
+static constexpr int POINT_SHADOW_TIERS = 3;			// 512, 256 and 128 texel faces
+static constexpr int POINT_SHADOW_GUARD = 2;			// texels around every face, keeps the pcf taps inside it
+
+// mirror struct of PointShadow in pbr_lighting.glsl
+struct GPUPointShadow
+{
+	glm::vec4 faceRects[6];		// atlas uv origin, uv size, projection scale (the face minus its guard band)
+	glm::vec4 faceOrigins[6];	// light position the face was rendered from, radius
+};
+
+// NOTE: cube shadow maps of the shadowed point lights, packed face by face into one depth atlas. The atlas is split
+// into a fixed pool of square tiles per resolution tier (32 x 512, 64 x 256 and 256 x 128), a light takes 6 tiles
+// of the tier its camera distance asks for, falling back to coarser tiers when a pool is empty. Every frame the most
+// important candidates keep (or get) tiles, and at most faceBudget faces are rendered: faces that were never
+// rendered first, then moved tiers and invalidated faces, then the faces of dynamic lights (lights that move or
+// see dynamic casters) round robin, weighted by importance. Static lights are rendered once. Each face keeps the
+// tile and light position it was last rendered with, so a light keeps sampling its old faces while new ones are
+// pending, and a light is only shadowed once all 6 faces exist.
+class PointShadowAtlas
+{
+public:
+	struct Candidate
+	{
+		Entity entity;
+		glm::vec3 position;
+		float radius;
+		float importance;		// larger is kept first, <= 0 is never shadowed
+		float distance;			// camera to the light sphere, picks the tier
+		bool dynamic;
+	};
+
+	struct FaceJob
+	{
+		Entity entity;
+		int face;				// +x, -x, +y, -y, +z, -z
+		glm::ivec3 tile;		// atlas texel origin and size
+		glm::vec3 position;
+		float radius;
+	};
+
+	PointShadowAtlas()
+	{
+		// tier 0 on the top half, tiers 1 and 2 on the bottom quarters
+		AddPool(0, glm::ivec2(0, 0), glm::ivec2(POINT_SHADOW_ATLAS_SIZE, POINT_SHADOW_ATLAS_SIZE / 2));
+		AddPool(1, glm::ivec2(0, POINT_SHADOW_ATLAS_SIZE / 2), glm::ivec2(POINT_SHADOW_ATLAS_SIZE / 2));
+		AddPool(2, glm::ivec2(POINT_SHADOW_ATLAS_SIZE / 2), glm::ivec2(POINT_SHADOW_ATLAS_SIZE / 2));
+	}
+
+	static int FaceSize(int tier) { return 512 >> tier; }
+
+	// keeps tiles for the maxLights most important candidates and fills jobs with this frame's faces.
+	// tierDistance is the camera distance where the face resolution halves
+	void Update(std::vector<Candidate>& candidates, int maxLights, float tierDistance, int faceBudget, std::vector<FaceJob>& jobs)
+	{
+		frame++;
+		jobs.clear();
+
+		std::sort(candidates.begin(), candidates.end(),
+			[](const Candidate& a, const Candidate& b) { return a.importance > b.importance; });
+		size_t kept = 0;
+		while (kept < candidates.size() && (int)kept < maxLights && candidates[kept].importance > 0.0f) kept++;
+
+		// lights that dropped out give their tiles back first
+		std::unordered_set<Entity> selected;
+		for (size_t i = 0; i < kept; i++) selected.insert(candidates[i].entity);
+		for (auto it = lights.begin(); it != lights.end();)
+		{
+			if (selected.count(it->first))
+			{
+				++it;
+				continue;
+			}
+			for (Face& face : it->second.faces)
+			{
+				Release(face.tile);
+				Release(face.pendingTile);
+			}
+			it = lights.erase(it);
+		}
+
+		for (size_t i = 0; i < kept; i++)
+		{
+			const Candidate& c = candidates[i];
+			auto it = lights.find(c.entity);
+			if (it == lights.end())
+			{
+				int tier = Allocate(TierFor(c.distance, tierDistance), nullptr);
+				if (tier < 0) continue; // every pool is full
+				it = lights.emplace(c.entity, ShadowedLight()).first;
+				Allocate(tier, &it->second);
+			}
+			ShadowedLight& light = it->second;
+
+			// a static light that was edited is rendered again, dynamic ones are refreshed round robin anyway. a light
+			// that just stopped being dynamic is rendered once more too, its faces are from different frames
+			bool settled = light.dynamic && !c.dynamic;
+			if (!c.dynamic && (settled || light.position != c.position || light.radius != c.radius))
+				for (Face& face : light.faces) face.dirty = true;
+			light.position = c.position;
+			light.radius = c.radius;
+			light.importance = c.importance;
+			light.dynamic = c.dynamic;
+
+			// tier changes need the new tiles free, with 10% hysteresis so lights do not flip at the boundary
+			int nearTier = TierFor(c.distance * 0.9f, tierDistance);
+			int farTier = TierFor(c.distance * 1.1f, tierDistance);
+			bool pending = false;
+			for (const Face& face : light.faces) pending |= face.pendingTile >= 0;
+			if (!pending && (light.tier < nearTier || light.tier > farTier))
+			{
+				int tier = Allocate(TierFor(c.distance, tierDistance), nullptr);
+				if (tier >= 0 && tier != light.tier) Allocate(tier, &light);
+			}
+		}
+
+		Schedule(faceBudget, jobs);
+	}
+
+	// the job's face now holds a shadow, an old tile it replaces goes back to its pool
+	void MarkRendered(const FaceJob& job)
+	{
+		auto it = lights.find(job.entity);
+		if (it == lights.end()) return;
+		Face& face = it->second.faces[job.face];
+		if (face.pendingTile >= 0)
+		{
+			Release(face.tile);
+			face.tile = face.pendingTile;
+			face.pendingTile = -1;
+		}
+		face.origin = glm::vec4(job.position, job.radius);
+		face.rendered = true;
+		face.dirty = false;
+		face.updatedFrame = frame;
+	}
+
+	// a static caster changed, every face is rendered again over the next frames (still sampled until then)
+	void InvalidateAll()
+	{
+		for (auto& entry : lights)
+			for (Face& face : entry.second.faces) face.dirty = true;
+	}
+
+	// lights with all 6 faces rendered, with the index of their record
+	void GetShadowedLights(std::vector<std::pair<Entity, int>>& shadowed, std::vector<GPUPointShadow>& records) const
+	{
+		shadowed.clear();
+		records.clear();
+		for (const auto& entry : lights)
+		{
+			const ShadowedLight& light = entry.second;
+			bool complete = true;
+			for (const Face& face : light.faces) complete &= face.rendered;
+			if (!complete) continue;
+
+			GPUPointShadow record;
+			for (int f = 0; f < 6; f++)
+			{
+				glm::ivec3 tile = TileRect(light.faces[f].tile);
+				float scale = (float)(tile.z - 2 * POINT_SHADOW_GUARD) / (float)tile.z;
+				record.faceRects[f] = glm::vec4(glm::vec3(tile) / (float)POINT_SHADOW_ATLAS_SIZE, scale);
+				record.faceOrigins[f] = light.faces[f].origin;
+			}
+			shadowed.emplace_back(entry.first, (int)records.size());
+			records.push_back(record);
+		}
+	}
+
+	int getLightCount() const { return (int)lights.size(); }
+	int getPendingFaces() const { return pendingFaces; }
+
+private:
+	struct Face
+	{
+		int tile = -1;			// sampled tile
+		int pendingTile = -1;	// tile of a new tier, replaces tile once rendered
+		glm::vec4 origin = glm::vec4(0.0f);
+		bool rendered = false;	// tile holds a shadow
+		bool dirty = false;
+		int updatedFrame = 0;
+	};
+
+	struct ShadowedLight
+	{
+		Face faces[6];
+		glm::vec3 position = glm::vec3(0.0f);
+		float radius = 0.0f;
+		float importance = 0.0f;
+		int tier = -1;
+		bool dynamic = false;	// as of the last update
+	};
+
+	struct Tile
+	{
+		glm::ivec2 origin;
+		int tier;
+	};
+
+	std::vector<Tile> tiles;
+	std::vector<int> freeTiles[POINT_SHADOW_TIERS];
+	std::unordered_map<Entity, ShadowedLight> lights;
+	int frame = 0;
+	int pendingFaces = 0;	// left over by the last budget
+
+	void AddPool(int tier, glm::ivec2 origin, glm::ivec2 size)
+	{
+		int faceSize = FaceSize(tier);
+		for (int y = 0; y + faceSize <= size.y; y += faceSize)
+		{
+			for (int x = 0; x + faceSize <= size.x; x += faceSize)
+			{
+				freeTiles[tier].push_back((int)tiles.size());
+				tiles.push_back({ origin + glm::ivec2(x, y), tier });
+			}
+		}
+		// handed out from the back, keep the first tiles first
+		std::reverse(freeTiles[tier].begin(), freeTiles[tier].end());
+	}
+
+	glm::ivec3 TileRect(int tile) const
+	{
+		return glm::ivec3(tiles[tile].origin, FaceSize(tiles[tile].tier));
+	}
+
+	static int TierFor(float distance, float tierDistance)
+	{
+		if (distance < tierDistance) return 0;
+		return distance < tierDistance * 2.0f ? 1 : 2;
+	}
+
+	void Release(int& tile)
+	{
+		if (tile < 0) return;
+		freeTiles[tiles[tile].tier].push_back(tile);
+		tile = -1;
+	}
+
+	// first tier at or below the wanted one with 6 free tiles, -1 when none. with a light, its faces get the tiles
+	// (as pending tiles when they already have one)
+	int Allocate(int wantedTier, ShadowedLight* light)
+	{
+		for (int tier = wantedTier; tier < POINT_SHADOW_TIERS; tier++)
+		{
+			if (freeTiles[tier].size() < 6) continue;
+			if (!light) return tier;
+
+			for (Face& face : light->faces)
+			{
+				int tile = freeTiles[tier].back();
+				freeTiles[tier].pop_back();
+				if (face.tile < 0) face.tile = tile;
+				else face.pendingTile = tile;
+			}
+			light->tier = tier;
+			return tier;
+		}
+		return -1;
+	}
+
+	void Schedule(int faceBudget, std::vector<FaceJob>& jobs)
+	{
+		struct Request
+		{
+			int level;		// 3 never rendered, 2 new tier, 1 dirty, 0 round robin
+			float score;
+			Entity entity;
+			int face;
+		};
+		std::vector<Request> requests;
+		for (const auto& entry : lights)
+		{
+			const ShadowedLight& light = entry.second;
+			for (int f = 0; f < 6; f++)
+			{
+				const Face& face = light.faces[f];
+				if (!face.rendered) requests.push_back({ 3, light.importance, entry.first, f });
+				else if (face.pendingTile >= 0) requests.push_back({ 2, light.importance, entry.first, f });
+				else if (face.dirty) requests.push_back({ 1, light.importance, entry.first, f });
+				else if (light.dynamic) requests.push_back({ 0, light.importance * (float)(frame - face.updatedFrame), entry.first, f });
+			}
+		}
+
+		size_t count = std::min(requests.size(), (size_t)std::max(faceBudget, 0));
+		std::partial_sort(requests.begin(), requests.begin() + count, requests.end(),
+			[](const Request& a, const Request& b) { return a.level != b.level ? a.level > b.level : a.score > b.score; });
+
+		pendingFaces = 0;
+		for (size_t i = count; i < requests.size(); i++) pendingFaces += requests[i].level > 0 ? 1 : 0;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const ShadowedLight& light = lights[requests[i].entity];
+			const Face& face = light.faces[requests[i].face];
+			FaceJob job;
+			job.entity = requests[i].entity;
+			job.face = requests[i].face;
+			job.tile = TileRect(face.pendingTile >= 0 ? face.pendingTile : face.tile);
+			job.position = light.position;
+			job.radius = light.radius;
+			jobs.push_back(job);
+		}
+	}
+};
\ No newline at end of file
@@ -0,0 +1,275 @@
+#pragma once
+#include "entity_manager.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// NOTE: uniform grid over the local environment probe spheres. A probe is listed in every cell its sphere's box
+// touches, so point queries read a single cell. Probes wider than MAX_CELL_SPAN cells (or with an infinite radius)
+// are kept in a separate list that every query walks, so a probe is linked into at most (MAX_CELL_SPAN + 1)^3
+// cells. Probes are set and removed by entity and only the cells they leave or enter are touched. Queries stamp
+// the probes they visit, so a probe listed in several cells is reported once.
+class ProbeGrid
+{
+public:
+	static constexpr int MAX_CELL_SPAN = 8;
+
+	explicit ProbeGrid(float cellSize = 16.0f) : cellSize(cellSize) {}
+
+	void Set(Entity entity, const glm::vec3& position, float radius)
+	{
+		glm::ivec3 cellMin(0), cellMax(0);
+		bool unbounded = !CellRange(position, radius, cellMin, cellMax);
+
+		auto it = probes.find(entity);
+		if (it != probes.end())
+		{
+			Probe& probe = it->second;
+			if (probe.position == position && probe.radius == radius) return;
+			version++;
+
+			// same cells, only the sphere moved inside them
+			if (probe.unbounded == unbounded && (unbounded || (probe.cellMin == cellMin && probe.cellMax == cellMax)))
+			{
+				probe.position = position;
+				probe.radius = radius;
+				return;
+			}
+			Unlink(entity, probe);
+		}
+		else version++;
+
+		Probe& probe = probes[entity];
+		probe.position = position;
+		probe.radius = radius;
+		probe.cellMin = cellMin;
+		probe.cellMax = cellMax;
+		probe.unbounded = unbounded;
+		Link(entity, probe);
+	}
+
+	void Remove(Entity entity)
+	{
+		auto it = probes.find(entity);
+		if (it == probes.end()) return;
+		Unlink(entity, it->second);
+		probes.erase(it);
+		version++;
+	}
+
+	void Clear()
+	{
+		probes.clear();
+		cells.clear();
+		unboundedProbes.clear();
+		version++;
+	}
+
+	// probes whose sphere contains point
+	void QueryPoint(const glm::vec3& point, std::vector<Entity>& result)
+	{
+		result.clear();
+		stamp++;
+		auto cell = cells.find(Key(CellOf(point)));
+		if (cell != cells.end())
+			for (Entity entity : cell->second) TestPoint(entity, point, result);
+		for (Entity entity : unboundedProbes) TestPoint(entity, point, result);
+	}
+
+	// probes whose sphere overlaps the box
+	void QueryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<Entity>& result)
+	{
+		result.clear();
+		stamp++;
+		glm::ivec3 cellMin = CellOf(boxMin);
+		glm::ivec3 cellMax = CellOf(boxMax);
+		glm::dvec3 span = glm::dvec3(cellMax - cellMin) + 1.0;
+
+		// large boxes walk the occupied cells instead of the empty ones
+		if (span.x * span.y * span.z > (double)cells.size())
+		{
+			for (auto& cell : cells)
+				for (Entity entity : cell.second) TestBox(entity, boxMin, boxMax, result);
+		}
+		else
+		{
+			for (int z = cellMin.z; z <= cellMax.z; z++)
+				for (int y = cellMin.y; y <= cellMax.y; y++)
+					for (int x = cellMin.x; x <= cellMax.x; x++)
+					{
+						auto cell = cells.find(Key(glm::ivec3(x, y, z)));
+						if (cell == cells.end()) continue;
+						for (Entity entity : cell->second) TestBox(entity, boxMin, boxMax, result);
+					}
+		}
+		for (Entity entity : unboundedProbes) TestBox(entity, boxMin, boxMax, result);
+	}
+
+	// up to k probes closest to point, by the distance to their sphere (0 inside it), nearest first. Cells are
+	// visited in shells around the point's cell until the next shell cannot hold anything closer than the k-th probe
+	void Nearest(const glm::vec3& point, int k, std::vector<Entity>& result)
+	{
+		result.clear();
+		if (k <= 0) return;
+		stamp++;
+		candidates.clear();
+		for (Entity entity : unboundedProbes) Consider(entity, point);
+
+		glm::ivec3 center = CellOf(point);
+		for (int s = 0;; s++)
+		{
+			// nothing in shell s is closer than (s - 1) cells
+			if ((int)candidates.size() >= k)
+			{
+				std::nth_element(candidates.begin(), candidates.begin() + (k - 1), candidates.end());
+				if ((float)(s - 1) * cellSize > candidates[k - 1].first) break;
+			}
+
+			// once a shell has more cells than are occupied, the rest is faster to take in one pass
+			double shellCells = s == 0 ? 1.0 : std::pow(2.0 * s + 1.0, 3.0) - std::pow(2.0 * s - 1.0, 3.0);
+			if (shellCells > (double)cells.size())
+			{
+				for (auto& cell : cells)
+					for (Entity entity : cell.second) Consider(entity, point);
+				break;
+			}
+
+			for (int z = -s; z <= s; z++)
+				for (int y = -s; y <= s; y++)
+				{
+					// inner rows only have their two ends on the shell
+					bool face = std::abs(z) == s || std::abs(y) == s;
+					for (int x = -s; x <= s; x += face || s == 0 ? 1 : 2 * s)
+					{
+						auto cell = cells.find(Key(center + glm::ivec3(x, y, z)));
+						if (cell == cells.end()) continue;
+						for (Entity entity : cell->second) Consider(entity, point);
+					}
+				}
+		}
+
+		size_t count = std::min(candidates.size(), (size_t)k);
+		std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+		for (size_t i = 0; i < count; i++) result.push_back(candidates[i].second);
+	}
+
+	glm::ivec3 CellOf(const glm::vec3& point) const
+	{
+		return glm::ivec3(glm::floor(point / cellSize));
+	}
+
+	bool Contains(Entity entity) const { return probes.find(entity) != probes.end(); }
+	int getProbeCount() const { return (int)probes.size(); }
+	int getCellCount() const { return (int)cells.size(); }
+	// bumped by every change, for callers caching query results
+	uint32_t getVersion() const { return version; }
+
+private:
+	struct Probe
+	{
+		glm::vec3 position = glm::vec3(0.0f);
+		float radius = 0.0f;
+		glm::ivec3 cellMin = glm::ivec3(0), cellMax = glm::ivec3(0);
+		bool unbounded = false;
+		uint32_t stamp = 0;
+	};
+
+	float cellSize;
+	std::unordered_map<Entity, Probe> probes;
+	std::unordered_map<uint64_t, std::vector<Entity>> cells;
+	std::vector<Entity> unboundedProbes;
+	std::vector<std::pair<float, Entity>> candidates;
+	uint32_t version = 0;
+	uint32_t stamp = 0;
+
+	// 21 bits per axis
+	static uint64_t Key(const glm::ivec3& cell)
+	{
+		return ((uint64_t)(cell.x & 0x1FFFFF) << 42) | ((uint64_t)(cell.y & 0x1FFFFF) << 21) | (uint64_t)(cell.z & 0x1FFFFF);
+	}
+
+	// false when the sphere is too large to be listed per cell
+	bool CellRange(const glm::vec3& position, float radius, glm::ivec3& cellMin, glm::ivec3& cellMax) const
+	{
+		if (!std::isfinite(radius) || 2.0f * radius > cellSize * MAX_CELL_SPAN) return false;
+		cellMin = CellOf(position - glm::vec3(radius));
+		cellMax = CellOf(position + glm::vec3(radius));
+		return true;
+	}
+
+	void Link(Entity entity, const Probe& probe)
+	{
+		if (probe.unbounded)
+		{
+			unboundedProbes.push_back(entity);
+			return;
+		}
+		for (int z = probe.cellMin.z; z <= probe.cellMax.z; z++)
+			for (int y = probe.cellMin.y; y <= probe.cellMax.y; y++)
+				for (int x = probe.cellMin.x; x <= probe.cellMax.x; x++)
+					cells[Key(glm::ivec3(x, y, z))].push_back(entity);
+	}
+
+	void Unlink(Entity entity, const Probe& probe)
+	{
+		if (probe.unbounded)
+		{
+			EraseFrom(unboundedProbes, entity);
+			return;
+		}
+		for (int z = probe.cellMin.z; z <= probe.cellMax.z; z++)
+			for (int y = probe.cellMin.y; y <= probe.cellMax.y; y++)
+				for (int x = probe.cellMin.x; x <= probe.cellMax.x; x++)
+				{
+					auto cell = cells.find(Key(glm::ivec3(x, y, z)));
+					if (cell == cells.end()) continue;
+					EraseFrom(cell->second, entity);
+					if (cell->second.empty()) cells.erase(cell);
+				}
+	}
+
+	static void EraseFrom(std::vector<Entity>& list, Entity entity)
+	{
+		auto it = std::find(list.begin(), list.end(), entity);
+		if (it == list.end()) return;
+		*it = list.back();
+		list.pop_back();
+	}
+
+	// true the first time a query reaches the probe
+	Probe* Visit(Entity entity)
+	{
+		Probe& probe = probes[entity];
+		if (probe.stamp == stamp) return nullptr;
+		probe.stamp = stamp;
+		return &probe;
+	}
+
+	void TestPoint(Entity entity, const glm::vec3& point, std::vector<Entity>& result)
+	{
+		Probe* probe = Visit(entity);
+		if (!probe) return;
+		glm::vec3 delta = point - probe->position;
+		if (glm::dot(delta, delta) <= probe->radius * probe->radius) result.push_back(entity);
+	}
+
+	void TestBox(Entity entity, const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<Entity>& result)
+	{
+		Probe* probe = Visit(entity);
+		if (!probe) return;
+		glm::vec3 delta = glm::clamp(probe->position, boxMin, boxMax) - probe->position;
+		if (glm::dot(delta, delta) <= probe->radius * probe->radius) result.push_back(entity);
+	}
+
+	void Consider(Entity entity, const glm::vec3& point)
+	{
+		Probe* probe = Visit(entity);
+		if (!probe) return;
+		float distance = std::max(glm::length(point - probe->position) - probe->radius, 0.0f);
+		candidates.emplace_back(distance, entity);
+	}
+};
\ No newline at end of file
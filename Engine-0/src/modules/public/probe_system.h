@@ -1,14 +1,129 @@
 #pragma once
 #include "component_manager.h"
 #include "camera.h"
+#include "probe_grid.h"
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
-constexpr int MAX_ACTIVE_PROBES = 8;
-constexpr Entity INVALID_ENTITY = INT16_MAX;
+// layout of the probe cubemap array, probes built at other sizes are scaled into it
+static constexpr int PROBE_PREFILTER_SIZE = 128;
+static constexpr int PROBE_PREFILTER_MIPS = 5;		// sampled up to roughness * 4 in pbr_lighting.glsl
+static constexpr int MAX_RESIDENT_PROBES = 32;		// local probes with a layer, the nearest to the camera
 
+// what the shading passes bind for the ibl
+struct ProbeTextures
+{
+	GLuint prefilter = 0;		// cubemap array, layer 0 is the sky, local probe i is layer i + 1
+	GLuint irradianceSH = 0;	// buffer of 9 sh coefficients per layer, same order
+	GLuint brdfLUT = 0;			// shared by every probe
+	bool hasSky = false;
+	int localProbes = 0;		// layers in use after the sky, free ones have a negative radius in the bounds
+};
+
+// NOTE: the prefiltered maps of the probes are copied into a cubemap array and their irradiance sh into one
+// buffer, so the shading passes bind the same 2 textures and 1 buffer however many probes there are. Local probes
+// live in a uniform grid kept up to date from the change sets (SyncProbes), and the MAX_RESIDENT_PROBES nearest to
+// the camera hold a layer. The nearest query is cached per system and only runs again when the camera enters
+// another grid cell or a probe changes. A probe keeps its layer while it stays resident and a layer is only copied
+// when it gets a new probe or its probe was rebuilt. The resident bounds go to the light system, which culls them
+// into per tile lists in the same pass as the lights (see LightSystem::SetProbes).
 class ProbeSystem
 {
 private:
-	std::vector<Entity> cachedActiveProbes;
+	static constexpr Entity NO_PROBE = std::numeric_limits<Entity>::max();
+
+	GLuint prefilterArray = 0;
+	GLuint shBuffer = 0;
+	GLuint copyFBO = 0;
+	GLuint placeholderTexture = 0;		// brdf lut stand in while no probe is built
+
+	ProbeGrid grid;
+	std::vector<Entity> residentProbes;		// nearest first
+	glm::ivec3 queryCell = glm::ivec3(0);
+	uint32_t queryVersion = 0;
+	bool queried = false;
+
+	std::vector<Entity> layerOwners = std::vector<Entity>(MAX_RESIDENT_PROBES, NO_PROBE);	// layer i + 1
+	std::vector<GLuint> layerMaps;		// prefiltered map each layer was copied from, the sky first
+	std::unordered_set<Entity> rebuiltProbes;			// copied again even when the texture names were reused
+	std::vector<glm::vec4> probeBounds;		// position, radius of the local probes in layer order
+	ProbeTextures textures;
+
+	void AllocateArrays(int layers)
+	{
+		glGenTextures(1, &prefilterArray);
+		glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, prefilterArray);
+		glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, PROBE_PREFILTER_MIPS, GL_R11F_G11F_B10F, PROBE_PREFILTER_SIZE, PROBE_PREFILTER_SIZE, layers * 6);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAX_LEVEL, PROBE_PREFILTER_MIPS - 1);
+		glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+
+		glGenBuffers(1, &shBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, shBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::vec4) * 9 * layers, nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	// blits every face and level of a cubemap into one layer of an array, scaled when the sizes differ.
+	// levels past sourceMips repeat the source's last level
+	void CopyCubemap(GLuint source, int sourceMips, GLuint target, int layer, int size, int mips)
+	{
+		glBindTexture(GL_TEXTURE_CUBE_MAP, source);
+		for (int mip = 0; mip < mips; mip++)
+		{
+			int sourceMip = std::min(mip, sourceMips - 1);
+			GLint sourceSize = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, sourceMip, GL_TEXTURE_WIDTH, &sourceSize);
+			int targetSize = std::max(size >> mip, 1);
+			for (int face = 0; face < 6; face++)
+			{
+				glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, source, sourceMip);
+				glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target, mip, layer * 6 + face);
+				glBlitFramebuffer(0, 0, sourceSize, sourceSize, 0, 0, targetSize, targetSize, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+			}
+		}
+		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	}
+
+	// the probe's maps into a layer, unless they are already there
+	void CopyLayer(EnvironmentProbeComponent* probe, Entity entity, int layer)
+	{
+		GLuint prefilterMap = probe ? probe->maps.prefilterMap : 0;
+		if (!prefilterMap) return; // not built yet
+		if (layerMaps[layer] == prefilterMap && !rebuiltProbes.count(entity)) return;
+		layerMaps[layer] = prefilterMap;
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, shBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::vec4) * 9 * layer, sizeof(probe->maps.irradianceSH), probe->maps.irradianceSH);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		if (!copyFBO) glGenFramebuffers(1, &copyFBO);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, copyFBO);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, copyFBO);
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		glDrawBuffer(GL_COLOR_ATTACHMENT0);
+
+		int prefilterMips = std::max((int)probe->settings.maxMipLevels, 1);
+		CopyCubemap(probe->maps.prefilterMap, prefilterMips, prefilterArray, layer, PROBE_PREFILTER_SIZE, PROBE_PREFILTER_MIPS);
+
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void UpdateProbe(Entity entity, SceneEntityRegistry& sceneRegistry, EnvironmentProbeManager& probeManager)
+	{
+		EnvironmentProbeComponent* probe = probeManager.GetProbeComponent(entity);
+		if (probe && sceneRegistry.Contains(entity)) grid.Set(entity, probe->position, probe->radius);
+		else grid.Remove(entity);
+	}
 
 public:
 	void RebuildProbes(
@@ -17,70 +132,102 @@ public:
 	{
 		for (Entity entity : sceneRegistry.GetAll())
 		{
-			auto* probeComp = probeManager.skyProbeComponent->first == entity ? 
+			auto* probeComp = probeManager.skyProbeComponent->first == entity ?
 				probeManager.GetSkyProbe() : probeManager.GetProbeComponent(entity);
 
 			if (!probeComp || !probeComp->buildProbe) continue;
 
 			// destroy current maps
-			if (probeComp->maps.envMap)
+			if (probeComp->maps.prefilterMap)
 			{
 				IBLGenerator::Destroy(probeComp->maps);
 				probeComp->maps = {};
 			}
 
-			// build new IBL maps
-			probeComp->maps = IBLGenerator::Build(probeComp->settings);
+			// build new IBL maps, only the sky keeps its environment map (for the skybox)
+			probeComp->maps = IBLGenerator::Build(probeComp->settings, probeComp == probeManager.GetSkyProbe());
 			probeComp->buildProbe = false;
+			rebuiltProbes.insert(entity);
 		}
 	}
 
-	std::vector<Entity> GetActiveProbes(
-		SceneEntityRegistry& sceneRegistry,
+	// applies this frame's registry and probe changes to the grid. runs every frame, the change sets are cleared at
+	// the end of the frame. edits of a probe's position or radius have to be marked on the probe manager
+	void SyncProbes(SceneEntityRegistry& sceneRegistry, EnvironmentProbeManager& probeManager)
+	{
+		for (Entity entity : sceneRegistry.GetChanged()) UpdateProbe(entity, sceneRegistry, probeManager);
+		for (Entity entity : probeManager.GetChanged()) UpdateProbe(entity, sceneRegistry, probeManager);
+	}
+
+	// picks the resident probes after RebuildProbes and copies the layers that changed
+	void UpdateProbes(
 		EnvironmentProbeManager& probeManager,
 		Camera& camera)
 	{
-		static glm::vec3 lastCamPos = camera.getCameraPos();
-		static float cacheTresholdSq = 0.5f * 0.5f;
-		glm::vec3 d = camera.getCameraPos() - lastCamPos;
-
-		if (glm::dot(d,d) < cacheTresholdSq && !cachedActiveProbes.empty()) 
-			return cachedActiveProbes;
-
-		lastCamPos = camera.getCameraPos();
+		if (!prefilterArray) AllocateArrays(MAX_RESIDENT_PROBES + 1);
+		if (layerMaps.empty()) layerMaps.assign(MAX_RESIDENT_PROBES + 1, 0);
 
-		struct ProbeDist
+		glm::vec3 cameraPos = camera.getCameraPos();
+		glm::ivec3 cell = grid.CellOf(cameraPos);
+		if (!queried || cell != queryCell || grid.getVersion() != queryVersion)
 		{
-			Entity entity;
-			float distance2;
-		};
+			grid.Nearest(cameraPos, MAX_RESIDENT_PROBES, residentProbes);
+			queryCell = cell;
+			queryVersion = grid.getVersion();
+			queried = true;
+		}
 
-		std::vector<ProbeDist> probes;
-		
-		for (Entity entity : sceneRegistry.GetAll())
+		// probes that left give their layer back before the new ones take one
+		for (Entity& owner : layerOwners)
 		{
-			auto* probeComp = probeManager.GetProbeComponent(entity);
-			if (!probeComp) continue;
-			
-			// get distance squared
-			glm::vec3 pos = probeComp->position;
-			glm::vec3 diff = camera.getCameraPos() - pos;
-			float dist2 = glm::dot(diff, diff);
-
-			if (dist2 <= probeComp->radius * probeComp->radius)
-				probes.push_back({ entity, dist2 });
+			if (owner != NO_PROBE && std::find(residentProbes.begin(), residentProbes.end(), owner) == residentProbes.end())
+				owner = NO_PROBE;
 		}
+		for (Entity entity : residentProbes)
+		{
+			if (std::find(layerOwners.begin(), layerOwners.end(), entity) != layerOwners.end()) continue;
+			*std::find(layerOwners.begin(), layerOwners.end(), NO_PROBE) = entity;
+		}
+
+		Entity skyEntity = probeManager.skyProbeComponent ? probeManager.skyProbeComponent->first : NO_PROBE;
+		EnvironmentProbeComponent* sky = probeManager.GetSkyProbe();
+		CopyLayer(sky, skyEntity, 0);
 
-		// sort probes nearest to camera
-		std::sort(probes.begin(), probes.end(),[](auto& a, auto& b)
+		// free and unbuilt layers get a negative radius, the culling skips them
+		probeBounds.clear();
+		EnvironmentProbeComponent* firstProbe = nullptr;
+		for (int i = 0; i < MAX_RESIDENT_PROBES; i++)
+		{
+			EnvironmentProbeComponent* probe = layerOwners[i] != NO_PROBE ? probeManager.GetProbeComponent(layerOwners[i]) : nullptr;
+			if (!probe || !probe->maps.prefilterMap)
 			{
-				return a.distance2 < b.distance2;
-			});
-
-		cachedActiveProbes.clear();
-		for (int i = 0; i < probes.size() && i < MAX_ACTIVE_PROBES-1; ++i)
-			cachedActiveProbes.push_back(probes[i].entity);
-	
-		return cachedActiveProbes;
+				probeBounds.push_back(glm::vec4(0.0f, 0.0f, 0.0f, -1.0f));
+				continue;
+			}
+			CopyLayer(probe, layerOwners[i], i + 1);
+			probeBounds.push_back(glm::vec4(probe->position, probe->radius));
+			if (!firstProbe) firstProbe = probe;
+		}
+		while (!probeBounds.empty() && probeBounds.back().w < 0.0f) probeBounds.pop_back();
+		rebuiltProbes.clear();
+
+		if (!placeholderTexture) placeholderTexture = TextureLibrary::GetTexture("White Texture - Default").id;
+		textures.prefilter = prefilterArray;
+		textures.irradianceSH = shBuffer;
+		textures.brdfLUT = sky ? sky->maps.brdfLUT : firstProbe ? firstProbe->maps.brdfLUT : placeholderTexture;
+		textures.hasSky = sky != nullptr && sky->maps.prefilterMap != 0;
+		textures.localProbes = (int)probeBounds.size();
 	}
+
+	// probes in the grid whose sphere contains point, or overlaps a box
+	void QueryPoint(const glm::vec3& point, std::vector<Entity>& result) { grid.QueryPoint(point, result); }
+	void QueryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<Entity>& result) { grid.QueryBox(boxMin, boxMax, result); }
+
+	const std::vector<Entity>& GetResidentProbes() const { return residentProbes; }
+	int getProbeCount() const { return grid.getProbeCount(); }
+
+	const ProbeTextures& GetTextures() const { return textures; }
+
+	// position and radius of the local probes, index i is layer i + 1
+	const std::vector<glm::vec4>& GetProbeBounds() const { return probeBounds; }
 };
\ No newline at end of file
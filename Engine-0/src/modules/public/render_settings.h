@@ -0,0 +1,181 @@
+#pragma once
+#include "gpu_timer.h"
+#include <glm/glm.hpp>
+
+// NOTE: runtime toggles of the render system, edited from the render settings window.
+
+enum class GeometryPath
+{
+	Deferred,			// every material writes the full g-buffer while rasterizing
+	VisibilityBuffer	// pbr assets write ids only, materials are resolved per pixel afterwards
+};
+
+enum class ShadingPath
+{
+	Deferred,			// g-buffer, then one fullscreen lighting pass
+	ForwardPlus			// depth prepass, then materials shaded with the tiled light lists, allows msaa
+};
+
+enum class LightingPath
+{
+	Fullscreen,			// one fragment shader runs the whole lighting on every pixel, sky included
+	ClassifiedTiles		// tiles sorted into sky, no point lights and full, each lit by its own compute shader
+};
+
+enum class LightCulling
+{
+	Tiled,				// 16x16 tiles with depth bounds, fixed lists of 256 lights
+	Clustered,			// 64x64 tiles x 24 log depth slices, compacted lists without a cap
+	TiledCPU			// the tiled lists built on the cpu and uploaded, without depth bounds
+};
+
+enum class SSAOMode
+{
+	FullResolution,		// full kernel every frame at full resolution, box blurred
+	HalfTemporal		// half resolution, a kernel subset per frame accumulated over time, bilateral upsample
+};
+
+enum class AntiAliasing
+{
+	None,
+	Temporal			// jittered scene passes resolved against the reprojected history, allows a lower render scale
+};
+
+enum class BloomMode
+{
+	Gaussian,			// full resolution bright pass, then 10 separable gaussian passes
+	DualFilter			// 13 tap downsample and tent upsample over a 1/2 to 1/64 mip chain
+};
+
+enum class PostChain
+{
+	Separate,			// bloom combine, tonemap, composite and post process as their own passes, keeps the intermediates
+	Fused				// one pass with the stages compiled in, writes only the final output
+};
+
+enum class ShadowFilterMode
+{
+	Mipmap,			// glGenerateMipmap over the moments, filtered by trilinear lookups
+	ComputeBlur		// separable gaussian in a compute shader, sampled at the base level
+};
+
+enum class ShadowMomentFormat
+{
+	RG32F,			// vsm or 2 component evsm, 8 bytes per texel
+	RG16F,			// 2 component evsm (vsm alone is too imprecise in half floats), 4 bytes per texel
+	RGBA16F			// 4 component evsm (positive and negative exponent), 8 bytes per texel
+};
+
+// baked into the color luts together with the tonemap curves, plain floats so changes are found with a memcmp
+struct ColorGrading
+{
+	float exposure = 0.8f;
+	float contrast = 1.0f;				// around middle grey, before tonemapping
+	float saturation = 1.0f;
+	glm::vec3 colorFilter = glm::vec3(1.0f);
+	glm::vec3 lift = glm::vec3(0.0f);
+	glm::vec3 gamma = glm::vec3(1.0f);
+	glm::vec3 gain = glm::vec3(1.0f);
+	float displayGamma = 2.2f;
+};
+
+struct RenderSettings
+{
+	ShadingPath shadingPath = ShadingPath::Deferred;
+	GeometryPath geometryPath = GeometryPath::Deferred;
+	int msaaSamples = 4;				// forward+ only
+	LightingPath lightingPath = LightingPath::ClassifiedTiles;	// deferred only
+
+	// point lights
+	LightCulling lightCulling = LightCulling::Clustered;
+	int stressLights = 0;				// synthetic lights added to the scene's
+
+	// temporal anti aliasing, the scene passes run at renderScale of the output and are upsampled by the resolve
+	AntiAliasing antiAliasing = AntiAliasing::Temporal;
+	float renderScale = 1.0f;
+	float taaFeedback = 0.9f;			// history weight, higher is smoother but ghosts longer
+
+	// mesh lod selection, the shadow pass is biased towards coarser levels
+	float lodScreenSize = 0.5f;
+	float lodBias = 0.0f;
+	float shadowLODBias = 1.0f;
+
+	// ambient occlusion
+	SSAOMode ssaoMode = SSAOMode::HalfTemporal;
+	int ssaoSamples = 16;				// per frame on the half resolution path, out of the 64 sample kernel
+	int ssaoHistoryFrames = 8;			// accumulation length, longer is smoother but slower to react
+
+	// post processing
+	PostChain postChain = PostChain::Fused;
+	ColorGrading grading;
+
+	// auto exposure, on top of the grading exposure
+	bool autoExposure = true;
+	float exposureMinLogLum = -10.0f;	// histogram range in log2 luminance
+	float exposureLogLumRange = 22.0f;
+	float exposureLowPercentile = 0.1f;	// pixels outside the percentiles are ignored by the average
+	float exposureHighPercentile = 0.9f;
+	float exposureAdaptationSpeed = 1.5f;
+	float exposureKey = 0.18f;			// average luminance is scaled onto this value
+	float exposureMinEV = -6.0f;
+	float exposureMaxEV = 6.0f;
+
+	// bloom
+	bool bloomEnabled = true;
+	BloomMode bloomMode = BloomMode::DualFilter;
+	float bloomThreshold = 0.5f;
+	float bloomKnee = 0.25f;			// soft threshold range, dual filter only
+	float bloomRadius = 1.0f;			// upsample tent size in texels, dual filter only
+	float bloomIntensity = 1.0f;
+	float bloomExposure = 0.8f;			// glow added to the scene, before the tonemapping exposure
+
+	// cascaded shadows
+	float shadowDistance = 250.0f;		// shadows fade out past this view distance
+	float cascadeSplitLambda = 0.75f;	// 0 = uniform splits, 1 = logarithmic splits
+	float shadowCasterMargin = 50.0f;	// extra depth towards the light for casters outside the camera slice
+	bool shadowCaching = true;			// keep static casters in a cache, only dynamic casters are drawn per frame
+	float shadowCacheCell = 0.25f;		// cascades only move in steps of this fraction of their size while caching
+
+	// point light shadows, cube faces in a shared atlas
+	bool pointShadows = true;
+	int pointShadowMaxLights = 16;		// most important shadowed lights that keep atlas tiles
+	int pointShadowBudget = 12;			// cube faces rendered per frame
+	float pointShadowTierDistance = 20.0f;	// face resolution halves at this distance and again at twice of it
+
+	// shadow filtering
+	ShadowFilterMode shadowFilter = ShadowFilterMode::ComputeBlur;
+	ShadowMomentFormat shadowFormat = ShadowMomentFormat::RG16F;
+	bool evsm = true;					// exponential warp of the moments, always on for the half float formats
+	int shadowBlurRadius = 3;			// texels, max 16
+	float lightBleedReduction = 0.2f;
+};
+
+// per frame numbers shown next to the settings
+struct RenderStats
+{
+	int visibilityDraws = 0;
+	int visibilityOverflow = 0;			// visibility path entities rasterized because the draw ids ran out
+	int lightCount = 0;
+	int visibleLights = 0;				// passed the cpu frustum test
+	int lightsUploaded = 0;				// changed lights written into the light buffer this frame
+	int lightIndices = 0;				// entries in the light lists, last read back total when clustered
+	size_t lightBufferBytes = 0;
+	int shadowCastersDrawn = 0;
+	int shadowCastersCulled = 0;
+	int shadowCascadesCached = 0;
+	int pointShadowLights = 0;			// lights sampling the atlas
+	int pointShadowFaces = 0;			// cube faces rendered this frame
+	int pointShadowPending = 0;			// new or invalidated faces left for the next frames
+
+	GpuTimer geometry;					// g-buffer, or the depth prepass on the forward+ path
+	GpuTimer lightCulling;
+	GpuTimer shading;					// lighting pass, or forward shading and resolve
+	GpuTimer ssao;
+	GpuTimer taa;
+	GpuTimer exposure;
+	GpuTimer bloom;
+	GpuTimer post;						// everything after bloom up to the final output
+	GpuTimer shadowRender;
+	GpuTimer pointShadowRender;
+	GpuTimer shadowFilter;
+};
\ No newline at end of file
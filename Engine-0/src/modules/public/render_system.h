@@ -3,19 +3,700 @@
 #include "camera.h"
 #include "asset_library.h"
 #include "renderer.h"
+#include "frustum.h"
+#include "render_settings.h"
+#include "probe_system.h"
+#include "shader_library.h"
 #include "../../common.h"
 #include <array>
+#include <cstring>
 
 class RenderSystem
 {
 private:
 	Renderer& renderer;
-	glm::mat4 lightSpaceMatrix = glm::mat4(1.0f);
-	float orthoSize = 25.0f;
+
+	// NOTE: cascades are fitted to slices of the camera frustum. Each slice is wrapped in a bounding sphere so the
+	// ortho box keeps its size while the camera rotates, and the box origin is snapped to shadow map texels to
+	// avoid shimmering when the camera moves.
+	struct ShadowCascade
+	{
+		glm::mat4 lightSpaceMatrix = glm::mat4(1.0f);
+		glm::mat4 sliceViewProj = glm::mat4(1.0f);	// camera frustum slice, receivers for caster culling
+		float splitFar = 0.0f;						// view space depth where this cascade ends
+		float radius = 1.0f;						// half size of the ortho box
+		float depthRange = 1.0f;					// near to far distance of the ortho box
+	};
+	std::array<ShadowCascade, MAX_SHADOW_CASCADES> cascades;
+	int activeCascades = 0;
+
+	// NOTE: static casters are rendered once into a cache per cascade and only redrawn when the cascade matrix
+	// (light direction, or the camera crossing a cache cell) or a static caster changes. Every frame the cache is
+	// copied into the sampled map and the dynamic casters are drawn on top with the cached depth.
+	struct ShadowCacheState
+	{
+		glm::mat4 lightSpaceMatrix = glm::mat4(0.0f);
+		bool valid = false;
+		bool hadDynamic = false; // the sampled map holds dynamic casters from the last frame
+	};
+	std::array<ShadowCacheState, MAX_SHADOW_CASCADES> shadowCache;
+
+	struct ShadowCaster
+	{
+		glm::mat4 model;
+		Asset* asset = nullptr;
+		Terrain* terrain = nullptr;
+		bool isStatic = true;
+	};
+	std::vector<ShadowCaster> shadowCasters; // gathered once per shadow pass, shared by every cascade
+	std::unordered_set<Entity> staticShadowCasters; // static at the last gather, so turning dynamic still invalidates
+	int lastShadowConfig = -1;
+
+	// point light shadows, see point_shadow_atlas.h. lights that cast shadows are tracked from the change sets
+	PointShadowAtlas pointShadowAtlas;
+	std::unordered_set<Entity> pointShadowCasters;		// enabled point lights with castShadows in the scene
+	std::vector<PointShadowAtlas::Candidate> pointShadowCandidates;
+	std::vector<PointShadowAtlas::FaceJob> pointShadowJobs;
+	std::vector<std::pair<Entity, int>> shadowedPointLights;	// light and index of its shadow record
+	std::vector<GPUPointShadow> pointShadowRecords;
+	size_t pointShadowCapacity = 1;						// records the buffer holds
+
+	// half resolution ssao history, reprojected with the camera of the frame that wrote it
+	struct SSAOHistoryState
+	{
+		glm::mat4 view = glm::mat4(1.0f);
+		glm::mat4 viewProjection = glm::mat4(1.0f);
+		int frame = 0;			// picks the kernel subset and noise rotation
+		int index = 0;			// history texture written this frame
+		bool valid = false;
+	} ssaoHistory;
+
+	// NOTE: temporal anti aliasing. The projection is offset by a halton sequence every frame, the velocity buffer
+	// and the resolve use the unjittered matrices. Model matrices of the previous frame are kept per entity.
+	struct TemporalAAState
+	{
+		glm::mat4 viewProjection = glm::mat4(1.0f);		// unjittered, this frame
+		glm::mat4 prevViewProjection = glm::mat4(1.0f);
+		glm::vec2 jitter = glm::vec2(0.0f);				// in render pixels
+		int frame = 0;
+		int index = 0;			// history texture written this frame
+		bool active = false;
+		bool hasPrevious = false;
+		bool valid = false;
+	} taa;
+	std::unordered_map<Entity, glm::mat4> prevModels, currentModels;
+
+	ColorGrading bakedGrading;
+	bool colorLUTBaked = false;
+	bool exposureAdapted = false;	// the exposure texture holds an adapted value (not the neutral 1.0)
+
+	glm::mat4 GetModelMatrix(const TransformComponent& transform) const
+	{
+		glm::mat4 model = glm::mat4(1.0f);
+		model = glm::translate(model, transform.position);
+		model = glm::rotate(model, transform.rotation.x, glm::vec3(1, 0, 0));
+		model = glm::rotate(model, transform.rotation.y, glm::vec3(0, 1, 0));
+		model = glm::rotate(model, transform.rotation.z, glm::vec3(0, 0, 1));
+		model = glm::scale(model, transform.scale);
+		return model;
+	}
+
+	// last frame's model matrix of the entity for the velocity buffer, records this frame's
+	glm::mat4 GetPrevModel(Entity entity, const glm::mat4& model)
+	{
+		currentModels[entity] = model;
+		auto it = prevModels.find(entity);
+		return it != prevModels.end() ? it->second : model;
+	}
+
+	void ApplyVelocityUniforms(Shader& shader, const glm::mat4& prevModel)
+	{
+		shader.setMat4("prevModel", prevModel);
+		shader.setMat4("currViewProjection", taa.viewProjection);
+		shader.setMat4("prevViewProjection", taa.prevViewProjection);
+	}
+
+	static float Halton(int index, int base)
+	{
+		float f = 1.0f, result = 0.0f;
+		for (int i = index; i > 0; i /= base)
+		{
+			f /= (float)base;
+			result += f * (float)(i % base);
+		}
+		return result;
+	}
+
+	void GetWorldBounds(const Asset& asset, const glm::mat4& model, glm::vec3& center, float& radius) const
+	{
+		center = glm::vec3(model * glm::vec4(asset.boundsCenter, 1.0f));
+		float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		radius = asset.boundsRadius * scale;
+	}
+
+	void UpdateCascades(Camera& camera, const glm::vec3& lightDir, unsigned int shadowSize, int cascadeCount)
+	{
+		int WIDTH = 1600;
+		int HEIGHT = 1200;
+		float aspect = (float)WIDTH / (float)HEIGHT;
+		float nearPlane = 0.1f;
+		float farPlane = glm::min(settings.shadowDistance, 2500.0f);
+
+		activeCascades = glm::clamp(cascadeCount, 1, MAX_SHADOW_CASCADES);
+		glm::mat4 view = camera.getViewMatrix();
+		glm::vec3 up = glm::abs(lightDir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+		float splitNear = nearPlane;
+		for (int c = 0; c < activeCascades; c++)
+		{
+			// practical split scheme, blend of logarithmic and uniform splits
+			float p = (float)(c + 1) / (float)activeCascades;
+			float logSplit = nearPlane * powf(farPlane / nearPlane, p);
+			float uniformSplit = nearPlane + (farPlane - nearPlane) * p;
+			float splitFar = settings.cascadeSplitLambda * logSplit + (1.0f - settings.cascadeSplitLambda) * uniformSplit;
+
+			glm::mat4 sliceProj = glm::perspective(glm::radians(camera.getFOV()), aspect, splitNear, splitFar);
+			glm::mat4 sliceViewProj = sliceProj * view;
+			glm::mat4 invViewProj = glm::inverse(sliceViewProj);
+
+			glm::vec3 corners[8];
+			glm::vec3 center(0.0f);
+			int i = 0;
+			for (int x = 0; x < 2; x++)
+				for (int y = 0; y < 2; y++)
+					for (int z = 0; z < 2; z++)
+					{
+						glm::vec4 pt = invViewProj * glm::vec4(x * 2.0f - 1.0f, y * 2.0f - 1.0f, z * 2.0f - 1.0f, 1.0f);
+						corners[i] = glm::vec3(pt) / pt.w;
+						center += corners[i++];
+					}
+			center /= 8.0f;
+
+			// bounding sphere keeps the box size constant under rotation, rounded to keep it stable frame to frame
+			float radius = 0.0f;
+			for (const glm::vec3& corner : corners) radius = glm::max(radius, glm::length(corner - center));
+			radius = ceilf(radius * 16.0f) / 16.0f;
+
+			// with caching, move the cascade in coarse light space steps so the cached static map stays valid
+			// while the camera moves inside a cell. the radius grows to still cover the whole slice.
+			if (settings.shadowCaching && settings.shadowCacheCell > 0.0f)
+			{
+				glm::mat3 lightRotation = glm::mat3(glm::lookAt(glm::vec3(0.0f), lightDir, up));
+				float cell = radius * settings.shadowCacheCell;
+				glm::vec3 lightCenter = lightRotation * center;
+				lightCenter = glm::floor(lightCenter / cell + 0.5f) * cell;
+				center = glm::transpose(lightRotation) * lightCenter;
+				radius = ceilf((radius + cell * 0.8660254f) * 16.0f) / 16.0f;
+			}
+
+			float depthRange = 2.0f * radius + settings.shadowCasterMargin;
+			glm::vec3 eye = center - lightDir * (radius + settings.shadowCasterMargin);
+			glm::mat4 lightView = glm::lookAt(eye, center, up);
+			glm::mat4 lightProj = glm::ortho(-radius, radius, -radius, radius, 0.0f, depthRange);
+
+			// snap the projected world origin to a whole texel
+			glm::mat4 lightViewProj = lightProj * lightView;
+			glm::vec4 origin = lightViewProj * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			origin *= (float)shadowSize * 0.5f;
+			glm::vec4 offset = (glm::round(origin) - origin) * (2.0f / (float)shadowSize);
+			lightProj[3][0] += offset.x;
+			lightProj[3][1] += offset.y;
+
+			ShadowCascade& cascade = cascades[c];
+			cascade.lightSpaceMatrix = lightProj * lightView;
+			cascade.sliceViewProj = sliceViewProj;
+			cascade.splitFar = splitFar;
+			cascade.radius = radius;
+			cascade.depthRange = depthRange;
+
+			splitNear = splitFar;
+		}
+	}
+
+	GLenum GetShadowMomentFormat() const
+	{
+		switch (settings.shadowFormat)
+		{
+		case ShadowMomentFormat::RG16F: return GL_RG16F;
+		case ShadowMomentFormat::RGBA16F: return GL_RGBA16F;
+		default: return GL_RG32F;
+		}
+	}
+
+	// 0 = vsm, 1 = evsm with the positive exponent, 2 = evsm with both exponents. half float moments are too
+	// imprecise for plain vsm, they are always warped
+	int GetShadowMode() const
+	{
+		if (!settings.evsm && settings.shadowFormat == ShadowMomentFormat::RG32F) return 0;
+		return settings.shadowFormat == ShadowMomentFormat::RGBA16F ? 2 : 1;
+	}
+
+	// exponents are limited so the warped moments stay inside the storage range
+	glm::vec2 GetEVSMExponents() const
+	{
+		if (settings.shadowFormat == ShadowMomentFormat::RG32F) return glm::vec2(40.0f, 5.0f);
+		return glm::vec2(5.54f, 5.54f);
+	}
+
+	glm::vec4 GetFarPlaneMoments() const
+	{
+		if (GetShadowMode() == 0) return glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+		glm::vec2 c = GetEVSMExponents();
+		float pos = expf(c.x);
+		float neg = -expf(-c.y);
+		return glm::vec4(pos, pos * pos, neg, neg * neg);
+	}
+
+	// separable gaussian over one cascade: layer -> temp (horizontal), temp -> layer (vertical)
+	void BlurShadowLayer(ShadowBufferAttachments& sa, int layer)
+	{
+		const int GROUP_SIZE = 128; // matches vsm_blur.comp
+		int radius = glm::clamp(settings.shadowBlurRadius, 1, 16);
+		GLenum format = renderer.getShadowMomentFormat();
+
+		Shader& blur = sa.blurShader;
+		blur.use();
+		blur.setInt("srcMoments", 0);
+		blur.setInt("radius", radius);
+		blur.setFloat("sigma", glm::max(radius * 0.5f, 0.5f));
+		glActiveTexture(GL_TEXTURE0);
+
+		glBindTexture(GL_TEXTURE_2D_ARRAY, sa.moments.id);
+		glBindImageTexture(0, sa.blurTemp.id, 0, GL_TRUE, 0, GL_WRITE_ONLY, format);
+		blur.setInt("srcLayer", layer);
+		blur.setInt("dstLayer", 0);
+		blur.setIVec2("direction", 1, 0);
+		glDispatchCompute((sa.shadow_width + GROUP_SIZE - 1) / GROUP_SIZE, sa.shadow_height, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		glBindTexture(GL_TEXTURE_2D_ARRAY, sa.blurTemp.id);
+		glBindImageTexture(0, sa.moments.id, 0, GL_TRUE, 0, GL_WRITE_ONLY, format);
+		blur.setInt("srcLayer", 0);
+		blur.setInt("dstLayer", layer);
+		blur.setIVec2("direction", 0, 1);
+		glDispatchCompute((sa.shadow_height + GROUP_SIZE - 1) / GROUP_SIZE, sa.shadow_width, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+
+	// the resolve shader evaluates the gbuffer_pbr.frag material, other materials stay on the deferred path
+	bool UsesVisibilityResolve(const ShaderComponent& shaderComp) const
+	{
+		return ShaderLibrary::UsesPBRMaterial(shaderComp.shaderName);
+	}
+
+	// conservative pixel rect of a bounding sphere, false when the sphere is off screen
+	bool GetScreenRect(const glm::vec3& center, float radius, const glm::mat4& viewProjection, int width, int height, glm::ivec4& rect) const
+	{
+		glm::vec2 minNDC(FLT_MAX), maxNDC(-FLT_MAX);
+		for (int i = 0; i < 8; i++)
+		{
+			glm::vec3 corner = center + radius * glm::vec3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f);
+			glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+			if (clip.w <= 0.1f)
+			{
+				// crosses the near plane
+				rect = glm::ivec4(0, 0, width, height);
+				return true;
+			}
+			glm::vec2 ndc = glm::vec2(clip) / clip.w;
+			minNDC = glm::min(minNDC, ndc);
+			maxNDC = glm::max(maxNDC, ndc);
+		}
+		if (maxNDC.x < -1.0f || maxNDC.y < -1.0f || minNDC.x > 1.0f || minNDC.y > 1.0f) return false;
+
+		glm::vec2 size((float)width, (float)height);
+		glm::vec2 minPx = glm::floor((glm::clamp(minNDC, -1.0f, 1.0f) * 0.5f + 0.5f) * size);
+		glm::vec2 maxPx = glm::ceil((glm::clamp(maxNDC, -1.0f, 1.0f) * 0.5f + 0.5f) * size);
+		rect = glm::ivec4(minPx, maxPx - minPx);
+		return rect.z > 0 && rect.w > 0;
+	}
+
+	struct VisibilityDraw
+	{
+		Mesh* mesh;
+		const Material* material;
+		glm::mat4 model;
+		glm::mat4 prevModel;
+		int lod;
+		glm::ivec4 rect;
+	};
+	std::vector<VisibilityDraw> visibilityDraws;
+	std::unordered_set<Entity> visibilityEntities;	// handled by the visibility buffer, the rest is rasterized
+	bool visibilityLimitLogged = false;
+
+	// NOTE: visibility buffer path. The geometry pass only writes draw and primitive ids, so overdraw costs a
+	// position transform and 8 bytes instead of the whole material. A full screen pass turns the draw ids into a
+	// 16 bit depth, then every draw resolves its material inside its screen rect with an equal depth test, which
+	// early-z limits to exactly the pixels that draw owns.
+	void RenderVisibilityBuffer(
+		SceneEntityRegistry& sceneRegistry,
+		TransformManager& transformManager,
+		ShaderManager& shaderManager,
+		AssetManager& assetManager,
+		MaterialsGroupManager& materialsGroupManager,
+		Camera& camera,
+		unsigned int frameVAO)
+	{
+		int WIDTH = renderer.getRenderWidth();
+		int HEIGHT = renderer.getRenderHeight();
+		glm::mat4 viewProjection = camera.getProjectionMatrix(WIDTH, HEIGHT, 0.1f, 2500.0f, true) * camera.getViewMatrix();
+		VisibilityBufferAttachments vba = renderer.getVisibilityAttachments();
+
+		visibilityDraws.clear();
+		visibilityEntities.clear();
+		for (Entity entity : sceneRegistry.GetAll())
+		{
+			ShaderComponent* shaderComp = shaderManager.GetComponent(entity);
+			TransformComponent* transformComp = transformManager.GetComponent(entity);
+			MaterialsGroupComponent* materialsGroupComp = materialsGroupManager.GetComponent(entity);
+			AssetComponent* assetComp = assetManager.GetComponent(entity);
+			if (!shaderComp || !transformComp || !materialsGroupComp || !assetComp) continue;
+			if (!UsesVisibilityResolve(*shaderComp)) continue;
+
+			Asset& asset = AssetLibrary::GetAsset(assetComp->assetName);
+			glm::mat4 model = GetModelMatrix(*transformComp);
+			glm::vec3 center;
+			float radius;
+			GetWorldBounds(asset, model, center, radius);
+			glm::ivec4 rect;
+			if (!GetScreenRect(center, radius, viewProjection, WIDTH, HEIGHT, rect))
+			{
+				visibilityEntities.insert(entity); // off screen, nothing to rasterize either
+				continue;
+			}
+
+			// the draw ids have to fit the 16 bit material depth. once they run out the remaining entities are
+			// rasterized by RenderGeometry instead
+			size_t parts = 0;
+			for (auto& group : materialsGroupComp->materialsGroup) parts += group.assetPartsIndices.size();
+			if (visibilityDraws.size() + parts > (size_t)MAX_VISIBILITY_DRAWS)
+			{
+				if (!visibilityLimitLogged)
+					std::cout << "ERROR::VISIBILITY_BUFFER::DRAW_LIMIT more than " << MAX_VISIBILITY_DRAWS << " draws, the rest is rasterized" << std::endl;
+				visibilityLimitLogged = true;
+				break;
+			}
+
+			int lod = SelectLOD(asset, model, camera, settings.lodBias);
+			glm::mat4 prevModel = GetPrevModel(entity, model);
+			for (auto& group : materialsGroupComp->materialsGroup)
+				for (size_t index : group.assetPartsIndices)
+					visibilityDraws.push_back({ &asset.parts[index].mesh, &group.material, model, prevModel, lod, rect });
+			visibilityEntities.insert(entity);
+		}
+		stats.visibilityDraws = (int)visibilityDraws.size();
+
+		// ids, depth is shared with the g-buffer
+		vba.visibilityBuffer.bind();
+		GLuint clearID[4] = { 0, 0, 0, 0 };
+		glClearBufferuiv(GL_COLOR, 0, clearID);
+		vba.visibilityShader.use();
+		vba.visibilityShader.setMat4("viewProjection", viewProjection);
+		GLint drawIDLocation = vba.visibilityShader.getUniformLocation("drawID");
+		for (size_t i = 0; i < visibilityDraws.size(); i++)
+		{
+			const VisibilityDraw& draw = visibilityDraws[i];
+			vba.visibilityShader.setMat4("model", draw.model);
+			glUniform1ui(drawIDLocation, (GLuint)(i + 1));
+			draw.mesh->Draw(vba.visibilityShader, draw.lod);
+		}
+
+		// ids to material depth
+		vba.resolveBuffer.bind();
+		glClear(GL_DEPTH_BUFFER_BIT);
+		glDepthFunc(GL_ALWAYS);
+		vba.materialDepthShader.use();
+		vba.materialDepthShader.setInt("visibility", 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, vba.visibility);
+		glBindVertexArray(frameVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+
+		// per draw material resolve into the g-buffer colors
+		const int VISIBILITY_UNIT = 15; // above the material samplers
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+		glEnable(GL_SCISSOR_TEST);
+		Shader& resolve = vba.resolveShader;
+		resolve.use();
+		resolve.setMat4("viewProjection", viewProjection);
+		resolve.setVec2("screenSize", glm::vec2((float)WIDTH, (float)HEIGHT));
+		resolve.setInt("visibility", VISIBILITY_UNIT);
+		GLint firstIndexLocation = resolve.getUniformLocation("firstIndex");
+		for (size_t i = 0; i < visibilityDraws.size(); i++)
+		{
+			const VisibilityDraw& draw = visibilityDraws[i];
+			draw.material->ApplyShaderUniforms(resolve);
+			glActiveTexture(GL_TEXTURE0 + VISIBILITY_UNIT);
+			glBindTexture(GL_TEXTURE_2D, vba.visibility);
+
+			resolve.setMat4("model", draw.model);
+			ApplyVelocityUniforms(resolve, draw.prevModel);
+			resolve.setFloat("materialDepth", (float)(i + 1) / 65535.0f);
+			const std::vector<MeshLOD>& lods = draw.mesh->getLODs();
+			bool indexed = !lods.empty();
+			resolve.setBool("indexed", indexed);
+			glUniform1ui(firstIndexLocation, indexed ? lods[glm::clamp(draw.lod, 0, (int)lods.size() - 1)].firstIndex : 0u);
+			// bindings 0-2 hold the light buffers for the lighting pass
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, draw.mesh->getVBO());
+			if (indexed) glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, draw.mesh->getEBO());
+
+			glScissor(draw.rect.x, draw.rect.y, draw.rect.z, draw.rect.w);
+			glBindVertexArray(frameVAO);
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+		}
+		glDisable(GL_SCISSOR_TEST);
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LESS);
+		glBindVertexArray(0);
+	}
+
+	void GatherShadowCasters(
+		SceneEntityRegistry& sceneRegistry,
+		TransformManager& transformManager,
+		AssetManager& assetManager,
+		LandscapeManager& landscapeManager)
+	{
+		shadowCasters.clear();
+		staticShadowCasters.clear();
+		for (Entity entity : sceneRegistry.GetAll())
+		{
+			AssetComponent* assetComp = assetManager.GetComponent(entity);
+			TransformComponent* transformComp = transformManager.GetComponent(entity);
+			LandscapeComponent* landComp = landscapeManager.GetLandscapeComponent(entity);
+
+			if ((!assetComp && !landComp) || !transformComp) continue;
+
+			ShadowCaster caster;
+			caster.model = GetModelMatrix(*transformComp);
+			caster.isStatic = transformComp->isStatic;
+			if (caster.isStatic) staticShadowCasters.insert(entity);
+
+			if (assetComp) caster.asset = &AssetLibrary::GetAsset(assetComp->assetName);
+			else caster.terrain = landComp->terrain.get();
+
+			shadowCasters.push_back(caster);
+		}
+	}
+
+	bool HasDynamicShadowCasters(const ShadowCasterCuller& culler) const
+	{
+		for (const ShadowCaster& caster : shadowCasters)
+		{
+			if (caster.isStatic) continue;
+			if (caster.terrain || IsShadowCasterVisible(*caster.asset, caster.model, culler)) return true;
+		}
+		return false;
+	}
+
+	void DrawShadowCasters(Shader& shader, Camera& camera, const ShadowCasterCuller& culler, int cascade, bool staticCasters)
+	{
+		for (ShadowCaster& caster : shadowCasters)
+		{
+			if (caster.isStatic != staticCasters) continue;
+
+			if (caster.asset)
+			{
+				if (!IsShadowCasterVisible(*caster.asset, caster.model, culler))
+				{
+					stats.shadowCastersCulled++;
+					continue;
+				}
+				stats.shadowCastersDrawn++;
+
+				shader.setMat4("model", caster.model);
+				// farther cascades are coarser, so they also take coarser LODs
+				int lod = SelectLOD(*caster.asset, caster.model, camera, settings.shadowLODBias + (float)cascade);
+				for (MeshData& md : caster.asset->parts) md.mesh.Draw(shader, lod);
+			}
+			else if (caster.terrain)
+			{
+				stats.shadowCastersDrawn++;
+				shader.setMat4("model", caster.model);
+				caster.terrain->RenderShadow(shader, camera, culler, caster.model);
+			}
+		}
+	}
+
+	// picks a LOD from the projected size of the asset bounds, as a fraction of the screen height.
+	// every halving of the screen size below settings.lodScreenSize drops one level.
+	int SelectLOD(const Asset& asset, const glm::mat4& model, Camera& camera, float bias) const
+	{
+		if (asset.lodCount <= 1 || asset.boundsRadius <= 0.0f) return 0;
+
+		glm::vec3 center;
+		float radius;
+		GetWorldBounds(asset, model, center, radius);
+		float distance = glm::length(center - camera.getCameraPos());
+		if (distance <= radius) return 0;
+
+		float screenSize = radius / (distance * tanf(glm::radians(camera.getFOV()) * 0.5f));
+		float level = log2f(settings.lodScreenSize / glm::max(screenSize, 1e-6f)) + bias;
+		return glm::clamp((int)floorf(level), 0, asset.lodCount - 1);
+	}
+
+	bool IsShadowCasterVisible(const Asset& asset, const glm::mat4& model, const ShadowCasterCuller& culler) const
+	{
+		if (asset.boundsRadius <= 0.0f) return true;
+
+		glm::vec3 center;
+		float radius;
+		GetWorldBounds(asset, model, center, radius);
+		return culler.IsSphereVisible(center, radius);
+	}
+
+	void UpdatePointShadowCaster(Entity entity, SceneEntityRegistry& sceneRegistry, LightManager& lightManager, TransformManager& transformManager)
+	{
+		PointLightComponent* lightComp = lightManager.GetPointLightComponent(entity);
+		if (lightComp && lightComp->enabled && lightComp->castShadows && transformManager.GetComponent(entity) && sceneRegistry.Contains(entity))
+			pointShadowCasters.insert(entity);
+		else pointShadowCasters.erase(entity);
+	}
+
+	// renders one cube face into its atlas tile, casters are culled against the face frustum
+	void RenderPointShadowFace(Shader& shader, Camera& camera, const PointShadowAtlas::FaceJob& job)
+	{
+		// +x, -x, +y, -y, +z, -z with the usual cubemap up vectors, mirrored in pbr_lighting.glsl
+		static const glm::vec3 forwards[6] = {
+			glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) };
+		static const glm::vec3 ups[6] = {
+			glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0) };
+
+		// the face is widened by the guard band so the pcf taps at its edges stay inside the tile
+		float scale = (float)(job.tile.z - 2 * POINT_SHADOW_GUARD) / (float)job.tile.z;
+		glm::mat4 view = glm::lookAt(job.position, job.position + forwards[job.face], ups[job.face]);
+		glm::mat4 projection = glm::perspective(2.0f * atanf(1.0f / scale), 1.0f, glm::max(job.radius * 0.001f, 0.01f), job.radius);
+		glm::mat4 faceMatrix = projection * view;
+
+		glViewport(job.tile.x, job.tile.y, job.tile.z, job.tile.z);
+		glScissor(job.tile.x, job.tile.y, job.tile.z, job.tile.z);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		shader.setMat4("lightSpaceMatrix", faceMatrix);
+
+		// the face frustum is both the light volume and the receivers, nothing is swept
+		ShadowCasterCuller culler(faceMatrix, faceMatrix, forwards[job.face], 0.0f);
+		float lodBias = settings.shadowLODBias + log2f((float)PointShadowAtlas::FaceSize(0) / (float)job.tile.z);
+		for (ShadowCaster& caster : shadowCasters)
+		{
+			shader.setMat4("model", caster.model);
+			if (caster.asset)
+			{
+				if (!IsShadowCasterVisible(*caster.asset, caster.model, culler)) continue;
+				int lod = SelectLOD(*caster.asset, caster.model, camera, lodBias);
+				for (MeshData& md : caster.asset->parts) md.mesh.Draw(shader, lod);
+			}
+			else if (caster.terrain) caster.terrain->RenderShadow(shader, camera, culler, caster.model);
+		}
+	}
+
+	// shadows and probes, shared by the deferred lighting pass and the forward+ shaders
+	void ApplyLightingUniforms(
+		Shader& shader,
+		const ProbeTextures& probes,
+		Camera& camera,
+		unsigned int unit
+	)
+	{
+		shader.use();
+		shader.setVec3("viewPos", camera.getCameraPos());
+		shader.setVec3("viewForward", camera.getCameraFront());
+		shader.setFloat("vsmSize", (float)renderer.getShadowAttachments().shadow_width);
+		shader.setInt("cascadeCount", activeCascades);
+		glm::vec4 splits(0.0f), lightSizeUV(0.0f);
+		float lightWorldDiameter = 0.5f;
+		for (int c = 0; c < activeCascades; c++)
+		{
+			shader.setMat4("cascadeMatrices[" + std::to_string(c) + "]", cascades[c].lightSpaceMatrix);
+			splits[c] = cascades[c].splitFar;
+			lightSizeUV[c] = lightWorldDiameter / (cascades[c].radius * 2.0f);
+		}
+		shader.setVec4("cascadeSplits", splits);
+		shader.setVec4("cascadeLightSizeUV", lightSizeUV);
+		shader.setInt("shadowMode", GetShadowMode());
+		shader.setVec2("evsmExponents", GetEVSMExponents());
+		shader.setFloat("lightBleedReduction", settings.lightBleedReduction);
+		shader.setBool("vsmUseMips", settings.shadowFilter == ShadowFilterMode::Mipmap);
+
+		shader.setInt("dirVSM", unit);
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, renderer.getShadowMoments().id);
+
+		// probe cubemap array and irradiance sh, the light system binds the probe bounds and tile lists
+		shader.setBool("hasSkyProbe", probes.hasSky);
+		shader.setInt("prefilterMaps", unit + 1);
+		glActiveTexture(GL_TEXTURE0 + unit + 1);
+		glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, probes.prefilter);
+		shader.setInt("brdfLUT", unit + 2);
+		glActiveTexture(GL_TEXTURE0 + unit + 2);
+		glBindTexture(GL_TEXTURE_2D, probes.brdfLUT);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, probes.irradianceSH);
+
+		// the light table maps lights onto the point shadow records
+		shader.setInt("pointShadowAtlas", unit + 3);
+		shader.setFloat("pointShadowTexel", 1.0f / (float)POINT_SHADOW_ATLAS_SIZE);
+		glActiveTexture(GL_TEXTURE0 + unit + 3);
+		glBindTexture(GL_TEXTURE_2D, renderer.getPointShadowAtlas().id);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, renderer.getPointShadowRecords());
+	}
+
+	// forward variant of the entity's g-buffer material. materials without one are drawn with the default shader
+	// instead of disappearing
+	Shader* GetForwardShader(const ShaderComponent& shaderComp, ForwardAttachments& fa) const
+	{
+		if (ShaderLibrary::UsesPBRMaterial(shaderComp.shaderName)) return &fa.pbrShader;
+		if (shaderComp.shaderName == "Landscape Material") return &fa.terrainShader;
+		return &fa.defaultShader;
+	}
 
 public:
+	RenderSettings settings;
+	RenderStats stats;
+
 	RenderSystem(Renderer& renderer) : renderer(renderer) {}
 
+	// render scale, projection jitter and temporal targets of the frame, before any scene pass.
+	// temporal is false for the buffer views, they are shown without a resolve
+	void BeginFrame(Camera& camera, bool temporal)
+	{
+		taa.active = temporal && settings.antiAliasing == AntiAliasing::Temporal;
+		float scale = taa.active ? glm::clamp(settings.renderScale, 0.5f, 1.0f) : 1.0f;
+		if (scale != renderer.getRenderScale())
+		{
+			renderer.SetRenderScale(scale);
+			taa.valid = false;
+			ssaoHistory.valid = false;
+		}
+		renderer.SetTemporalTargets(taa.active);
+		if (!taa.active) taa.valid = false;
+
+		taa.jitter = glm::vec2(0.0f);
+		if (taa.active)
+		{
+			// halton(2, 3), more phases when upsampling so every output pixel is hit by samples
+			int phases = (int)ceilf(8.0f / (scale * scale));
+			int index = taa.frame % phases + 1;
+			taa.jitter = glm::vec2(Halton(index, 2), Halton(index, 3)) - 0.5f;
+			taa.frame++;
+		}
+		glm::vec2 renderSize((float)renderer.getRenderWidth(), (float)renderer.getRenderHeight());
+		camera.setJitter(taa.jitter * 2.0f / renderSize);
+
+		int WIDTH = 1600;
+		int HEIGHT = 1200;
+		glm::mat4 viewProjection = camera.getProjectionMatrix(WIDTH, HEIGHT, 0.1f, 2500.0f) * camera.getViewMatrix();
+		taa.prevViewProjection = taa.hasPrevious ? taa.viewProjection : viewProjection;
+		taa.viewProjection = viewProjection;
+		taa.hasPrevious = true;
+	}
+
+	// lit scene as read by everything after the lighting pass, the resolved output while temporal aa is on
+	Texture& GetSceneColor()
+	{
+		return taa.active ? renderer.getTAASceneTex() : renderer.getHDRSceneTex();
+	}
+
 	void RenderGeometry(
 		SceneEntityRegistry& sceneRegistry,
 		TransformManager& transformManager,
@@ -23,15 +704,28 @@ public:
 		AssetManager& assetManager,
 		LandscapeManager& landscapeManager,
 		MaterialsGroupManager& materialsGroupManager,
-		Camera& camera
+		Camera& camera,
+		unsigned int frameVAO
 	)
 	{
+		stats.geometry.Begin();
 		glEnable(GL_DEPTH_TEST);
 		glDepthMask(GL_TRUE);
 		renderer.getGBuffer().bind();
 		glClearColor(0.0, 0.0, 0.0, 0.0);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		// assets with the pbr material go through the visibility buffer, the rest (terrain, other materials) is
+		// rasterized into the resolved g-buffer afterwards and depth tested against it
+		bool visibilityPath = settings.geometryPath == GeometryPath::VisibilityBuffer;
+		stats.visibilityDraws = 0;
+		stats.visibilityOverflow = 0;
+		if (visibilityPath)
+		{
+			RenderVisibilityBuffer(sceneRegistry, transformManager, shaderManager, assetManager, materialsGroupManager, camera, frameVAO);
+			renderer.getGBuffer().bind();
+		}
+
 		for (Entity entity : sceneRegistry.GetAll())
 		{
 			
@@ -41,38 +735,37 @@ public:
 
 			if (!transformComp || !shaderComp || !materialsGroupComp)
 				continue;
+			if (visibilityPath && assetManager.GetComponent(entity) && UsesVisibilityResolve(*shaderComp))
+			{
+				if (visibilityEntities.count(entity)) continue; // already in the g-buffer
+				stats.visibilityOverflow++;
+			}
 
 			Shader* shader = shaderComp->shader;
 			shader->use();
 
-			glm::mat4 model = glm::mat4(1.0f);
-			if (transformComp)
-			{
-				model = glm::translate(model, transformComp->position);
-				model = glm::rotate(model, transformComp->rotation.x, glm::vec3(1, 0, 0));
-				model = glm::rotate(model, transformComp->rotation.y, glm::vec3(0, 1, 0));
-				model = glm::rotate(model, transformComp->rotation.z, glm::vec3(0, 0, 1));
-				model = glm::scale(model, transformComp->scale);
-			}
+			glm::mat4 model = GetModelMatrix(*transformComp);
 
 			shader->setMat4("model", model);
 			shader->setMat4("view", camera.getViewMatrix());
 			int WIDTH = 1600;
 			int HEIGHT = 1200;
-			shader->setMat4("projection", camera.getProjectionMatrix(WIDTH, HEIGHT, 0.1f, 2500.0f));
+			shader->setMat4("projection", camera.getProjectionMatrix(WIDTH, HEIGHT, 0.1f, 2500.0f, true));
+			ApplyVelocityUniforms(*shader, GetPrevModel(entity, model));
 
 			AssetComponent* assetComp = assetManager.GetComponent(entity);
 			if (assetComp)
 			{
 				Asset& asset = AssetLibrary::GetAsset(assetComp->assetName);
 				auto& parts = asset.parts;
+				int lod = SelectLOD(asset, model, camera, settings.lodBias);
 
 				for (auto& group : materialsGroupComp->materialsGroup)
 				{
 					group.material.ApplyShaderUniforms(*shader);
 					for (size_t index : group.assetPartsIndices)
 					{
-						parts[index].mesh.Draw(*shader);
+						parts[index].mesh.Draw(*shader, lod);
 					}
 				}
 				continue; // no need to check for landscape
@@ -89,6 +782,9 @@ public:
 			}
 		}
 		renderer.getGBuffer().unbind();
+		prevModels.swap(currentModels);
+		currentModels.clear();
+		stats.geometry.End();
 	}
 
 	void RenderShadowPass(
@@ -103,65 +799,121 @@ public:
 		// tentative, assume there is only one directional light.
 		Entity dirLightEntity = lightManager.GetAnyDirectionalLight()->first;
 		TransformComponent* dirTransformComp = transformManager.GetComponent(dirLightEntity);
+		stats.shadowRender.Begin();
+
+		// format, encoding or filter changes invalidate everything that was cached
+		GLenum momentFormat = GetShadowMomentFormat();
+		if (momentFormat != renderer.getShadowMomentFormat()) renderer.SetShadowMomentFormat(momentFormat);
+		int shadowConfig = GetShadowMode() * 16 + (int)settings.shadowFilter * 4 + (int)settings.shadowFormat;
+		if (shadowConfig != lastShadowConfig)
+		{
+			for (ShadowCacheState& cache : shadowCache) cache.valid = false;
+			lastShadowConfig = shadowConfig;
+		}
+
 		ShadowBufferAttachments sa = renderer.getShadowAttachments();
 
-		float near_plane = 1.0f, far_plane = 80.0f;
-		glm::mat4 lightProjection = glm::ortho(
-			-orthoSize, +orthoSize, 
-			-orthoSize, +orthoSize, 
-			near_plane, far_plane);
 		glm::vec3 lightDir = glm::normalize(dirTransformComp->rotation);
-		glm::vec3 sceneCenter = glm::vec3(0.0f);
-		float distance = 40.0f;
-		glm::vec3 lightEye = sceneCenter - lightDir * distance;
+		UpdateCascades(camera, lightDir, sa.shadow_width, sa.cascadeCount);
 
-		glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
-		glm::mat4 lightView = glm::lookAt(lightEye, sceneCenter, up);
-		lightSpaceMatrix = lightProjection * lightView;
+		// an edited caster that is or was static invalidates the cache, dynamic ones are redrawn every frame anyway.
+		// added and removed entities too, the cache would keep a removed caster's shadow. lights cast no shadow here
+		bool staticCasterChanged = !settings.shadowCaching;
+		for (Entity entity : transformManager.GetChanged())
+		{
+			if (entity == dirLightEntity || lightManager.GetPointLightComponent(entity)) continue;
+			TransformComponent* transformComp = transformManager.GetComponent(entity);
+			if ((transformComp && transformComp->isStatic) || staticShadowCasters.count(entity)) staticCasterChanged = true;
+		}
+		for (Entity entity : sceneRegistry.GetChanged())
+			if (entity != dirLightEntity && !lightManager.GetPointLightComponent(entity)) staticCasterChanged = true;
 
-		glViewport(0, 0, sa.shadow_width, sa.shadow_height);
+		GatherShadowCasters(sceneRegistry, transformManager, assetManager, landscapeManager);
 
 		glEnable(GL_POLYGON_OFFSET_FILL);
 		glPolygonOffset(2.0f, 4.0f);
 
 		glCullFace(GL_FRONT);
 		glEnable(GL_DEPTH_TEST);
-		sa.shadowBuffer.bind();
-		glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+		// casters behind the near plane are not culled, clamp them onto it instead of clipping
+		glEnable(GL_DEPTH_CLAMP);
+		// empty texels are fully lit (moments of the far plane)
+		glm::vec4 farMoments = GetFarPlaneMoments();
+		glClearColor(farMoments.x, farMoments.y, farMoments.z, farMoments.w);
 		sa.shadowShader.use();
-		sa.shadowShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-
-		for (Entity entity : sceneRegistry.GetAll())
-		{
-			AssetComponent* assetComp = assetManager.GetComponent(entity);
-			TransformComponent* transformComp = transformManager.GetComponent(entity);
-			LandscapeComponent* landComp = landscapeManager.GetLandscapeComponent(entity);
+		sa.shadowShader.setInt("shadowMode", GetShadowMode());
+		sa.shadowShader.setVec2("evsmExponents", GetEVSMExponents());
 
-			if ((!assetComp && !landComp)|| !transformComp) continue;
+		stats.shadowCastersDrawn = 0;
+		stats.shadowCastersCulled = 0;
+		stats.shadowCascadesCached = 0;
+		std::array<bool, MAX_SHADOW_CASCADES> layerChanged{};
 
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, transformComp->position);
-			model = glm::rotate(model, transformComp->rotation.x, glm::vec3(1, 0, 0));
-			model = glm::rotate(model, transformComp->rotation.y, glm::vec3(0, 1, 0));
-			model = glm::rotate(model, transformComp->rotation.z, glm::vec3(0, 0, 1));
-			model = glm::scale(model, transformComp->scale);
+		for (int c = 0; c < activeCascades; c++)
+		{
+			const ShadowCascade& cascade = cascades[c];
+			ShadowCacheState& cache = shadowCache[c];
+			sa.shadowShader.setMat4("lightSpaceMatrix", cascade.lightSpaceMatrix);
 
-			sa.shadowShader.setMat4("model", model);
+			// casters must touch the cascade volume and throw their shadow into its camera slice
+			ShadowCasterCuller culler(cascade.lightSpaceMatrix, cascade.sliceViewProj, lightDir, cascade.depthRange);
 
-			if (assetComp)
+			bool staticDirty = staticCasterChanged || !cache.valid || cache.lightSpaceMatrix != cascade.lightSpaceMatrix;
+			if (staticDirty)
 			{
-				Asset& asset = AssetLibrary::GetAsset(assetComp->assetName);
-				auto& parts = asset.parts;
-				for (MeshData& md : parts) md.mesh.Draw(sa.shadowShader);
+				sa.staticBuffer.attachTextureLayer(GL_COLOR_ATTACHMENT0, sa.staticMoments.id, c);
+				sa.staticBuffer.attachTextureLayer(GL_DEPTH_ATTACHMENT, sa.staticDepth.id, c);
+				sa.staticBuffer.bind();
+				glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+				DrawShadowCasters(sa.shadowShader, camera, culler, c, true);
+
+				cache.lightSpaceMatrix = cascade.lightSpaceMatrix;
+				cache.valid = true;
 			}
-			else if (landComp)
+			else stats.shadowCascadesCached++;
+
+			bool hasDynamic = HasDynamicShadowCasters(culler);
+
+			// the sampled layer is still valid when neither the cache nor the dynamic casters touched it
+			if (!staticDirty && !hasDynamic && !cache.hadDynamic) continue;
+
+			glCopyImageSubData(
+				sa.staticMoments.id, GL_TEXTURE_2D_ARRAY, 0, 0, 0, c,
+				sa.moments.id, GL_TEXTURE_2D_ARRAY, 0, 0, 0, c,
+				sa.shadow_width, sa.shadow_height, 1);
+			layerChanged[c] = true;
+
+			if (hasDynamic)
 			{
-				landComp->terrain->Render(sa.shadowShader, camera, model);
+				glCopyImageSubData(
+					sa.staticDepth.id, GL_TEXTURE_2D_ARRAY, 0, 0, 0, c,
+					sa.depth.id, GL_TEXTURE_2D, 0, 0, 0, 0,
+					sa.shadow_width, sa.shadow_height, 1);
+				sa.shadowBuffer.attachTextureLayer(GL_COLOR_ATTACHMENT0, sa.moments.id, c);
+				sa.shadowBuffer.bind();
+				DrawShadowCasters(sa.shadowShader, camera, culler, c, false);
 			}
+			cache.hadDynamic = hasDynamic;
 		}
 		sa.shadowBuffer.unbind();
-		renderer.getShadowMoments().genMipMap(); // rebuild mipchain
+		stats.shadowRender.End();
 
+		stats.shadowFilter.Begin();
+		if (settings.shadowFilter == ShadowFilterMode::Mipmap)
+		{
+			bool anyChanged = false;
+			for (int c = 0; c < activeCascades; c++) anyChanged |= layerChanged[c];
+			if (anyChanged) sa.moments.genMipMap(); // rebuild mipchain of every cascade
+		}
+		else
+		{
+			for (int c = 0; c < activeCascades; c++)
+				if (layerChanged[c]) BlurShadowLayer(sa, c);
+		}
+		stats.shadowFilter.End();
+
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glDisable(GL_DEPTH_CLAMP);
 		glDisable(GL_DEPTH_TEST);
 		glCullFace(GL_BACK);
 		glDisable(GL_POLYGON_OFFSET_FILL);
@@ -170,13 +922,144 @@ public:
 		glViewport(0, 0, WIDTH, HEIGHT);
 	}
 
+	// point light shadows into the atlas, after RenderShadowPass (shares its casters). at most
+	// settings.pointShadowBudget faces are rendered per frame
+	void RenderPointShadowPass(
+		LightManager& lightManager,
+		TransformManager& transformManager,
+		SceneEntityRegistry& sceneRegistry,
+		Camera& camera
+		)
+	{
+		for (Entity entity : sceneRegistry.GetChanged()) UpdatePointShadowCaster(entity, sceneRegistry, lightManager, transformManager);
+		for (Entity entity : lightManager.GetChanged()) UpdatePointShadowCaster(entity, sceneRegistry, lightManager, transformManager);
+
+		// moved or added static casters invalidate every static face, lights themselves are handled by the atlas.
+		// scanned while point shadows are off too, the atlas keeps its faces for when they come back
+		bool staticCasterChanged = false;
+		for (Entity entity : transformManager.GetChanged())
+		{
+			TransformComponent* transformComp = transformManager.GetComponent(entity);
+			if (transformComp && transformComp->isStatic && !lightManager.GetPointLightComponent(entity)) staticCasterChanged = true;
+		}
+		for (Entity entity : sceneRegistry.GetChanged())
+			if (!lightManager.GetPointLightComponent(entity)) staticCasterChanged = true;
+		if (staticCasterChanged) pointShadowAtlas.InvalidateAll();
+
+		stats.pointShadowFaces = 0;
+		if (!settings.pointShadows)
+		{
+			shadowedPointLights.clear();
+			stats.pointShadowLights = 0;
+			stats.pointShadowPending = 0;
+			return;
+		}
+		stats.pointShadowRender.Begin();
+
+		// importance is the light's brightness at the camera, lights the camera cannot see keep a fraction of it
+		Frustum cameraFrustum(taa.viewProjection);
+		glm::vec3 cameraPos = camera.getCameraPos();
+		pointShadowCandidates.clear();
+		for (Entity entity : pointShadowCasters)
+		{
+			PointLightComponent* lightComp = lightManager.GetPointLightComponent(entity);
+			TransformComponent* transformComp = transformManager.GetComponent(entity);
+			glm::vec3 position = transformComp->position;
+			float radius = lightComp->radius;
+			float distance = glm::max(glm::length(position - cameraPos) - radius, 0.0f);
+			float brightness = lightComp->intensity * glm::max(lightComp->color.r, glm::max(lightComp->color.g, lightComp->color.b));
+
+			PointShadowAtlas::Candidate candidate;
+			candidate.entity = entity;
+			candidate.position = position;
+			candidate.radius = radius;
+			candidate.distance = distance;
+			candidate.importance = brightness * radius * radius / ((distance + radius) * (distance + radius));
+			if (!cameraFrustum.IsPatchSphereInFrustum(position, radius)) candidate.importance *= 0.1f;
+
+			// moving lights and lights that see moving casters are refreshed every few frames
+			candidate.dynamic = !transformComp->isStatic;
+			for (size_t i = 0; i < shadowCasters.size() && !candidate.dynamic; i++)
+			{
+				const ShadowCaster& caster = shadowCasters[i];
+				if (caster.isStatic) continue;
+				if (caster.terrain || caster.asset->boundsRadius <= 0.0f)
+				{
+					candidate.dynamic = true;
+					continue;
+				}
+				glm::vec3 center;
+				float casterRadius;
+				GetWorldBounds(*caster.asset, caster.model, center, casterRadius);
+				candidate.dynamic = glm::length(center - position) < radius + casterRadius;
+			}
+			pointShadowCandidates.push_back(candidate);
+		}
+
+		pointShadowAtlas.Update(pointShadowCandidates, settings.pointShadowMaxLights, settings.pointShadowTierDistance,
+			settings.pointShadowBudget, pointShadowJobs);
+
+		if (!pointShadowJobs.empty())
+		{
+			GLint viewport[4];
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			renderer.getPointShadowBuffer().bind();
+			Shader& shader = renderer.getPointShadowShader();
+			shader.use();
+
+			glEnable(GL_DEPTH_TEST);
+			glEnable(GL_SCISSOR_TEST);
+			glEnable(GL_DEPTH_CLAMP);
+			glCullFace(GL_FRONT);
+			for (const PointShadowAtlas::FaceJob& job : pointShadowJobs)
+			{
+				shader.setVec3("lightPos", job.position);
+				shader.setFloat("farPlane", job.radius);
+				RenderPointShadowFace(shader, camera, job);
+				pointShadowAtlas.MarkRendered(job);
+			}
+			glCullFace(GL_BACK);
+			glDisable(GL_DEPTH_CLAMP);
+			glDisable(GL_SCISSOR_TEST);
+			glDisable(GL_DEPTH_TEST);
+			renderer.getPointShadowBuffer().unbind();
+			glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		}
+		stats.pointShadowFaces = (int)pointShadowJobs.size();
+
+		// records of the complete lights, the buffer only grows
+		pointShadowAtlas.GetShadowedLights(shadowedPointLights, pointShadowRecords);
+		if (!pointShadowRecords.empty())
+		{
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, renderer.getPointShadowRecords());
+			if (pointShadowRecords.size() > pointShadowCapacity)
+			{
+				pointShadowCapacity = pointShadowRecords.size();
+				glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GPUPointShadow) * pointShadowCapacity, nullptr, GL_DYNAMIC_DRAW);
+			}
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GPUPointShadow) * pointShadowRecords.size(), pointShadowRecords.data());
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		}
+		stats.pointShadowLights = (int)shadowedPointLights.size();
+		stats.pointShadowPending = pointShadowAtlas.getPendingFaces();
+		stats.pointShadowRender.End();
+	}
+
+	// lights sampling the point shadow atlas with their record index, for LightSystem::SetShadowedLights
+	const std::vector<std::pair<Entity, int>>& GetShadowedPointLights() const
+	{
+		return shadowedPointLights;
+	}
+
 	void RenderSSAO(Camera& camera, unsigned int frameVAO)
 	{
+		stats.ssao.Begin();
 		glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
-		renderer.getSSAOBuffer().bind();
-		SSAOData& data = renderer.getSSAOData();
 		Shader& ssaoShader = renderer.getSSAOShader();
 		SSAOAttachments ssaoTex = renderer.getSSAOAttachments();
+		bool halfResolution = settings.ssaoMode == SSAOMode::HalfTemporal;
+		Framebuffer& aoBuffer = halfResolution ? renderer.getSSAOHalfBuffer() : renderer.getSSAOBuffer();
+		aoBuffer.bind();
 
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -184,14 +1067,32 @@ public:
 		ssaoShader.use();
 		int WIDTH = 1600;
 		int HEIGHT = 1200;
-		ssaoShader.setMat4("projection", camera.getProjectionMatrix(WIDTH, HEIGHT, 0.1f, 2500.0f));
-		ssaoShader.setInt("gPositionVS", 0);
-		ssaoShader.setInt("gNormalVS", 1);
+		glm::mat4 projection = camera.getProjectionMatrix(WIDTH, HEIGHT, 0.1f, 2500.0f, true);
+		glm::mat4 view = camera.getViewMatrix();
+		ssaoShader.setMat4("projection", projection);
+		ssaoShader.setMat4("invProjection", glm::inverse(projection));
+		ssaoShader.setMat4("view", view);
+		ssaoShader.setInt("gDepth", 0);
+		ssaoShader.setInt("gNormal", 1);
 		ssaoShader.setInt("texNoise", 2);
-		// send kernel samples to shader
-		for (unsigned int i = 0; i < 64; i++) ssaoShader.setVec3("samples[" + std::to_string(i) + "]", data.kernel[i]);
+
+		// the kernel itself is uploaded once by the renderer, only the subset changes
+		const int kernelSize = (int)renderer.getSSAOData().kernel.size();
+		int sampleCount = halfResolution ? glm::clamp(settings.ssaoSamples, 1, kernelSize) : kernelSize;
+		// rounded down to a power of two, so the strided subsets of the 64 sample kernel cover all of it
+		while (sampleCount & (sampleCount - 1)) sampleCount &= sampleCount - 1;
+		int stride = kernelSize / sampleCount;
+		int slice = ssaoHistory.frame % stride;
+		ssaoShader.setInt("sampleCount", sampleCount);
+		ssaoShader.setInt("sampleStride", stride);
+		ssaoShader.setInt("sampleOffset", halfResolution ? slice : 0);
+		// golden angle steps, the 4x4 noise tile never repeats the same rotation in consecutive frames
+		ssaoShader.setFloat("noiseRotation", halfResolution ? (float)ssaoHistory.frame * 2.39996f : 0.0f);
+		glm::vec2 renderSize((float)renderer.getRenderWidth(), (float)renderer.getRenderHeight());
+		ssaoShader.setVec2("noiseScale", renderSize / (halfResolution ? 8.0f : 4.0f));
+
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, ssaoTex.gPosition);
+		glBindTexture(GL_TEXTURE_2D, ssaoTex.gDepth);
 		glActiveTexture(GL_TEXTURE1);
 		glBindTexture(GL_TEXTURE_2D, ssaoTex.gNormal);
 		glActiveTexture(GL_TEXTURE2);
@@ -199,7 +1100,15 @@ public:
 
 		glBindVertexArray(frameVAO);
 		glDrawArrays(GL_TRIANGLES, 0, 6);
-		renderer.getSSAOBuffer().unbind();
+		aoBuffer.unbind();
+
+		if (halfResolution)
+		{
+			RenderSSAOTemporal(projection, view, frameVAO);
+			stats.ssao.End();
+			return;
+		}
+		ssaoHistory.valid = false;
 
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
@@ -213,128 +1122,290 @@ public:
 		glBindVertexArray(frameVAO);
 		glDrawArrays(GL_TRIANGLES, 0, 6);
 		renderer.getSSAOBlurBuffer().unbind();
+		stats.ssao.End();
 	}
 
-	void RenderPBR(
-		EnvironmentProbeComponent* skyProbe,
-		std::vector<EnvironmentProbeComponent*> IBLProbes,
-		Camera& camera,
-		unsigned int frameVAO
-	)
+	// accumulates the half resolution ao into the history and upsamples it into the texture the lighting reads
+	void RenderSSAOTemporal(const glm::mat4& projection, const glm::mat4& view, unsigned int frameVAO)
 	{
-		Shader& pbr = renderer.getPBRShader();
+		SSAOAttachments ssaoTex = renderer.getSSAOAttachments();
+		int write = ssaoHistory.index;
+		int read = write ^ 1;
+		glm::mat4 viewProjection = projection * view;
 
-		pbr.use();
-		pbr.setVec3("viewPos", camera.getCameraPos());
-		pbr.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-		pbr.setFloat("vsmSize", (float)renderer.getShadowAttachments().shadow_width);
-		float sceneDiameter = orthoSize * 2.0f;
-		float lightWorldDiameter = 0.5f;
-		float lightSizeUV = lightWorldDiameter / sceneDiameter;
-		pbr.setFloat("dirLightSizeUV", lightSizeUV);
+		Shader& temporalShader = renderer.getSSAOTemporalShader();
+		renderer.getSSAOHistoryBuffer(write).bind();
+		temporalShader.use();
+		temporalShader.setInt("ssaoInput", 0);
+		temporalShader.setInt("history", 1);
+		temporalShader.setInt("gDepth", 2);
+		temporalShader.setMat4("invViewProjection", glm::inverse(viewProjection));
+		temporalShader.setMat4("prevViewProjection", ssaoHistory.viewProjection);
+		temporalShader.setMat4("prevView", ssaoHistory.view);
+		temporalShader.setBool("historyValid", ssaoHistory.valid);
+		temporalShader.setFloat("maxFrames", (float)glm::max(settings.ssaoHistoryFrames, 1));
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, renderer.getSSAOHalfTexture().id);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, renderer.getSSAOHistoryTexture(read).id);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, ssaoTex.gDepth);
+		glBindVertexArray(frameVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+
+		Shader& upsampleShader = renderer.getSSAOUpsampleShader();
+		renderer.getSSAOBlurBuffer().bind();
+		upsampleShader.use();
+		upsampleShader.setInt("ssaoInput", 0);
+		upsampleShader.setInt("gDepth", 1);
+		upsampleShader.setInt("gNormal", 2);
+		upsampleShader.setMat4("invProjection", glm::inverse(projection));
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, renderer.getSSAOHistoryTexture(write).id);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, ssaoTex.gDepth);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, ssaoTex.gNormal);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+		renderer.getSSAOBlurBuffer().unbind();
+
+		ssaoHistory.view = view;
+		ssaoHistory.viewProjection = viewProjection;
+		ssaoHistory.index = read;
+		ssaoHistory.valid = true;
+		ssaoHistory.frame++;
+	}
 
-		// texture passes
+	// g-buffer, ssao and the matrix the lighting rebuilds positions with, returns the next free texture unit
+	unsigned int ApplyGBufferUniforms(Shader& shader, Camera& camera)
+	{
+		shader.use();
 		GBufferAttachments gba = renderer.getGAttachments();
 
+		int WIDTH = 1600;
+		int HEIGHT = 1200;
+		glm::mat4 viewProjection = camera.getProjectionMatrix(WIDTH, HEIGHT, 0.1f, 2500.0f, true) * camera.getViewMatrix();
+		shader.setMat4("invViewProjection", glm::inverse(viewProjection));
+
 		unsigned int unit = 0;
-		pbr.setInt("gPosition", unit);
+		shader.setInt("gDepth", unit);
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, gba.gPosition);
+		glBindTexture(GL_TEXTURE_2D, gba.gDepth);
 
-		pbr.setInt("gNormal", ++unit);
+		shader.setInt("gNormal", ++unit);
 		glActiveTexture(GL_TEXTURE0 + unit);
 		glBindTexture(GL_TEXTURE_2D, gba.gNormal);
 
-		pbr.setInt("gAlbedoRoughness", ++unit);
+		shader.setInt("gAlbedoRoughness", ++unit);
 		glActiveTexture(GL_TEXTURE0 + unit);
 		glBindTexture(GL_TEXTURE_2D, gba.gAlbedoRoughness);
 
-		pbr.setInt("gMetallicAO", ++unit);
+		shader.setInt("gMetallicAO", ++unit);
 		glActiveTexture(GL_TEXTURE0 + unit);
 		glBindTexture(GL_TEXTURE_2D, gba.gMetallicAO);
 
-		pbr.setInt("dirVSM", ++unit);
-		glActiveTexture(GL_TEXTURE0 + unit);
-		glBindTexture(GL_TEXTURE_2D, renderer.getShadowMoments().id);
-
-		pbr.setInt("ssaoLUT", ++unit);
+		shader.setInt("ssaoLUT", ++unit);
 		glActiveTexture(GL_TEXTURE0 + unit);
 		glBindTexture(GL_TEXTURE_2D, renderer.getSSAOBlurTexture().id);
+		return ++unit;
+	}
 
-		const GLuint MAX_PROBES = 4;
-		static GLuint placeholderCubemap = createPlaceholderCubemap();
-		static GLuint placeholderTexture = TextureLibrary::GetTexture("White Texture - Default").id;
-
-		std::array<GLuint, MAX_PROBES> irradianceMaps { placeholderCubemap };
-		std::array<GLuint, MAX_PROBES> prefilterMaps { placeholderCubemap };
-		std::array<GLuint, MAX_PROBES> brdfLUTs{ placeholderTexture };
+	// NOTE: classified deferred lighting. A compute pass sorts the 16x16 tiles into sky, no point lights and full
+	// (see tile_classify.comp) and writes one indirect dispatch per category, then each category is lit by its own
+	// variant of deferred_tile.comp straight into hdrScene. Sky tiles are only cleared and the no point light
+	// variant skips the light list walk, so views that are mostly sky or far from the point lights get cheaper.
+	// The light culling has to run before this, the classification reads the tile light counts.
+	void RenderClassifiedLighting(
+		const ProbeTextures& probes,
+		Camera& camera
+	)
+	{
+		GLuint dispatchBuffer = renderer.getLightingDispatchBuffer();
+		int tilesX = renderer.getLightingTilesX();
+		int tilesY = renderer.getLightingTilesY();
+		int listStride = tilesX * tilesY;
 
-		size_t probeCount = IBLProbes.size();
+		// group counts restart at 0, y and z stay 1
+		const GLuint resetArgs[3 * LIGHTING_TILE_CATEGORIES] = { 0, 1, 1, 0, 1, 1, 0, 1, 1 };
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, dispatchBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(resetArgs), resetArgs);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, renderer.getLightingTileListBuffer());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, dispatchBuffer);
 
-		int nextSlot = 0;
+		Shader& classify = renderer.getTileClassifyShader();
+		classify.use();
+		classify.setInt("gDepth", 0);
+		classify.setInt("listStride", listStride);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, renderer.getGDepth().id);
+		glDispatchCompute(tilesX, tilesY, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
 
-		// add sky probe first
-		if (skyProbe)
+		Texture& hdr = renderer.getHDRSceneTex();
+		glBindImageTexture(0, hdr.id, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, dispatchBuffer);
+		for (int category = 0; category < LIGHTING_TILE_CATEGORIES; category++)
 		{
-			pbr.setVec4("probeData[0]", glm::vec4(skyProbe->position, skyProbe->radius));
-			irradianceMaps[0] = skyProbe->maps.irradianceMap;
-			prefilterMaps[0] = skyProbe->maps.prefilterMap;
-			brdfLUTs[0] = skyProbe->maps.brdfLUT;
-			probeCount++;
+			Shader& shader = renderer.getLightingTileShader(category);
+			if (category != LIGHTING_TILE_SKY)
+			{
+				unsigned int unit = ApplyGBufferUniforms(shader, camera);
+				ApplyLightingUniforms(shader, probes, camera, unit);
+			}
+			shader.use();
+			shader.setInt("listStride", listStride);
+			glDispatchComputeIndirect(sizeof(GLuint) * 3 * category);
 		}
-		else pbr.setVec4("probeData[0]", glm::vec4(FLT_MAX));
-		
-		nextSlot = 1;
+		glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+	}
 
-		for (size_t i = 0; i < IBLProbes.size() && i < MAX_PROBES - 1; i++)
+	void RenderPBR(
+		const ProbeTextures& probes,
+		Camera& camera,
+		unsigned int frameVAO
+	)
+	{
+		stats.shading.Begin();
+		if (settings.lightingPath == LightingPath::ClassifiedTiles)
 		{
-			auto* p = IBLProbes[i];
+			RenderClassifiedLighting(probes, camera);
+			stats.shading.End();
+			return;
+		}
 
-			irradianceMaps[nextSlot] = p->maps.irradianceMap;
-			prefilterMaps[nextSlot] = p->maps.prefilterMap;
-			brdfLUTs[nextSlot] = p->maps.brdfLUT;
+		Shader& pbr = renderer.getPBRShader();
+		unsigned int unit = ApplyGBufferUniforms(pbr, camera);
+		ApplyLightingUniforms(pbr, probes, camera, unit);
 
-			pbr.setVec4("probeData[" + std::to_string(nextSlot) + "]", glm::vec4(p->position, p->radius));
-			nextSlot++;
-		}
+		glBindVertexArray(frameVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+		stats.shading.End();
+	}
 
-		pbr.setInt("probeCount", nextSlot);
-		
-		GLuint firstUnit = ++unit;
+	// NOTE: forward+ path. A depth prepass fills the multisampled depth first, so the shading pass runs the material
+	// and the lighting once per covered pixel. Lights come from the same tile lists the deferred pass reads (the
+	// light system has to be configured for the forward shaders). Color and depth are resolved into hdrScene and gDepth
+	// so bloom, tonemapping and the composite stay shared. The pbr and terrain materials have their own forward
+	// variants, every other material is shaded by the default one. There is no ssao since nothing writes normals.
+	void RenderForward(
+		SceneEntityRegistry& sceneRegistry,
+		TransformManager& transformManager,
+		ShaderManager& shaderManager,
+		AssetManager& assetManager,
+		LandscapeManager& landscapeManager,
+		MaterialsGroupManager& materialsGroupManager,
+		const ProbeTextures& probes,
+		Camera& camera
+	)
+	{
+		if (renderer.getForwardSamples() != settings.msaaSamples) renderer.SetForwardSamples(settings.msaaSamples);
+		ForwardAttachments fa = renderer.getForwardAttachments();
+		// no velocity buffer here, the resolve falls back to camera reprojection
+		prevModels.clear();
 
-		pbr.setSamplerArray("irradianceMap[0]",
-			std::vector<GLuint>(irradianceMaps.begin(), irradianceMaps.end()),
-			firstUnit,
-			GL_TEXTURE_CUBE_MAP);
+		int WIDTH = 1600;
+		int HEIGHT = 1200;
+		glm::mat4 view = camera.getViewMatrix();
+		glm::mat4 projection = camera.getProjectionMatrix(WIDTH, HEIGHT, 0.1f, 2500.0f, true);
+		int renderWidth = renderer.getRenderWidth();
+		int renderHeight = renderer.getRenderHeight();
 
-		firstUnit += MAX_PROBES;
+		auto drawScene = [&](bool prepass)
+			{
+				for (Entity entity : sceneRegistry.GetAll())
+				{
+					ShaderComponent* shaderComp = shaderManager.GetComponent(entity);
+					TransformComponent* transformComp = transformManager.GetComponent(entity);
+					MaterialsGroupComponent* materialsGroupComp = materialsGroupManager.GetComponent(entity);
 
-		pbr.setSamplerArray("prefilterMap[0]",
-			std::vector<GLuint>(prefilterMaps.begin(), prefilterMaps.end()),
-			firstUnit,
-			GL_TEXTURE_CUBE_MAP);
+					if (!transformComp || !shaderComp || !materialsGroupComp)
+						continue;
 
-		firstUnit += MAX_PROBES;
+					Shader* shader = GetForwardShader(*shaderComp, fa);
+					if (prepass) shader = &fa.prepassShader;
 
-		pbr.setSamplerArray("brdfLUT[0]",
-			std::vector<GLuint>(brdfLUTs.begin(), brdfLUTs.end()),
-			firstUnit,
-			GL_TEXTURE_2D);
+					glm::mat4 model = GetModelMatrix(*transformComp);
+					shader->use();
+					shader->setMat4("model", model);
+					shader->setMat4("view", view);
+					shader->setMat4("projection", projection);
 
-		glBindVertexArray(frameVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+					AssetComponent* assetComp = assetManager.GetComponent(entity);
+					if (assetComp)
+					{
+						Asset& asset = AssetLibrary::GetAsset(assetComp->assetName);
+						int lod = SelectLOD(asset, model, camera, settings.lodBias);
+						for (auto& group : materialsGroupComp->materialsGroup)
+						{
+							if (shader == &fa.defaultShader) shader->setFloat("tintStrength", 0.0f);
+							if (!prepass) group.material.ApplyShaderUniforms(*shader);
+							for (size_t index : group.assetPartsIndices)
+								asset.parts[index].mesh.Draw(*shader, lod);
+						}
+						continue;
+					}
+
+					LandscapeComponent* landComp = landscapeManager.GetLandscapeComponent(entity);
+					HeightGenComponent* genComp = landscapeManager.GetHeightGenComponent(entity);
+
+					if (!landComp || !genComp) continue;
+					for (auto& group : materialsGroupComp->materialsGroup)
+					{
+						if (!prepass) group.material.ApplyShaderUniforms(*shader);
+						landComp->terrain->Render(*shader, camera, model);
+					}
+				}
+			};
+
+		fa.forwardBuffer.bind();
+		glEnable(GL_DEPTH_TEST);
+		glEnable(GL_MULTISAMPLE);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		stats.geometry.Begin();
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LESS);
+		drawScene(true);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		stats.geometry.End();
+
+		stats.shading.Begin();
+		// material textures start at unit 0, the lighting inputs go above them
+		const unsigned int lightingUnit = 8;
+		ApplyLightingUniforms(fa.pbrShader, probes, camera, lightingUnit);
+		ApplyLightingUniforms(fa.terrainShader, probes, camera, lightingUnit);
+		ApplyLightingUniforms(fa.defaultShader, probes, camera, lightingUnit);
+
+		// same vertex stages as the prepass with an invariant position, so only the front surface passes
+		glDepthMask(GL_FALSE);
+		glDepthFunc(GL_LEQUAL);
+		drawScene(false);
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LESS);
+
+		// resolve, the targets match the formats of the multisampled buffers
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, fa.forwardBuffer.FBO);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, renderer.getHDRBuffer().FBO);
+		glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, renderer.getGBuffer().FBO);
+		glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		stats.shading.End();
 	}
 
 	void RenderDeferredBrightness(unsigned int frameVAO)
 	{
 		Framebuffer& brightBuf = renderer.getBrightnessBuffer();
 		Shader& brightShader = renderer.getBrightnessShader();
-		Texture& tex = renderer.getHDRSceneTex();
+		Texture& tex = GetSceneColor();
 
 		brightBuf.bind();
 		brightShader.use();
 		brightShader.setInt("hdrScene", 0);
-		brightShader.setFloat("threshold", 0.5f);
+		brightShader.setFloat("threshold", settings.bloomThreshold);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, tex.id);
 		glBindVertexArray(frameVAO);
@@ -364,21 +1435,293 @@ public:
 		}
 	}
 
+	// NOTE: progressive bloom. The hdr scene is downsampled through the mip chain with the 13 tap filter (the first
+	// level also thresholds), then every level is tent upsampled and added onto the next larger one. Most of the
+	// work runs at 1/4 resolution and below, and the radius covers the whole chain instead of 10 blur passes.
+	void RenderBloomMipChain(unsigned int frameVAO)
+	{
+		glBindVertexArray(frameVAO);
+		glActiveTexture(GL_TEXTURE0);
+
+		Shader& down = renderer.getBloomDownsampleShader();
+		down.use();
+		down.setInt("source", 0);
+		down.setFloat("threshold", settings.bloomThreshold);
+		down.setFloat("knee", settings.bloomKnee);
+		for (int i = 0; i < BLOOM_MIPS; i++)
+		{
+			renderer.getBloomMipBuffer(i).bind();
+			down.setBool("prefilter", i == 0);
+			glBindTexture(GL_TEXTURE_2D, i == 0 ? GetSceneColor().id : renderer.getBloomMipTex(i - 1).id);
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+		}
+
+		Shader& up = renderer.getBloomUpsampleShader();
+		up.use();
+		up.setInt("source", 0);
+		up.setFloat("radius", settings.bloomRadius);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+		for (int i = BLOOM_MIPS - 2; i >= 0; i--)
+		{
+			renderer.getBloomMipBuffer(i).bind();
+			glBindTexture(GL_TEXTURE_2D, renderer.getBloomMipTex(i + 1).id);
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+		}
+		glDisable(GL_BLEND);
+		renderer.getBloomMipBuffer(0).unbind();
+	}
+
+	// jittered render resolution scene into the screen sized history and output, see taa_resolve.frag
+	void RenderTemporalResolve(Camera& camera, unsigned int frameVAO)
+	{
+		if (!taa.active) return;
+
+		stats.taa.Begin();
+		int write = taa.index;
+		int read = write ^ 1;
+		int WIDTH = 1600;
+		int HEIGHT = 1200;
+		glm::mat4 viewProjection = camera.getProjectionMatrix(WIDTH, HEIGHT, 0.1f, 2500.0f, true) * camera.getViewMatrix();
+		GBufferAttachments gba = renderer.getGAttachments();
+
+		renderer.getTAABuffer(write).bind();
+		Shader& resolve = renderer.getTAAShader();
+		resolve.use();
+		resolve.setInt("sceneColor", 0);
+		resolve.setInt("gDepth", 1);
+		resolve.setInt("gVelocity", 2);
+		resolve.setInt("history", 3);
+		resolve.setVec2("renderSize", glm::vec2((float)renderer.getRenderWidth(), (float)renderer.getRenderHeight()));
+		resolve.setVec2("outputSize", glm::vec2((float)renderer.getScreenWidth(), (float)renderer.getScreenHeight()));
+		resolve.setVec2("jitter", taa.jitter);
+		resolve.setMat4("invViewProjection", glm::inverse(viewProjection));
+		resolve.setMat4("prevViewProjection", taa.prevViewProjection);
+		// forward+ does not write the g-buffer colors
+		resolve.setBool("useVelocity", settings.shadingPath == ShadingPath::Deferred);
+		resolve.setBool("historyValid", taa.valid);
+		resolve.setFloat("feedback", glm::clamp(settings.taaFeedback, 0.0f, 0.98f));
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, renderer.getHDRSceneTex().id);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, gba.gDepth);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, gba.gVelocity);
+		glActiveTexture(GL_TEXTURE3);
+		glBindTexture(GL_TEXTURE_2D, renderer.getTAAHistoryTex(read).id);
+		glBindVertexArray(frameVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+		renderer.getTAABuffer(write).unbind();
+
+		taa.index = read;
+		taa.valid = true;
+		stats.taa.End();
+	}
+
+	// NOTE: histogram based auto exposure. The histogram pass bins the log luminance of hdrScene and the exposure
+	// pass adapts towards its trimmed average, both stay on the gpu and the post passes read the result from the
+	// 1x1 exposure texture, so there is no readback.
+	void RenderAutoExposure(float deltaTime)
+	{
+		Texture& exposureTex = renderer.getExposureTex();
+		if (!settings.autoExposure)
+		{
+			if (exposureAdapted)
+			{
+				float neutral[2] = { 1.0f, 0.0f };
+				glClearTexImage(exposureTex.id, 0, GL_RG, GL_FLOAT, neutral);
+				exposureAdapted = false;
+			}
+			return;
+		}
+
+		stats.exposure.Begin();
+		Texture& hdr = GetSceneColor();
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, renderer.getHistogramBuffer());
+
+		Shader& histogram = renderer.getHistogramShader();
+		histogram.use();
+		histogram.setInt("hdrScene", 0);
+		histogram.setFloat("minLogLum", settings.exposureMinLogLum);
+		histogram.setFloat("invLogLumRange", 1.0f / glm::max(settings.exposureLogLumRange, 0.01f));
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, hdr.id);
+		glDispatchCompute((hdr.width + 15) / 16, (hdr.height + 15) / 16, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		Shader& adapt = renderer.getAutoExposureShader();
+		adapt.use();
+		adapt.setFloat("minLogLum", settings.exposureMinLogLum);
+		adapt.setFloat("logLumRange", settings.exposureLogLumRange);
+		adapt.setFloat("lowPercentile", settings.exposureLowPercentile);
+		adapt.setFloat("highPercentile", glm::max(settings.exposureHighPercentile, settings.exposureLowPercentile));
+		adapt.setFloat("deltaTime", deltaTime);
+		adapt.setFloat("adaptationSpeed", settings.exposureAdaptationSpeed);
+		adapt.setFloat("keyValue", settings.exposureKey);
+		adapt.setFloat("minEV", settings.exposureMinEV);
+		adapt.setFloat("maxEV", settings.exposureMaxEV);
+		adapt.setBool("resetHistory", !exposureAdapted);
+		glBindImageTexture(0, exposureTex.id, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RG32F);
+		glDispatchCompute(1, 1, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		exposureAdapted = true;
+		stats.exposure.End();
+	}
+
+	// blurred bright parts of the scene, added on top of it by the post chain
 	void RenderBloom(unsigned int frameVAO)
 	{
-		renderer.getHDRBuffer().bind();
+		if (!settings.bloomEnabled) return;
+
+		stats.bloom.Begin();
+		if (settings.bloomMode == BloomMode::DualFilter) RenderBloomMipChain(frameVAO);
+		else
+		{
+			RenderDeferredBrightness(frameVAO);
+			RenderBlur(frameVAO);
+		}
+		stats.bloom.End();
+	}
+
+	// tonemapping, sky and the custom pass, fused into one pass unless the separate chain is selected
+	void RenderPostChain(EnvironmentProbeComponent* skyProbe, Camera& camera, bool celShading, unsigned int frameVAO)
+	{
+		stats.post.Begin();
+		if (!colorLUTBaked || std::memcmp(&bakedGrading, &settings.grading, sizeof(ColorGrading)) != 0) BakeColorLUTs();
+		bool separate = settings.postChain == PostChain::Separate;
+		renderer.SetPostIntermediates(separate);
+		if (separate)
+		{
+			if (settings.bloomEnabled) RenderBloomCombine(frameVAO);
+			RenderTonemap(frameVAO);
+			RenderComposite(skyProbe, camera, frameVAO);
+			RenderPostProcess(frameVAO);
+		}
+		else RenderPostFused(skyProbe, camera, celShading, frameVAO);
+		stats.post.End();
+	}
+
+	// tonemap curves, grading and gamma baked into the 32^3 luts the final passes sample once per pixel
+	void BakeColorLUTs()
+	{
+		const ColorGrading& g = settings.grading;
+		Shader& bake = renderer.getLUTBakeShader();
+		bake.use();
+		bake.setFloat("exposure", g.exposure);
+		bake.setFloat("contrast", g.contrast);
+		bake.setFloat("saturation", g.saturation);
+		bake.setVec3("colorFilter", g.colorFilter);
+		bake.setVec3("lift", g.lift);
+		bake.setVec3("gamma", glm::max(g.gamma, glm::vec3(0.01f)));
+		bake.setVec3("gain", g.gain);
+		bake.setFloat("displayGamma", glm::max(g.displayGamma, 0.01f));
+
+		glBindImageTexture(0, renderer.getFilmicLUT().id, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		glBindImageTexture(1, renderer.getReinhardLUT().id, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		const int groups = (COLOR_LUT_SIZE + 3) / 4;
+		glDispatchCompute(groups, groups, groups);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		bakedGrading = g;
+		colorLUTBaked = true;
+	}
+
+	// the lut and the exposure it is sampled with (see color_lut.glsl)
+	void BindColorLUT(Shader& shader, const char* name, const Texture3D& lut, int unit, int exposureUnit)
+	{
+		shader.setInt(name, unit);
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_3D, lut.id);
+		shader.setInt("exposureTex", exposureUnit);
+		glActiveTexture(GL_TEXTURE0 + exposureUnit);
+		glBindTexture(GL_TEXTURE_2D, renderer.getExposureTex().id);
+	}
+
+	GLuint GetBloomTexture()
+	{
+		return settings.bloomMode == BloomMode::DualFilter ? renderer.getBloomMipTex(0).id : renderer.getBlurHorizontalTex().id;
+	}
+
+	float GetBloomScale() const
+	{
+		// the mip chain adds up every level
+		return settings.bloomMode == BloomMode::DualFilter ? settings.bloomIntensity / BLOOM_MIPS : 1.0f;
+	}
+
+	void RenderBloomCombine(unsigned int frameVAO)
+	{
+		Framebuffer& target = taa.active ? renderer.getTAASceneBuffer() : renderer.getHDRBuffer();
+		target.bind();
 		Shader& bloomShader = renderer.getBloomShader();
 		bloomShader.use();
 		bloomShader.setInt("hdrScene", 0);
 		bloomShader.setInt("blurBuffer", 1);
-		bloomShader.setFloat("exposure", 0.8f);
+		bloomShader.setFloat("exposure", settings.bloomExposure);
+		bloomShader.setFloat("bloomScale", GetBloomScale());
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, renderer.getHDRSceneTex().id);
+		glBindTexture(GL_TEXTURE_2D, GetSceneColor().id);
 		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, renderer.getBlurHorizontalTex().id);
+		glBindTexture(GL_TEXTURE_2D, GetBloomTexture());
 		glBindVertexArray(frameVAO);
 		glDrawArrays(GL_TRIANGLES, 0, 6);
-		renderer.getHDRBuffer().unbind();
+		target.unbind();
+	}
+
+	// bloom combine, tonemap, sky and cel shading in one pass (post_uber.frag) straight into the output target
+	void RenderPostFused(EnvironmentProbeComponent* skyProbe, Camera& camera, bool celShading, unsigned int frameVAO)
+	{
+		unsigned int stages = 0;
+		if (settings.bloomEnabled) stages |= POST_BLOOM;
+		if (skyProbe) stages |= POST_SKY;
+		// forward+ leaves no albedo behind to cel shade against
+		if (celShading && settings.shadingPath == ShadingPath::Deferred) stages |= POST_CEL_SHADING;
+
+		renderer.getPPBuffer().bind();
+		Shader& post = renderer.getPostShader(stages);
+		post.use();
+		post.setInt("hdrScene", 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, GetSceneColor().id);
+		BindColorLUT(post, "filmicLUT", renderer.getFilmicLUT(), 5, 7);
+		BindColorLUT(post, "reinhardLUT", renderer.getReinhardLUT(), 6, 7);
+
+		if (stages & POST_BLOOM)
+		{
+			post.setInt("bloomTexture", 1);
+			post.setFloat("bloomScale", GetBloomScale());
+			post.setFloat("bloomExposure", settings.bloomExposure);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, GetBloomTexture());
+		}
+
+		post.setInt("sceneDepth", 2);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, renderer.getGDepth().id);
+
+		if (stages & POST_SKY)
+		{
+			int WIDTH = 1600;
+			int HEIGHT = 1200;
+			// the sky is drawn at the resolved output, without the jitter
+			glm::mat4 projection = camera.getProjectionMatrix(WIDTH, HEIGHT, 0.1f, 2500.0f);
+			glm::mat4 viewNoTrans = glm::mat4(glm::mat3(camera.getViewMatrix()));
+			post.setMat4("invProjection", glm::inverse(projection));
+			post.setMat4("invView", glm::inverse(viewNoTrans));
+			post.setInt("skybox", 3);
+			glActiveTexture(GL_TEXTURE3);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, skyProbe->maps.envMap);
+		}
+
+		if (stages & POST_CEL_SHADING)
+		{
+			post.setInt("gAlbedoRoughness", 4);
+			glActiveTexture(GL_TEXTURE4);
+			glBindTexture(GL_TEXTURE_2D, renderer.getGAttachments().gAlbedoRoughness);
+		}
+
+		glBindVertexArray(frameVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+		renderer.getPPBuffer().unbind();
 	}
 
 	void RenderTonemap(unsigned int frameVAO)
@@ -387,9 +1730,9 @@ public:
 		Shader& tonemap = renderer.getTonemapShader();
 		tonemap.use();
 		tonemap.setInt("hdrScene", 0);
-		tonemap.setFloat("exposure", 0.8f);
+		BindColorLUT(tonemap, "filmicLUT", renderer.getFilmicLUT(), 1, 2);
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, renderer.getHDRSceneTex().id);
+		glBindTexture(GL_TEXTURE_2D, GetSceneColor().id);
 		glBindVertexArray(frameVAO);
 		glDrawArrays(GL_TRIANGLES, 0, 6);
 		renderer.getTonemapBuffer().unbind();
@@ -415,6 +1758,7 @@ public:
 		compositeShader.setInt("tonemappedScene", 0);
 		compositeShader.setInt("sceneDepth", 1);
 		compositeShader.setInt("skybox", 2);
+		BindColorLUT(compositeShader, "reinhardLUT", renderer.getReinhardLUT(), 3, 4);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, renderer.getTonemapSceneTex().id);
 		glActiveTexture(GL_TEXTURE1);
@@ -438,7 +1782,6 @@ public:
 		glClearColor(0.0, 0.0, 0.0, 0.0);
 		glClear(GL_COLOR_BUFFER_BIT);
 		ppShader.use();
-		ppShader.setInt("gPosition", 0);
 		ppShader.setInt("gNormal", 1);
 		ppShader.setInt("gAlbedoRoughness", 2);
 		ppShader.setInt("gMetallicAO", 3);
@@ -448,8 +1791,8 @@ public:
 		ppShader.setInt("brightPass", 7);
 		ppShader.setInt("bloomPass", 8);
 		ppShader.setInt("compositePass", 9);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, gba.gPosition);
+		ppShader.setBool("gBufferValid", settings.shadingPath == ShadingPath::Deferred);
+		BindColorLUT(ppShader, "reinhardLUT", renderer.getReinhardLUT(), 10, 11);
 		glActiveTexture(GL_TEXTURE1);
 		glBindTexture(GL_TEXTURE_2D, gba.gNormal);
 		glActiveTexture(GL_TEXTURE2);
@@ -457,9 +1800,9 @@ public:
 		glActiveTexture(GL_TEXTURE3);
 		glBindTexture(GL_TEXTURE_2D, gba.gMetallicAO);
 		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, renderer.getGDepth().id);
+		glBindTexture(GL_TEXTURE_2D, gba.gDepth);
 		glActiveTexture(GL_TEXTURE5);
-		glBindTexture(GL_TEXTURE_2D, lba.hdrScene);
+		glBindTexture(GL_TEXTURE_2D, GetSceneColor().id);
 		glActiveTexture(GL_TEXTURE6);
 		glBindTexture(GL_TEXTURE_2D, lba.tonemappedScene);
 		glActiveTexture(GL_TEXTURE7);
@@ -473,7 +1816,7 @@ public:
 		renderer.getPPBuffer().unbind();
 	}
 
-	void RenderBufferPass(unsigned int frameVAO)
+	void RenderBufferPass(Camera& camera, unsigned int frameVAO)
 	{
 		renderer.getDebugBuffer().bind();
 		GBufferAttachments gba = renderer.getGAttachments();
@@ -481,12 +1824,16 @@ public:
 		glClearColor(0.0, 0.0, 0.0, 0.0);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		debugBufferShader.use();
-		debugBufferShader.setInt("gPosition", 0);
+		int WIDTH = 1600;
+		int HEIGHT = 1200;
+		glm::mat4 viewProjection = camera.getProjectionMatrix(WIDTH, HEIGHT, 0.1f, 2500.0f, true) * camera.getViewMatrix();
+		debugBufferShader.setMat4("invViewProjection", glm::inverse(viewProjection));
+		debugBufferShader.setInt("gDepth", 0);
 		debugBufferShader.setInt("gNormal", 1);
 		debugBufferShader.setInt("gAlbedoRoughness", 2);
 		debugBufferShader.setInt("gMetallicAO", 3);
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, gba.gPosition);
+		glBindTexture(GL_TEXTURE_2D, gba.gDepth);
 		glActiveTexture(GL_TEXTURE1);
 		glBindTexture(GL_TEXTURE_2D, gba.gNormal);
 		glActiveTexture(GL_TEXTURE2);
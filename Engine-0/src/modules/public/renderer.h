@@ -4,23 +4,87 @@
 #include "texture.h"
 #include "utils.h"
 #include "loaders.h"
+#include "point_shadow_atlas.h"
 
+// positions are reconstructed from gDepth, gNormal holds the octahedral encoded world normal
 struct GBufferAttachments
 {
-	unsigned int gPosition;
 	unsigned int gNormal;
 	unsigned int gAlbedoRoughness;
 	unsigned int gMetallicAO;
-	unsigned int gPositionVS;
-	unsigned int gNormalVS;
+	unsigned int gDepth;
+	unsigned int gVelocity;		// RG16F screen space motion in uv units
+};
+
+const int MAX_SHADOW_CASCADES = 4;
+
+// dual filter bloom levels, 1/2 down to 1/64 of the screen
+const int BLOOM_MIPS = 6;
+
+// edge length of the baked color luts, matches LUT_SIZE in color_lut.glsl
+const int COLOR_LUT_SIZE = 32;
+
+// log luminance histogram of the auto exposure, matches HISTOGRAM_BINS in the compute shaders
+const int LUMINANCE_HISTOGRAM_BINS = 256;
+
+// compile time stages of the fused post pass (post_uber.frag)
+enum PostStage : unsigned int
+{
+	POST_BLOOM = 1 << 0,
+	POST_SKY = 1 << 1,
+	POST_CEL_SHADING = 1 << 2
+};
+
+// categories of the classified deferred lighting, matches tile_classify.comp
+enum LightingTileCategory : int
+{
+	LIGHTING_TILE_SKY,				// no geometry, cleared
+	LIGHTING_TILE_NO_POINT_LIGHTS,	// directional light, shadows and ibl only
+	LIGHTING_TILE_FULL,
+	LIGHTING_TILE_CATEGORIES
+};
+
+// edge length of the classification tiles, the local size of the classified lighting shaders
+const int LIGHTING_TILE_SIZE = 16;
+
+// material depth is a 16 bit unorm, id 0 is empty
+const int MAX_VISIBILITY_DRAWS = 65534;
+
+struct VisibilityBufferAttachments
+{
+	Framebuffer& visibilityBuffer;	// visibility ids + gDepth
+	Framebuffer& resolveBuffer;		// g-buffer colors + material depth
+	Shader& visibilityShader;
+	Shader& materialDepthShader;
+	Shader& resolveShader;
+	unsigned int visibility;		// RG32UI, x = draw id + 1, y = primitive id
+	unsigned int materialDepth;
 };
 
 struct ShadowBufferAttachments
 {
 	Framebuffer& shadowBuffer;
 	Shader& shadowShader;
+	TextureArray& moments;		// one layer per cascade
+	Framebuffer& staticBuffer;	// static caster cache, composited under the dynamic casters every frame
+	TextureArray& staticMoments;
+	TextureArray& staticDepth;
+	Texture& depth;
+	TextureArray& blurTemp;		// single layer, intermediate of the separable blur
+	Shader& blurShader;
 	unsigned int shadow_width;
 	unsigned int shadow_height;
+	int cascadeCount;
+};
+
+struct ForwardAttachments
+{
+	Framebuffer& forwardBuffer;	// multisampled hdr color and depth, resolved into hdrScene and gDepth
+	Shader& prepassShader;		// depth only, same vertex stages as the shading shaders
+	Shader& pbrShader;			// forward variants of the g-buffer material shaders
+	Shader& terrainShader;
+	Shader& defaultShader;		// default and tinted materials, and any material without a forward variant
+	int samples;
 };
 
 struct LBufferAttachments
@@ -53,7 +117,7 @@ struct DebugAttachments
 
 struct SSAOAttachments
 {
-	unsigned int gPosition;
+	unsigned int gDepth;
 	unsigned int gNormal;
 	unsigned int ssaoNoiseTex;
 	unsigned int ssaoColor;
@@ -64,13 +128,32 @@ class Renderer
 private:
 	// Gbuffer pass
 	Framebuffer gBuffer;
-	Texture gPosition, gNormal, gAlbedoRoughness, gMetallicAO, gPositionVS, gNormalVS, gDepth;
+	Texture gNormal, gAlbedoRoughness, gMetallicAO, gDepth, gVelocity;
+
+	// Visibility buffer pass, resolved into the g-buffer colors
+	Framebuffer visibilityBuffer, visResolveBuffer;
+	Shader visibilityShader, materialDepthShader, visResolveShader;
+	Texture visibilityTex, materialDepth;
 
 	// Shadow pass
 	Framebuffer shadowBuffer;
 	Shader dirShadowDepthShader;
-	Texture momentsTex;
-	unsigned int shadow_width = 1028, shadow_height = 1028;
+	TextureArray momentsTex;
+	Texture shadowDepth;
+	Framebuffer staticShadowBuffer;
+	TextureArray staticMomentsTex, staticDepthTex;
+	TextureArray shadowBlurTemp;
+	Shader shadowBlurShader;
+	GLenum shadowMomentFormat = GL_RG32F;
+	// 4 x 1024^2 cascades use the same memory as a single 2048^2 map
+	unsigned int shadow_width = 1024, shadow_height = 1024;
+	int shadow_cascades = MAX_SHADOW_CASCADES;
+
+	// Point light shadows, cube faces packed into one depth atlas
+	Framebuffer pointShadowBuffer;
+	Shader pointShadowShader;
+	Texture pointShadowAtlas;
+	GLuint pointShadowSSBO = 0;
 
 	// SSAO pass
 	Framebuffer ssaoBuffer, ssaoBlurBuffer;
@@ -78,74 +161,140 @@ private:
 	Texture ssaoColor, ssaoBlurColor, ssaoNoiseTexture;
 	SSAOData ssaoData;
 
+	// Half resolution SSAO, accumulated over frames and upsampled into ssaoBlurColor
+	Framebuffer ssaoHalfBuffer, ssaoHistoryBuffers[2];
+	Shader ssaoTemporalShader, ssaoUpsampleShader;
+	Texture ssaoHalfColor, ssaoHistory[2];
+
+	// Forward+ pass
+	Framebuffer forwardBuffer;
+	Shader forwardPrepassShader;
+	Shader forwardPBRShader, forwardTerrainShader, forwardDefaultShader;
+	int forward_samples = 0;
+	int screen_width = 0, screen_height = 0;
+	int render_width = 0, render_height = 0;	// scene passes, below the screen size when upsampled
+	float render_scale = 1.0f;
+
+	// Temporal resolve, the history ping-pongs and the resolved scene is written next to it
+	Framebuffer taaBuffers[2], taaSceneBuffer;
+	Texture taaHistory[2], taaScene;
+	Shader taaShader;
+	bool temporal_targets = false;
+
+	// Color luts (tonemap, grading, gamma), baked when the grading changes
+	Texture3D filmicLUT, reinhardLUT;
+	Shader lutBakeShader;
+
+	// Auto exposure, the histogram and the adapted exposure never leave the gpu
+	GLuint histogramSSBO = 0;
+	Texture exposureTex;		// 1x1 RG32F, exposure multiplier and adapted log luminance
+	Shader histogramShader, autoExposureShader;
+
+	// Fused post pass, one program per stage combination
+	std::unordered_map<unsigned int, Shader> postShaders;
+	bool post_intermediates = false;
+
+	// Classified lighting, one tile list per category and their indirect dispatch arguments
+	GLuint lightingTileListSSBO = 0;
+	GLuint lightingDispatchBuffer = 0;
+	int lighting_tiles_x = 0, lighting_tiles_y = 0;
+	Shader tileClassifyShader;
+	Shader lightingTileShaders[LIGHTING_TILE_CATEGORIES];
+
 	// Lighting pass
 	Framebuffer hdrBuffer, brightnessBuffer, bloomPingBuffer, bloomPongBuffer, tonemapperBuffer, compositeBuffer, postprocessBuffer;
 	Shader pbrBufferShader, brightPassShader, blurShader, bloomShader, tonemapShader, compositeShader, ppShader;
 	Texture hdrScene, brightnessPass, blurHorizontal, blurVertical, tonemappedScene, compositeScene, ppScene;
 
+	// Dual filter bloom, level i is 1 / 2^(i + 1) of the screen
+	Framebuffer bloomMipBuffers[BLOOM_MIPS];
+	Texture bloomMips[BLOOM_MIPS];
+	Shader bloomDownsampleShader, bloomUpsampleShader;
+
 	// Debug pass
 	Framebuffer debugBuffer;
 	Shader debugShader;
 	Texture debugPosition, debugNormal, debugAlbedo, debugMetallic, debugRoughness, debugAO;
 
-public:
-	void Initialize(int width, int height)
+	// NOTE: targets of the scene passes (g-buffer, visibility, ssao, lighting), sized by the render scale. Everything
+	// after the temporal resolve runs at the output size. Framebuffers only own the texture attached last, so the
+	// old framebuffers are released first and the remaining textures deleted before anything new is generated
+	// (a freed name can be handed out again right away).
+	void CreateSceneTargets(int width, int height)
 	{
+		if (gBuffer.FBO)
+		{
+			GLuint textures[] = {
+				gNormal.id, gAlbedoRoughness.id, gMetallicAO.id, gVelocity.id, gDepth.id, visibilityTex.id, materialDepth.id,
+				ssaoColor.id, ssaoBlurColor.id, ssaoHalfColor.id, ssaoHistory[0].id, ssaoHistory[1].id, hdrScene.id
+			};
+			gBuffer = Framebuffer();
+			visibilityBuffer = Framebuffer();
+			visResolveBuffer = Framebuffer();
+			ssaoBuffer = Framebuffer();
+			ssaoBlurBuffer = Framebuffer();
+			ssaoHalfBuffer = Framebuffer();
+			ssaoHistoryBuffers[0] = Framebuffer();
+			ssaoHistoryBuffers[1] = Framebuffer();
+			hdrBuffer = Framebuffer();
+			forwardBuffer = Framebuffer();
+			forward_samples = 0;
+			glDeleteTextures(sizeof(textures) / sizeof(GLuint), textures);
+		}
+		render_width = width;
+		render_height = height;
+
 		// G-Buffer
 		gBuffer = Framebuffer(width, height);
-		// position color buffer
-		gPosition = Texture(width, height, GL_RGBA16F, GL_RGBA);
-		gPosition.setTexFilter(GL_NEAREST);
-		gBuffer.attachTexture2D(gPosition, GL_COLOR_ATTACHMENT0);
-		// normal color buffer
-		gNormal = Texture(width, height, GL_RGBA16F, GL_RGBA);
+		// 14 bytes per pixel with depth, positions are rebuilt from gDepth
+		// octahedral world normal
+		gNormal = Texture(width, height, GL_RG16, GL_RG);
 		gNormal.setTexFilter(GL_NEAREST);
-		gBuffer.attachTexture2D(gNormal, GL_COLOR_ATTACHMENT1);
+		gBuffer.attachTexture2D(gNormal, GL_COLOR_ATTACHMENT0);
 		// albedo specular/roughness color buffer
-		gAlbedoRoughness = Texture(width, height, GL_RGBA, GL_RGBA);
+		gAlbedoRoughness = Texture(width, height, GL_RGBA8, GL_RGBA);
 		gAlbedoRoughness.setTexFilter(GL_NEAREST);
-		gBuffer.attachTexture2D(gAlbedoRoughness, GL_COLOR_ATTACHMENT2);
+		gBuffer.attachTexture2D(gAlbedoRoughness, GL_COLOR_ATTACHMENT1);
 		// metallic and ao buffer
 		gMetallicAO = Texture(width, height, GL_RG8, GL_RG);
 		gMetallicAO.setTexFilter(GL_NEAREST);
-		gBuffer.attachTexture2D(gMetallicAO, GL_COLOR_ATTACHMENT3);
-		// view space buffers
-		gPositionVS = Texture(width, height, GL_RGBA16F, GL_RGBA);
-		gPositionVS.setTexFilter(GL_NEAREST);
-		gBuffer.attachTexture2D(gPositionVS, GL_COLOR_ATTACHMENT4);
-		gNormalVS = Texture(width, height, GL_RGBA16F, GL_RGBA);
-		gNormalVS.setTexFilter(GL_NEAREST);
-		gBuffer.attachTexture2D(gNormalVS, GL_COLOR_ATTACHMENT5);
-		// z-buffer
+		gBuffer.attachTexture2D(gMetallicAO, GL_COLOR_ATTACHMENT2);
+		// screen space motion for the temporal resolve
+		gVelocity = Texture(width, height, GL_RG16F, GL_RG, GL_NEAREST, GL_CLAMP_TO_EDGE);
+		gBuffer.attachTexture2D(gVelocity, GL_COLOR_ATTACHMENT3);
+		// z-buffer, kept at 24 bits so it can still be blitted into the lighting buffers
 		gDepth = Texture(width, height, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT);
 		gDepth.setTexFilter(GL_NEAREST);
 		gBuffer.attachTexture2D(gDepth, GL_DEPTH_ATTACHMENT);
 		// texture and renderbuffer attachments
 		gBuffer.bind();
 
-		unsigned int gbuffer_attachments[6] = { 
+		unsigned int gbuffer_attachments[4] = { 
 			GL_COLOR_ATTACHMENT0, 
 			GL_COLOR_ATTACHMENT1, 
-			GL_COLOR_ATTACHMENT2, 
-			GL_COLOR_ATTACHMENT3, 
-			GL_COLOR_ATTACHMENT4, 
-			GL_COLOR_ATTACHMENT5 
+			GL_COLOR_ATTACHMENT2,
+			GL_COLOR_ATTACHMENT3
 		};
-		glDrawBuffers(6, gbuffer_attachments);
+		glDrawBuffers(4, gbuffer_attachments);
+
+		// Visibility buffer, shares the g-buffer depth
+		visibilityBuffer = Framebuffer(width, height);
+		visibilityTex = Texture(width, height, GL_RG32UI, GL_RG_INTEGER);
+		visibilityTex.setTexFilter(GL_NEAREST);
+		visibilityBuffer.attachTexture2D(visibilityTex, GL_COLOR_ATTACHMENT0);
+		visibilityBuffer.attachTexture2D(gDepth, GL_DEPTH_ATTACHMENT);
+		// the resolve writes the same g-buffer colors, draws are separated by an equal test on the material depth
+		visResolveBuffer = Framebuffer(width, height);
+		visResolveBuffer.attachTexture2D(gNormal, GL_COLOR_ATTACHMENT0);
+		visResolveBuffer.attachTexture2D(gAlbedoRoughness, GL_COLOR_ATTACHMENT1);
+		visResolveBuffer.attachTexture2D(gMetallicAO, GL_COLOR_ATTACHMENT2);
+		visResolveBuffer.attachTexture2D(gVelocity, GL_COLOR_ATTACHMENT3);
+		materialDepth = Texture(width, height, GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT);
+		materialDepth.setTexFilter(GL_NEAREST);
+		visResolveBuffer.attachTexture2D(materialDepth, GL_DEPTH_ATTACHMENT);
+		visResolveBuffer.bind();
+		glDrawBuffers(4, gbuffer_attachments);
 
-		// Shadow framebuffer
-		shadowBuffer = Framebuffer(shadow_width, shadow_height);
-		momentsTex = Texture(shadow_width, shadow_height, GL_RG32F, GL_RG);
-		momentsTex.genMipMap();
-		momentsTex.setTexFilter(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
-		momentsTex.setTexWrap(GL_CLAMP_TO_EDGE);
-		shadowBuffer.attachTexture2D(momentsTex, GL_COLOR_ATTACHMENT0);
-		
-		shadowBuffer.bind();
-		shadowBuffer.attachRenderbuffer(GL_DEPTH_COMPONENT24, GL_DEPTH_ATTACHMENT);
-		unsigned int shadow_attachments[1] = { GL_COLOR_ATTACHMENT0 }; // in case of adding more
-		glDrawBuffers(1, shadow_attachments);
-		 
 		// SSAO framebuffer
 		ssaoBuffer = Framebuffer(width, height);
 		ssaoColor = Texture(width, height, GL_RED, GL_RED);
@@ -158,17 +307,86 @@ public:
 		ssaoBlurColor.setTexFilter(GL_NEAREST);
 		ssaoBlurBuffer.attachTexture2D(ssaoBlurColor, GL_COLOR_ATTACHMENT0);
 
-		// SSAO noise texture
-		ssaoData = NoiseLoader::CreateSSAONoiseKernel();
-		ssaoNoiseTexture = Texture(4, 4, GL_RGBA16F, GL_RGB, GL_NEAREST, GL_REPEAT, &ssaoData.noise[0]);
+		// half resolution SSAO: raw ao and view depth, then the accumulated history (ao, view depth, frame count)
+		int halfWidth = width / 2, halfHeight = height / 2;
+		ssaoHalfBuffer = Framebuffer(halfWidth, halfHeight);
+		ssaoHalfColor = Texture(halfWidth, halfHeight, GL_RG16F, GL_RG, GL_NEAREST, GL_CLAMP_TO_EDGE);
+		ssaoHalfBuffer.attachTexture2D(ssaoHalfColor, GL_COLOR_ATTACHMENT0);
+		for (int i = 0; i < 2; i++)
+		{
+			ssaoHistoryBuffers[i] = Framebuffer(halfWidth, halfHeight);
+			ssaoHistory[i] = Texture(halfWidth, halfHeight, GL_RGBA16F, GL_RGBA, GL_NEAREST, GL_CLAMP_TO_EDGE);
+			ssaoHistoryBuffers[i].attachTexture2D(ssaoHistory[i], GL_COLOR_ATTACHMENT0);
+		}
 
 		// HDR Framebuffer
 		hdrBuffer = Framebuffer(width, height);
 		hdrScene = Texture(width, height, GL_RGBA16F, GL_RGBA);
-		hdrScene.setTexFilter(GL_NEAREST);
+		// linear for the bloom downsample, every other pass samples it at texel centers
+		hdrScene.setTexFilter(GL_LINEAR);
+		hdrScene.setTexWrap(GL_CLAMP_TO_EDGE);
 		hdrBuffer.attachTexture2D(hdrScene, GL_COLOR_ATTACHMENT0);
 		hdrBuffer.attachRenderbuffer(GL_DEPTH_STENCIL_ATTACHMENT, GL_DEPTH24_STENCIL8);
 
+		// classified lighting tile lists, room for every tile in each category
+		lighting_tiles_x = (width + LIGHTING_TILE_SIZE - 1) / LIGHTING_TILE_SIZE;
+		lighting_tiles_y = (height + LIGHTING_TILE_SIZE - 1) / LIGHTING_TILE_SIZE;
+		if (lightingTileListSSBO) glDeleteBuffers(1, &lightingTileListSSBO);
+		glGenBuffers(1, &lightingTileListSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightingTileListSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * lighting_tiles_x * lighting_tiles_y * LIGHTING_TILE_CATEGORIES, nullptr, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+public:
+	void Initialize(int width, int height)
+	{
+		screen_width = width;
+		screen_height = height;
+		CreateSceneTargets(width, height);
+
+		// Shadow framebuffer, cascades are attached layer by layer during the shadow pass
+		shadowBuffer = Framebuffer(shadow_width, shadow_height);
+		staticShadowBuffer = Framebuffer(shadow_width, shadow_height);
+		// depth is a texture so the static cache can be copied into it
+		shadowDepth = Texture(shadow_width, shadow_height, GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_NEAREST, GL_CLAMP_TO_EDGE);
+		shadowBuffer.attachTexture(GL_DEPTH_ATTACHMENT, shadowDepth.id);
+		staticDepthTex = TextureArray(shadow_width, shadow_height, shadow_cascades, GL_DEPTH_COMPONENT32F, GL_NEAREST, GL_CLAMP_TO_EDGE);
+		// moments, static cache and blur targets
+		SetShadowMomentFormat(GL_RG32F);
+
+		shadowBuffer.bind();
+		unsigned int shadow_attachments[1] = { GL_COLOR_ATTACHMENT0 }; // in case of adding more
+		glDrawBuffers(1, shadow_attachments);
+		staticShadowBuffer.attachTextureLayer(GL_DEPTH_ATTACHMENT, staticDepthTex.id, 0);
+		staticShadowBuffer.bind();
+		glDrawBuffers(1, shadow_attachments);
+
+		// Point shadow atlas, depth only. linear filtering with the compare mode gives a 2x2 pcf per lookup
+		pointShadowBuffer = Framebuffer(POINT_SHADOW_ATLAS_SIZE, POINT_SHADOW_ATLAS_SIZE);
+		pointShadowAtlas = Texture(POINT_SHADOW_ATLAS_SIZE, POINT_SHADOW_ATLAS_SIZE, GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT, GL_LINEAR, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, pointShadowAtlas.id);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		pointShadowBuffer.attachTexture(GL_DEPTH_ATTACHMENT, pointShadowAtlas.id);
+		pointShadowBuffer.bind();
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		// cleared once to the far plane so tiles are lit before their first render
+		glClear(GL_DEPTH_BUFFER_BIT);
+		pointShadowBuffer.unbind();
+
+		// shadow records of the lights sampling the atlas, grown on upload
+		glGenBuffers(1, &pointShadowSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, pointShadowSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GPUPointShadow), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		 
+		// SSAO noise texture
+		ssaoData = NoiseLoader::CreateSSAONoiseKernel();
+		ssaoNoiseTexture = Texture(4, 4, GL_RGBA16F, GL_RGB, GL_NEAREST, GL_REPEAT, &ssaoData.noise[0]);
+
 		// Brightness buffer
 		brightnessBuffer = Framebuffer(width, height);
 		brightnessPass = Texture(width, height, GL_RGBA16F, GL_RGBA, GL_LINEAR, GL_CLAMP_TO_EDGE);
@@ -182,16 +400,36 @@ public:
 		bloomPingBuffer.attachTexture2D(blurHorizontal, GL_COLOR_ATTACHMENT0);
 		bloomPongBuffer.attachTexture2D(blurVertical, GL_COLOR_ATTACHMENT0);
 
-		// Tonemapper buffer
-		tonemapperBuffer = Framebuffer(width, height);
-		tonemappedScene = Texture(width, height, GL_RGBA16F, GL_RGBA, GL_LINEAR, GL_CLAMP_TO_EDGE);
-		tonemapperBuffer.attachTexture2D(tonemappedScene, GL_COLOR_ATTACHMENT0);
-		tonemapperBuffer.attachRenderbuffer(GL_DEPTH_STENCIL_ATTACHMENT, GL_DEPTH24_STENCIL8);
+		for (int i = 0; i < BLOOM_MIPS; i++)
+		{
+			int mipWidth = std::max(width >> (i + 1), 1);
+			int mipHeight = std::max(height >> (i + 1), 1);
+			bloomMipBuffers[i] = Framebuffer(mipWidth, mipHeight);
+			bloomMips[i] = Texture(mipWidth, mipHeight, GL_RGBA16F, GL_RGBA, GL_LINEAR, GL_CLAMP_TO_EDGE);
+			bloomMipBuffers[i].attachTexture2D(bloomMips[i], GL_COLOR_ATTACHMENT0);
+		}
 
-		// Base Composite buffer
-		compositeBuffer = Framebuffer(width, height);
-		compositeScene = Texture(width, height, GL_RGBA16F, GL_RGBA, GL_LINEAR, GL_CLAMP_TO_EDGE);
-		compositeBuffer.attachTexture2D(compositeScene, GL_COLOR_ATTACHMENT0);
+		// Tonemapper and composite buffers are created on demand, see SetPostIntermediates
+		tonemappedScene.id = compositeScene.id = 0;
+
+		// Color luts
+		filmicLUT = Texture3D(COLOR_LUT_SIZE, COLOR_LUT_SIZE, COLOR_LUT_SIZE, GL_RGBA16F, GL_LINEAR, GL_CLAMP_TO_EDGE);
+		reinhardLUT = Texture3D(COLOR_LUT_SIZE, COLOR_LUT_SIZE, COLOR_LUT_SIZE, GL_RGBA16F, GL_LINEAR, GL_CLAMP_TO_EDGE);
+
+		// Auto exposure
+		glGenBuffers(1, &histogramSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, histogramSSBO);
+		std::vector<GLuint> emptyHistogram(LUMINANCE_HISTOGRAM_BINS, 0);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * LUMINANCE_HISTOGRAM_BINS, emptyHistogram.data(), GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		float neutralExposure[2] = { 1.0f, 0.0f };
+		exposureTex = Texture(1, 1, GL_RG32F, GL_RG, GL_NEAREST, GL_CLAMP_TO_EDGE, neutralExposure);
+
+		// Classified lighting dispatch arguments, reset every frame before the classification
+		glGenBuffers(1, &lightingDispatchBuffer);
+		glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, lightingDispatchBuffer);
+		glBufferData(GL_DISPATCH_INDIRECT_BUFFER, sizeof(GLuint) * 3 * LIGHTING_TILE_CATEGORIES, nullptr, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
 
 		// Post process buffer
 		postprocessBuffer = Framebuffer(width, height);
@@ -233,16 +471,197 @@ public:
 
 		// Shaders
 		dirShadowDepthShader = Shader("shaders/shadowmapping/dir_depth.vert", "shaders/shadowmapping/dir_depth.frag");
+		pointShadowShader = Shader("shaders/shadowmapping/point_depth.vert", "shaders/shadowmapping/point_depth.frag");
 		ssaoShader = Shader("shaders/frame_out.vert", "shaders/ssao/ssao.frag");
 		ssaoBlurShader = Shader("shaders/frame_out.vert", "shaders/ssao/ssao_blur.frag");
+		ssaoTemporalShader = Shader("shaders/frame_out.vert", "shaders/ssao/ssao_temporal.frag");
+		ssaoUpsampleShader = Shader("shaders/frame_out.vert", "shaders/ssao/ssao_upsample.frag");
+
+		// the kernel never changes, upload it once instead of every frame
+		ssaoShader.use();
+		for (unsigned int i = 0; i < ssaoData.kernel.size(); i++) ssaoShader.setVec3("samples[" + std::to_string(i) + "]", ssaoData.kernel[i]);
 		pbrBufferShader = Shader("shaders/PBR/pbr_def.vert", "shaders/PBR/pbr_ibl_v2.frag");
+		tileClassifyShader = Shader("shaders/lighting/tile_classify.comp");
+		lightingTileShaders[LIGHTING_TILE_SKY] = Shader("shaders/lighting/deferred_tile.comp", { std::string("SKY_TILES") });
+		lightingTileShaders[LIGHTING_TILE_NO_POINT_LIGHTS] = Shader("shaders/lighting/deferred_tile.comp", { std::string("NO_POINT_LIGHTS") });
+		lightingTileShaders[LIGHTING_TILE_FULL] = Shader("shaders/lighting/deferred_tile.comp");
 		brightPassShader = Shader("shaders/frame_out.vert", "shaders/PBR/bright_pass.frag");
 		blurShader = Shader("shaders/frame_out.vert", "shaders/blur/gaussian.frag");
 		bloomShader = Shader("shaders/frame_out.vert", "shaders/bloom/bloom.frag");
+		bloomDownsampleShader = Shader("shaders/frame_out.vert", "shaders/bloom/bloom_downsample.frag");
+		bloomUpsampleShader = Shader("shaders/frame_out.vert", "shaders/bloom/bloom_upsample.frag");
+		lutBakeShader = Shader("shaders/postprocess/lut_bake.comp");
+		histogramShader = Shader("shaders/postprocess/luminance_histogram.comp");
+		autoExposureShader = Shader("shaders/postprocess/auto_exposure.comp");
 		tonemapShader = Shader("shaders/frame_out.vert", "shaders/tonemapping/rh_tonemapping.frag");
 		compositeShader = Shader("shaders/frame_out.vert", "shaders/composite/composite.frag");
 		ppShader = Shader("shaders/frame_out.vert", "shaders/postprocess/pp_celshading.frag");
 		debugShader = Shader("shaders/gbuffer/gbuffer_debug_out.vert", "shaders/gbuffer/gbuffer_debug_out.frag");
+		visibilityShader = Shader("shaders/visibility/vis_buffer.vert", "shaders/visibility/vis_buffer.frag");
+		materialDepthShader = Shader("shaders/frame_out.vert", "shaders/visibility/vis_material_depth.frag");
+		visResolveShader = Shader("shaders/visibility/vis_resolve.vert", "shaders/visibility/vis_resolve.frag");
+		// the prepass shares the vertex stage of every forward shader (the terrain material included), so both
+		// passes produce the same depth
+		const char* forwardVert = "shaders/gbuffer/gbuffer_default.vert";
+		forwardPrepassShader = Shader(forwardVert, "shaders/forward/depth_prepass.frag");
+		forwardPBRShader = Shader(forwardVert, "shaders/forward/forward_pbr.frag");
+		forwardDefaultShader = Shader(forwardVert, "shaders/forward/forward_default.frag");
+		forwardTerrainShader = Shader(forwardVert, "shaders/forward/forward_terrain.frag");
+		taaShader = Shader("shaders/frame_out.vert", "shaders/taa/taa_resolve.frag");
+	}
+
+	// resolution of the scene passes as a fraction of the screen, the temporal resolve upsamples to the screen.
+	// recreates the scene targets, contents are lost
+	void SetRenderScale(float scale)
+	{
+		scale = glm::clamp(scale, 0.25f, 1.0f);
+		int width = glm::max((int)(screen_width * scale), 1);
+		int height = glm::max((int)(screen_height * scale), 1);
+		render_scale = scale;
+		if (width == render_width && height == render_height) return;
+		CreateSceneTargets(width, height);
+	}
+
+	float getRenderScale() const
+	{
+		return render_scale;
+	}
+
+	int getRenderWidth() const
+	{
+		return render_width;
+	}
+
+	int getRenderHeight() const
+	{
+		return render_height;
+	}
+
+	int getScreenWidth() const
+	{
+		return screen_width;
+	}
+
+	int getScreenHeight() const
+	{
+		return screen_height;
+	}
+
+	// history and output of the temporal resolve, screen sized, only allocated while it is enabled
+	void SetTemporalTargets(bool enabled)
+	{
+		if (enabled == temporal_targets) return;
+		temporal_targets = enabled;
+
+		if (!enabled)
+		{
+			// the framebuffers own the textures attached last
+			taaBuffers[0] = Framebuffer();
+			taaBuffers[1] = Framebuffer();
+			taaSceneBuffer = Framebuffer();
+			taaScene.id = taaHistory[0].id = taaHistory[1].id = 0;
+			return;
+		}
+
+		taaScene = Texture(screen_width, screen_height, GL_RGBA16F, GL_RGBA, GL_LINEAR, GL_CLAMP_TO_EDGE);
+		// output only, for passes that draw onto the resolved scene without touching the history
+		taaSceneBuffer = Framebuffer(screen_width, screen_height);
+		taaSceneBuffer.attachTexture2D(taaScene, GL_COLOR_ATTACHMENT0);
+		unsigned int taa_attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		for (int i = 0; i < 2; i++)
+		{
+			taaBuffers[i] = Framebuffer(screen_width, screen_height);
+			taaHistory[i] = Texture(screen_width, screen_height, GL_RGBA16F, GL_RGBA, GL_LINEAR, GL_CLAMP_TO_EDGE);
+			taaBuffers[i].attachTexture2D(taaScene, GL_COLOR_ATTACHMENT1);
+			taaBuffers[i].attachTexture2D(taaHistory[i], GL_COLOR_ATTACHMENT0);
+			taaBuffers[i].bind();
+			glDrawBuffers(2, taa_attachments);
+		}
+		taaBuffers[0].unbind();
+	}
+
+	bool hasTemporalTargets() const
+	{
+		return temporal_targets;
+	}
+
+	Framebuffer& getTAABuffer(int index) noexcept
+	{
+		return taaBuffers[index];
+	}
+
+	Texture& getTAAHistoryTex(int index)
+	{
+		return taaHistory[index];
+	}
+
+	Texture& getTAASceneTex()
+	{
+		return taaScene;
+	}
+
+	Framebuffer& getTAASceneBuffer() noexcept
+	{
+		return taaSceneBuffer;
+	}
+
+	Shader& getTAAShader()
+	{
+		return taaShader;
+	}
+
+	// (re)creates every moments target in the given format, contents are lost
+	void SetShadowMomentFormat(GLenum internalFormat)
+	{
+		const char* imageFormat =
+			internalFormat == GL_RG16F ? "rg16f" :
+			internalFormat == GL_RGBA16F ? "rgba16f" : "rg32f";
+
+		if (momentsTex.id) glDeleteTextures(1, &momentsTex.id);
+		if (staticMomentsTex.id) glDeleteTextures(1, &staticMomentsTex.id);
+		if (shadowBlurTemp.id) glDeleteTextures(1, &shadowBlurTemp.id);
+		if (shadowBlurShader.ID) glDeleteProgram(shadowBlurShader.ID);
+
+		momentsTex = TextureArray(shadow_width, shadow_height, shadow_cascades, internalFormat, GL_LINEAR_MIPMAP_LINEAR, GL_CLAMP_TO_EDGE, true);
+		staticMomentsTex = TextureArray(shadow_width, shadow_height, shadow_cascades, internalFormat, GL_NEAREST, GL_CLAMP_TO_EDGE);
+		shadowBlurTemp = TextureArray(shadow_width, shadow_height, 1, internalFormat, GL_NEAREST, GL_CLAMP_TO_EDGE);
+		shadowBlurShader = Shader("shaders/shadowmapping/vsm_blur.comp", { std::string("MOMENT_FORMAT ") + imageFormat });
+		shadowMomentFormat = internalFormat;
+
+		shadowBuffer.attachTextureLayer(GL_COLOR_ATTACHMENT0, momentsTex.id, 0);
+		staticShadowBuffer.attachTextureLayer(GL_COLOR_ATTACHMENT0, staticMomentsTex.id, 0);
+	}
+
+	GLenum getShadowMomentFormat() const
+	{
+		return shadowMomentFormat;
+	}
+
+	// (re)creates the forward+ targets, created lazily since the deferred path never needs them
+	void SetForwardSamples(int samples)
+	{
+		GLint maxSamples = 1;
+		glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+		samples = glm::clamp(samples, 1, (int)maxSamples);
+		forwardBuffer = Framebuffer(render_width, render_height, samples, GL_RGBA16F, GL_DEPTH_COMPONENT24);
+		forward_samples = samples;
+	}
+
+	int getForwardSamples() const
+	{
+		return forward_samples;
+	}
+
+	ForwardAttachments getForwardAttachments()
+	{
+		return {
+			forwardBuffer,
+			forwardPrepassShader,
+			forwardPBRShader,
+			forwardTerrainShader,
+			forwardDefaultShader,
+			forward_samples
+		};
 	}
 
 	void BlitGToLBuffers(int width, int height)
@@ -263,12 +682,24 @@ public:
 	GBufferAttachments getGAttachments()
 	{
 		return { 
-			gPosition.id, 
 			gNormal.id, 
 			gAlbedoRoughness.id, 
 			gMetallicAO.id,
-			gPositionVS.id,
-			gNormalVS.id
+			gDepth.id,
+			gVelocity.id
+		};
+	}
+
+	VisibilityBufferAttachments getVisibilityAttachments()
+	{
+		return {
+			visibilityBuffer,
+			visResolveBuffer,
+			visibilityShader,
+			materialDepthShader,
+			visResolveShader,
+			visibilityTex.id,
+			materialDepth.id
 		};
 	}
 
@@ -277,8 +708,16 @@ public:
 		return {
 			shadowBuffer,
 			dirShadowDepthShader,
+			momentsTex,
+			staticShadowBuffer,
+			staticMomentsTex,
+			staticDepthTex,
+			shadowDepth,
+			shadowBlurTemp,
+			shadowBlurShader,
 			shadow_width,
-			shadow_height
+			shadow_height,
+			shadow_cascades
 		};
 	}
 
@@ -293,6 +732,85 @@ public:
 		};
 	}
 
+	// the separate tonemap and composite passes write full screen intermediates that the fused post pass never
+	// needs, they only exist while the separate chain is used (eg. to inspect the composite output)
+	void SetPostIntermediates(bool enabled)
+	{
+		if (enabled == post_intermediates) return;
+		post_intermediates = enabled;
+
+		if (!enabled)
+		{
+			// the framebuffers own their color textures
+			tonemapperBuffer = Framebuffer();
+			compositeBuffer = Framebuffer();
+			tonemappedScene.id = compositeScene.id = 0;
+			return;
+		}
+
+		tonemapperBuffer = Framebuffer(screen_width, screen_height);
+		tonemappedScene = Texture(screen_width, screen_height, GL_RGBA16F, GL_RGBA, GL_LINEAR, GL_CLAMP_TO_EDGE);
+		tonemapperBuffer.attachTexture2D(tonemappedScene, GL_COLOR_ATTACHMENT0);
+		tonemapperBuffer.attachRenderbuffer(GL_DEPTH_STENCIL_ATTACHMENT, GL_DEPTH24_STENCIL8);
+
+		compositeBuffer = Framebuffer(screen_width, screen_height);
+		compositeScene = Texture(screen_width, screen_height, GL_RGBA16F, GL_RGBA, GL_LINEAR, GL_CLAMP_TO_EDGE);
+		compositeBuffer.attachTexture2D(compositeScene, GL_COLOR_ATTACHMENT0);
+	}
+
+	Texture3D& getFilmicLUT()
+	{
+		return filmicLUT;
+	}
+
+	Texture3D& getReinhardLUT()
+	{
+		return reinhardLUT;
+	}
+
+	Shader& getLUTBakeShader()
+	{
+		return lutBakeShader;
+	}
+
+	GLuint getHistogramBuffer() const
+	{
+		return histogramSSBO;
+	}
+
+	Texture& getExposureTex()
+	{
+		return exposureTex;
+	}
+
+	Shader& getHistogramShader()
+	{
+		return histogramShader;
+	}
+
+	Shader& getAutoExposureShader()
+	{
+		return autoExposureShader;
+	}
+
+	bool hasPostIntermediates() const
+	{
+		return post_intermediates;
+	}
+
+	// compiled on first use of a stage combination
+	Shader& getPostShader(unsigned int stages)
+	{
+		auto it = postShaders.find(stages);
+		if (it != postShaders.end()) return it->second;
+
+		std::vector<std::string> defines;
+		if (stages & POST_BLOOM) defines.push_back("BLOOM");
+		if (stages & POST_SKY) defines.push_back("SKY");
+		if (stages & POST_CEL_SHADING) defines.push_back("CEL_SHADING");
+		return postShaders.emplace(stages, Shader("shaders/frame_out.vert", "shaders/postprocess/post_uber.frag", defines)).first->second;
+	}
+
 	LBufferAttachments getLAttachments()
 	{
 		return {
@@ -319,8 +837,8 @@ public:
 	SSAOAttachments getSSAOAttachments()
 	{
 		return {
-			gPositionVS.id,
-			gNormalVS.id,
+			gDepth.id,
+			gNormal.id,
 			ssaoNoiseTexture.id,
 			ssaoColor.id
 		};
@@ -336,11 +854,31 @@ public:
 		return gDepth;
 	}
 
-	Texture& getShadowMoments()
+	TextureArray& getShadowMoments()
 	{
 		return momentsTex;
 	}
 
+	Framebuffer& getPointShadowBuffer()
+	{
+		return pointShadowBuffer;
+	}
+
+	Shader& getPointShadowShader()
+	{
+		return pointShadowShader;
+	}
+
+	Texture& getPointShadowAtlas()
+	{
+		return pointShadowAtlas;
+	}
+
+	GLuint getPointShadowRecords() const
+	{
+		return pointShadowSSBO;
+	}
+
 	Texture& getHDRSceneTex()
 	{
 		return hdrScene;
@@ -381,11 +919,51 @@ public:
 		return ssaoBlurColor;
 	}
 
+	Texture& getSSAOHalfTexture()
+	{
+		return ssaoHalfColor;
+	}
+
+	Texture& getSSAOHistoryTexture(int index)
+	{
+		return ssaoHistory[index];
+	}
+
 	Shader& getPBRShader() noexcept
 	{
 		return pbrBufferShader;
 	}
 
+	Shader& getTileClassifyShader()
+	{
+		return tileClassifyShader;
+	}
+
+	Shader& getLightingTileShader(int category)
+	{
+		return lightingTileShaders[category];
+	}
+
+	GLuint getLightingTileListBuffer() const
+	{
+		return lightingTileListSSBO;
+	}
+
+	GLuint getLightingDispatchBuffer() const
+	{
+		return lightingDispatchBuffer;
+	}
+
+	int getLightingTilesX() const
+	{
+		return lighting_tiles_x;
+	}
+
+	int getLightingTilesY() const
+	{
+		return lighting_tiles_y;
+	}
+
 	Shader& getBrightnessShader()
 	{
 		return brightPassShader;
@@ -396,6 +974,26 @@ public:
 		return bloomShader;
 	}
 
+	Shader& getBloomDownsampleShader()
+	{
+		return bloomDownsampleShader;
+	}
+
+	Shader& getBloomUpsampleShader()
+	{
+		return bloomUpsampleShader;
+	}
+
+	Framebuffer& getBloomMipBuffer(int level) noexcept
+	{
+		return bloomMipBuffers[level];
+	}
+
+	Texture& getBloomMipTex(int level)
+	{
+		return bloomMips[level];
+	}
+
 	Shader& getTonemapShader()
 	{
 		return tonemapShader;
@@ -425,6 +1023,16 @@ public:
 	{
 		return ssaoBlurShader;
 	}
+
+	Shader& getSSAOTemporalShader()
+	{
+		return ssaoTemporalShader;
+	}
+
+	Shader& getSSAOUpsampleShader()
+	{
+		return ssaoUpsampleShader;
+	}
 	
 	Framebuffer& getGBuffer() noexcept
 	{
@@ -470,4 +1078,14 @@ public:
 	{
 		return ssaoBlurBuffer;
 	}
+
+	Framebuffer& getSSAOHalfBuffer() noexcept
+	{
+		return ssaoHalfBuffer;
+	}
+
+	Framebuffer& getSSAOHistoryBuffer(int index) noexcept
+	{
+		return ssaoHistoryBuffers[index];
+	}
 };
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include <sstream>
 #include <iostream>
 #include <unordered_map>
+#include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -18,15 +19,15 @@ private:
 	mutable std::unordered_map <std::string, GLint> uniformLocationCache;
 public:
 	// program ID
-	unsigned int ID;
+	unsigned int ID = 0;
 
 	Shader() = default;
-	// vert and frag shader constructor. Paths should start at root directory.
-	Shader(const char* vertexPath, const char* fragmentPath);
+	// vert and frag shader constructor. Paths should start at root directory, defines go into both stages.
+	Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines = {});
 	// vert, geom, and frag shader constructor
 	Shader(const char* vertexPath, const char* geometryPath, const char* fragmentPath);
-	// compute shader
-	Shader(const char* computePath);
+	// compute shader, defines are injected after the #version line (eg. "MOMENT_FORMAT rg16f")
+	Shader(const char* computePath, const std::vector<std::string>& defines = {});
 	// tessellation shader
 	Shader(const char* vertexPath, const char* tesCtrlPath, const char* tesEvalPath, const char* fragmentPath);
 
@@ -45,4 +46,9 @@ public:
 	void setMat4(const std::string& name, const glm::mat4& mat) const;
 	void setSamplerArray(const std::string& name, const std::vector<GLuint> texIDs, int firstUnit, GLenum target) const;
 	GLint getUniformLocation(const std::string& name) const;
+
+private:
+	static void injectDefines(std::string& code, const std::vector<std::string>& defines);
+	// expands #include "file" lines, paths relative to the including shader
+	static void resolveIncludes(std::string& code, const std::string& path, int depth = 0);
 };
\ No newline at end of file
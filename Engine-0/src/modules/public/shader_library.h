@@ -1,6 +1,7 @@
 #pragma once
 #include "shader.h"
 #include <unordered_map>
+#include <unordered_set>
 
 class ShaderLibrary
 {
@@ -16,6 +17,15 @@ public:
 			throw std::runtime_error("Shader not found: " + name);
 	}
 
+	// true when the shader's fragment stage is gbuffer_pbr.frag, the material the visibility resolve and the
+	// forward pbr shader evaluate
+	static bool UsesPBRMaterial(const std::string& name)
+	{
+		if (GetLibrary().empty())
+			InitializeLibrary();
+		return GetPBRMaterials().count(name) > 0;
+	}
+
 	static std::vector<const char*> GetLibraryKeys()
 	{
 		auto& lib = GetLibrary();
@@ -35,12 +45,19 @@ private:
 		return library;
 	}
 
+	static std::unordered_set<std::string>& GetPBRMaterials()
+	{
+		static std::unordered_set<std::string> pbrMaterials;
+		return pbrMaterials;
+	}
+
 	static void InitializeLibrary()
 	{
 		Shader defaultGShader = Shader("shaders/gbuffer/gbuffer_default.vert", "shaders/gbuffer/gbuffer_default.frag");
 		GetLibrary().emplace("Default Lit", std::move(defaultGShader));
 		Shader PBRGShader = Shader("shaders/gbuffer/gbuffer_default.vert", "shaders/gbuffer/gbuffer_pbr.frag");
 		GetLibrary().emplace("PBR Test", std::move(PBRGShader));
+		GetPBRMaterials().insert("PBR Test");
 		Shader tintedGShader = Shader("shaders/gbuffer/gbuffer_default.vert", "shaders/gbuffer/gbuffer_tint.frag");
 		GetLibrary().emplace("Lit with Color Tint", std::move(tintedGShader));
 		Shader terrainShader = Shader("shaders/gbuffer/gbuffer_default.vert", "shaders/gbuffer/gbuffer_terrain.frag");
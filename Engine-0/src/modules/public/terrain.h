@@ -2,6 +2,7 @@
 #include "../../common.h"
 #include "shader.h"
 #include "camera.h"
+#include "frustum.h"
 
 enum class TerrainType
 {
@@ -34,6 +35,13 @@ public:
 
 	virtual void Render(Shader& shader, Camera& camera, glm::mat4& model) = 0;
 	virtual void Initialize() = 0;
+
+	// shadow caster draw, culled against the light instead of the camera. LOD still follows the camera.
+	// terrains without patches draw everything.
+	virtual void RenderShadow(Shader& shader, Camera& camera, const ShadowCasterCuller& /*culler*/, glm::mat4& model)
+	{
+		Render(shader, camera, model);
+	}
 	
 	// Height data generation
 	bool LoadHeightMap(const char* filename);
@@ -76,6 +84,11 @@ public:
 
 	inline float GetWorldScale() { return worldScale; }
 
+	// height data dimensions in samples, 0 before the data is loaded
+	inline int GetWidth() const { return heightData.width; }
+	inline int GetDepth() const { return heightData.depth; }
+	inline bool HasHeightData() const { return !heightData.data.empty(); }
+
 protected:
 	HeightData heightData;
 	float heightScale = 255.0f;
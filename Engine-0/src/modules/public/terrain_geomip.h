@@ -2,6 +2,7 @@
 #include "terrain.h"
 #include "terrain_lod_manager.h"
 #include "frustum.h"
+#include <functional>
 
 class GeomipTerrain : public Terrain
 {
@@ -10,9 +11,13 @@ public:
 	void GenerateGeomip(int patchSize, int worldScale = 1.0f);
 	void InitBuffers();
 	void Render(Shader& shader, Camera& camera, glm::mat4& model) override;
+	void RenderShadow(Shader& shader, Camera& camera, const ShadowCasterCuller& culler, glm::mat4& model) override;
 
 private:
 	LODManager lodManager;	// decides the LOD per patch (collection of triangle fans)
+	bool lodValid = false;	// the lod map is shared by all passes, only rebuilt when the origin or model changes
+	glm::vec3 lastLODOrigin = glm::vec3(0.0f);
+	glm::mat4 lastLODModel = glm::mat4(1.0f);
 	int patchSize = 0;		// vertices per side in one patch (must be odd, 5 vertices would have 4x4 triangle fans)
 	int maxLOD = 0;
 
@@ -36,6 +41,9 @@ private:
 	int numPatchesX = 0;
 	int numPatchesZ = 0;
 
+	void UpdateLOD(const glm::vec3& origin, glm::mat4& model);
+	void DrawPatches(glm::mat4& model, const std::function<bool(const glm::vec3&, float)>& isPatchVisible);
+
 	int CalcNumIndices();
 	void InitIndicesData(); // index buffer helper for geomipmap
 	int InitIndicesLOD(int index, int lod);
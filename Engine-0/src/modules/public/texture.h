@@ -7,6 +7,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <unordered_map>
+#include <algorithm>
+#include <cmath>
 
 class Texture {
 public:
@@ -99,3 +101,68 @@ private:
 	}
 };
 
+// 2D texture array, used for layered render targets (eg. shadow cascades)
+class TextureArray {
+public:
+	unsigned int id = 0;
+	int width = 0, height = 0, layers = 0;
+
+	TextureArray(int width, int height, int layers, GLenum internalFormat, GLint filter, GLint wrap, bool mipmapped = false)
+		: width(width), height(height), layers(layers) {
+		glGenTextures(1, &id);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+
+		auto it = Texture::sizedFormatToType.find(internalFormat);
+		if (it != Texture::sizedFormatToType.end())
+		{
+			int levels = mipmapped ? (int)floor(log2((float)std::max(width, height))) + 1 : 1;
+			glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, width, height, layers);
+		}
+		else
+			std::cerr << "Error: internal format not supported." << std::endl;
+
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter == GL_LINEAR_MIPMAP_LINEAR ? GL_LINEAR : filter);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+
+	TextureArray() {}
+
+	void bind() {
+		glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+	}
+
+	void unbind() {
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+
+	void genMipMap() {
+		bind();
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		unbind();
+	}
+};
+
+// 3D texture with immutable storage, filled by compute shaders (eg. color grading luts)
+class Texture3D {
+public:
+	unsigned int id = 0;
+	int width = 0, height = 0, depth = 0;
+
+	Texture3D(int width, int height, int depth, GLenum internalFormat, GLint filter, GLint wrap)
+		: width(width), height(height), depth(depth) {
+		glGenTextures(1, &id);
+		glBindTexture(GL_TEXTURE_3D, id);
+		glTexStorage3D(GL_TEXTURE_3D, 1, internalFormat, width, height, depth);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, wrap);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, wrap);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, wrap);
+		glBindTexture(GL_TEXTURE_3D, 0);
+	}
+
+	Texture3D() {}
+};
\ No newline at end of file
@@ -18,6 +18,7 @@ struct TransformComponent
     glm::vec3 position;
     glm::vec3 rotation; // Euler angles (radians)
     glm::vec3 scale;
+    bool isStatic = true; // static entities are cached by systems (eg. static shadow casters)
 
     TransformComponent(const glm::vec3& pos = glm::vec3(0.0f),
         const glm::vec3& rot = glm::vec3(0.0f),
@@ -70,6 +71,7 @@ struct PointLightComponent
     float intensity = 0.0f;
     float radius = 0.0f;
     bool enabled = true;
+    bool castShadows = false;       // competes for a slot in the point shadow atlas
 };
 
 struct DirectionalLightComponent
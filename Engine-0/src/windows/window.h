@@ -5,6 +5,7 @@
 #include "../modules/public/texture_library.h"
 #include "../modules/public/asset_library.h"
 #include "../modules/public/probe_temp_library.h"
+#include "../modules/public/render_settings.h"
 #include <iostream>
 #include <string>
 #include <map>
@@ -199,17 +200,24 @@ public:
 					float rotation[4] = { transformComp->rotation.x, transformComp->rotation.y, transformComp->rotation.z, 1.0f };
 					float scale[4] = { transformComp->scale.x, transformComp->scale.y, transformComp->scale.z, 1.0f };
 
+					bool changed = false;
+
 					std::string posLabel = "Position##ExpandedPropertiesWindow";
-					ImGui::DragFloat3(posLabel.c_str(), position, 0.5f);
+					changed |= ImGui::DragFloat3(posLabel.c_str(), position, 0.5f);
 					transformComp->position = glm::vec3(position[0], position[1], position[2]);
 
 					std::string rotLabel = "Rotation##ExpandedPropertiesWindow";
-					ImGui::DragFloat3(rotLabel.c_str(), rotation, 0.5f);
+					changed |= ImGui::DragFloat3(rotLabel.c_str(), rotation, 0.5f);
 					transformComp->rotation = glm::vec3(rotation[0], rotation[1], rotation[2]);
 
 					std::string scaleLabel = "Scale##ExpandedPropertiesWindow";
-					ImGui::DragFloat3(scaleLabel.c_str(), scale, 0.5f);
+					changed |= ImGui::DragFloat3(scaleLabel.c_str(), scale, 0.5f);
 					transformComp->scale = glm::vec3(scale[0], scale[1], scale[2]);
+
+					std::string staticLabel = "Static##ExpandedPropertiesWindow";
+					changed |= ImGui::Checkbox(staticLabel.c_str(), &transformComp->isStatic);
+
+					if (changed) transformManager->MarkChanged(expandedEntity);
 				}
 			}
 			if (assetManager && materialsGroupManager && shaderManager)
@@ -449,11 +457,12 @@ public:
 				{
 					float position[4] = { probeComp->position.x, probeComp->position.y, probeComp->position.z, 1.0f };
 					std::string posLabel = "ProbePosition##ExpandedPropertiesWindow";
-					ImGui::DragFloat3(posLabel.c_str(), position, 0.5f);
+					bool moved = ImGui::DragFloat3(posLabel.c_str(), position, 0.5f);
 					probeComp->position = glm::vec3(position[0], position[1], position[2]);
 
 					std::string radiusLabel = "ProbeRadius##ExpandedPropertiesWindow";
-					ImGui::InputFloat(radiusLabel.c_str(), &probeComp->radius);
+					moved |= ImGui::InputFloat(radiusLabel.c_str(), &probeComp->radius);
+					if (moved) probeManager->MarkChanged(expandedEntity);
 
 					IBLSettings* settings = &probeComp->settings;
 					std::string environmentMap = settings->eqrMapPath;
@@ -585,6 +594,200 @@ public:
 
 	}
 
+	void EndRender() override
+	{
+		ImGui::End();
+	}
+};
+
+class RenderSettingsWindow : public Window
+{
+private:
+	RenderSettings* settings = nullptr;
+	RenderStats* stats = nullptr;
+
+public:
+	RenderSettingsWindow() : Window("Render Settings", true, ImGuiWindowFlags_NoCollapse) {}
+	RenderSettingsWindow(RenderSettings* settings, RenderStats* stats) :
+		Window("Render Settings", true, ImGuiWindowFlags_NoCollapse), settings(settings), stats(stats) {}
+
+	bool BeginRender() override
+	{
+		if (!window_open) return false;
+		ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0.0f);
+		ImGui::PushStyleVar(ImGuiStyleVar_WindowBorderSize, 0.0f);
+		bool renderContent = (ImGui::Begin(title.c_str(), &window_open, window_flags));
+		ImGui::PopStyleVar(2);
+
+		if (renderContent && settings)
+		{
+			if (ImGui::CollapsingHeader("Geometry", ImGuiTreeNodeFlags_DefaultOpen))
+			{
+				const char* shadingPaths[] = { "Deferred", "Forward+" };
+				int shading = (int)settings->shadingPath;
+				if (ImGui::Combo("Shading Path", &shading, shadingPaths, IM_ARRAYSIZE(shadingPaths))) settings->shadingPath = (ShadingPath)shading;
+
+				if (settings->shadingPath == ShadingPath::ForwardPlus)
+				{
+					const char* sampleCounts[] = { "1", "2", "4", "8" };
+					int sampleIndex = settings->msaaSamples >= 8 ? 3 : settings->msaaSamples >= 4 ? 2 : settings->msaaSamples >= 2 ? 1 : 0;
+					if (ImGui::Combo("MSAA", &sampleIndex, sampleCounts, IM_ARRAYSIZE(sampleCounts))) settings->msaaSamples = 1 << sampleIndex;
+				}
+				else
+				{
+					const char* paths[] = { "Deferred", "Visibility Buffer" };
+					int path = (int)settings->geometryPath;
+					if (ImGui::Combo("Geometry Path", &path, paths, IM_ARRAYSIZE(paths))) settings->geometryPath = (GeometryPath)path;
+
+					const char* lightingPaths[] = { "Fullscreen", "Classified Tiles" };
+					int lighting = (int)settings->lightingPath;
+					if (ImGui::Combo("Lighting Path", &lighting, lightingPaths, IM_ARRAYSIZE(lightingPaths))) settings->lightingPath = (LightingPath)lighting;
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Anti Aliasing"))
+			{
+				const char* modes[] = { "None", "Temporal" };
+				int mode = (int)settings->antiAliasing;
+				if (ImGui::Combo("Anti Aliasing", &mode, modes, IM_ARRAYSIZE(modes))) settings->antiAliasing = (AntiAliasing)mode;
+
+				if (settings->antiAliasing == AntiAliasing::Temporal)
+				{
+					ImGui::SliderFloat("Render Scale", &settings->renderScale, 0.5f, 1.0f, "%.2f");
+					ImGui::SliderFloat("History Feedback", &settings->taaFeedback, 0.5f, 0.98f);
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Lights"))
+			{
+				const char* cullings[] = { "Tiled", "Clustered", "Tiled (CPU)" };
+				int culling = (int)settings->lightCulling;
+				if (ImGui::Combo("Light Culling", &culling, cullings, IM_ARRAYSIZE(cullings))) settings->lightCulling = (LightCulling)culling;
+
+				// stress test, 10k - 100k lights on top of the scene
+				ImGui::SliderInt("Stress Lights", &settings->stressLights, 0, 100000, "%d", ImGuiSliderFlags_Logarithmic);
+			}
+
+			if (ImGui::CollapsingHeader("Ambient Occlusion"))
+			{
+				const char* modes[] = { "Full Resolution", "Half Resolution Temporal" };
+				int mode = (int)settings->ssaoMode;
+				if (ImGui::Combo("SSAO Mode", &mode, modes, IM_ARRAYSIZE(modes))) settings->ssaoMode = (SSAOMode)mode;
+
+				if (settings->ssaoMode == SSAOMode::HalfTemporal)
+				{
+					const char* sampleCounts[] = { "8", "16", "32" };
+					int sampleIndex = settings->ssaoSamples >= 32 ? 2 : settings->ssaoSamples >= 16 ? 1 : 0;
+					if (ImGui::Combo("Samples / Frame", &sampleIndex, sampleCounts, IM_ARRAYSIZE(sampleCounts))) settings->ssaoSamples = 8 << sampleIndex;
+					ImGui::SliderInt("History Frames", &settings->ssaoHistoryFrames, 1, 32);
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Post Processing"))
+			{
+				const char* chains[] = { "Separate Passes", "Fused" };
+				int chain = (int)settings->postChain;
+				if (ImGui::Combo("Post Chain", &chain, chains, IM_ARRAYSIZE(chains))) settings->postChain = (PostChain)chain;
+
+				// baked into the color luts, edits only cost a rebake
+				ColorGrading& grading = settings->grading;
+				ImGui::DragFloat("Exposure", &grading.exposure, 0.01f, 0.0f, 16.0f);
+				ImGui::DragFloat("Contrast", &grading.contrast, 0.01f, 0.0f, 4.0f);
+				ImGui::DragFloat("Saturation", &grading.saturation, 0.01f, 0.0f, 4.0f);
+				ImGui::ColorEdit3("Color Filter", &grading.colorFilter.x, ImGuiColorEditFlags_Float | ImGuiColorEditFlags_HDR);
+				ImGui::DragFloat3("Lift", &grading.lift.x, 0.005f, -1.0f, 1.0f);
+				ImGui::DragFloat3("Gamma", &grading.gamma.x, 0.01f, 0.01f, 4.0f);
+				ImGui::DragFloat3("Gain", &grading.gain.x, 0.01f, 0.0f, 4.0f);
+				ImGui::DragFloat("Display Gamma", &grading.displayGamma, 0.01f, 1.0f, 3.0f);
+
+				ImGui::Checkbox("Auto Exposure", &settings->autoExposure);
+				if (settings->autoExposure)
+				{
+					ImGui::DragFloat("Key Value", &settings->exposureKey, 0.005f, 0.01f, 1.0f);
+					ImGui::DragFloat("Adaptation Speed", &settings->exposureAdaptationSpeed, 0.05f, 0.0f, 10.0f);
+					ImGui::DragFloatRange2("Percentiles", &settings->exposureLowPercentile, &settings->exposureHighPercentile, 0.01f, 0.0f, 1.0f);
+					ImGui::DragFloatRange2("EV Range", &settings->exposureMinEV, &settings->exposureMaxEV, 0.1f, -16.0f, 16.0f);
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Bloom"))
+			{
+				ImGui::Checkbox("Enabled", &settings->bloomEnabled);
+				const char* modes[] = { "Gaussian", "Dual Filter" };
+				int mode = (int)settings->bloomMode;
+				if (ImGui::Combo("Bloom Mode", &mode, modes, IM_ARRAYSIZE(modes))) settings->bloomMode = (BloomMode)mode;
+				ImGui::DragFloat("Threshold", &settings->bloomThreshold, 0.01f, 0.0f, 10.0f);
+				ImGui::DragFloat("Exposure", &settings->bloomExposure, 0.01f, 0.0f, 4.0f);
+
+				if (settings->bloomMode == BloomMode::DualFilter)
+				{
+					ImGui::DragFloat("Knee", &settings->bloomKnee, 0.01f, 0.0f, 1.0f);
+					ImGui::DragFloat("Radius", &settings->bloomRadius, 0.01f, 0.5f, 3.0f);
+					ImGui::DragFloat("Intensity", &settings->bloomIntensity, 0.01f, 0.0f, 4.0f);
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Shadows", ImGuiTreeNodeFlags_DefaultOpen))
+			{
+				const char* filters[] = { "Mipmap", "Compute Blur" };
+				int filter = (int)settings->shadowFilter;
+				if (ImGui::Combo("Filter", &filter, filters, IM_ARRAYSIZE(filters))) settings->shadowFilter = (ShadowFilterMode)filter;
+
+				const char* formats[] = { "RG32F", "RG16F", "RGBA16F" };
+				int format = (int)settings->shadowFormat;
+				if (ImGui::Combo("Moment Format", &format, formats, IM_ARRAYSIZE(formats))) settings->shadowFormat = (ShadowMomentFormat)format;
+
+				// the half float formats only store evsm
+				bool evsmOnly = settings->shadowFormat != ShadowMomentFormat::RG32F;
+				bool evsm = settings->evsm || evsmOnly;
+				ImGui::BeginDisabled(evsmOnly);
+				if (ImGui::Checkbox("EVSM", &evsm)) settings->evsm = evsm;
+				ImGui::EndDisabled();
+				if (settings->shadowFilter == ShadowFilterMode::ComputeBlur)
+					ImGui::SliderInt("Blur Radius", &settings->shadowBlurRadius, 1, 16);
+				ImGui::SliderFloat("Light Bleed Reduction", &settings->lightBleedReduction, 0.0f, 0.9f);
+				ImGui::DragFloat("Shadow Distance", &settings->shadowDistance, 1.0f, 10.0f, 2500.0f);
+				ImGui::SliderFloat("Split Lambda", &settings->cascadeSplitLambda, 0.0f, 1.0f);
+				ImGui::Checkbox("Static Shadow Cache", &settings->shadowCaching);
+
+				ImGui::Separator();
+				ImGui::Checkbox("Point Light Shadows", &settings->pointShadows);
+				ImGui::SliderInt("Shadowed Lights", &settings->pointShadowMaxLights, 1, 57);
+				ImGui::SliderInt("Faces Per Frame", &settings->pointShadowBudget, 1, 48);
+				ImGui::DragFloat("Tier Distance", &settings->pointShadowTierDistance, 0.5f, 1.0f, 500.0f);
+			}
+
+			if (ImGui::CollapsingHeader("LOD"))
+			{
+				ImGui::DragFloat("LOD Bias", &settings->lodBias, 0.05f, -4.0f, 4.0f);
+				ImGui::DragFloat("Shadow LOD Bias", &settings->shadowLODBias, 0.05f, -4.0f, 4.0f);
+			}
+
+			if (stats && ImGui::CollapsingHeader("Stats", ImGuiTreeNodeFlags_DefaultOpen))
+			{
+				ImGui::Text("Geometry: %.3f ms", stats->geometry.GetMilliseconds());
+				ImGui::Text("Light culling: %.3f ms", stats->lightCulling.GetMilliseconds());
+				ImGui::Text("Lights: %d, %d in view, %d uploaded", stats->lightCount, stats->visibleLights, stats->lightsUploaded);
+				ImGui::Text("Light lists: %d entries, %.1f MB", stats->lightIndices, stats->lightBufferBytes / (1024.0f * 1024.0f));
+				ImGui::Text("Shading: %.3f ms", stats->shading.GetMilliseconds());
+				ImGui::Text("SSAO: %.3f ms", stats->ssao.GetMilliseconds());
+				ImGui::Text("Temporal resolve: %.3f ms", stats->taa.GetMilliseconds());
+				ImGui::Text("Auto exposure: %.3f ms", stats->exposure.GetMilliseconds());
+				ImGui::Text("Bloom: %.3f ms", stats->bloom.GetMilliseconds());
+				ImGui::Text("Post: %.3f ms", stats->post.GetMilliseconds());
+				if (settings->geometryPath == GeometryPath::VisibilityBuffer)
+					ImGui::Text("Visibility draws: %d, %d entities over the limit", stats->visibilityDraws, stats->visibilityOverflow);
+				ImGui::Text("Shadow casters: %d drawn, %d culled", stats->shadowCastersDrawn, stats->shadowCastersCulled);
+				ImGui::Text("Cached cascades: %d", stats->shadowCascadesCached);
+				ImGui::Text("Shadow render: %.3f ms", stats->shadowRender.GetMilliseconds());
+				ImGui::Text("Shadow filter: %.3f ms", stats->shadowFilter.GetMilliseconds());
+				ImGui::Text("Point shadows: %d lights, %d faces, %d pending", stats->pointShadowLights, stats->pointShadowFaces, stats->pointShadowPending);
+				ImGui::Text("Point shadow render: %.3f ms", stats->pointShadowRender.GetMilliseconds());
+			}
+		}
+		return true;
+	}
+
 	void EndRender() override
 	{
 		ImGui::End();